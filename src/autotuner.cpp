@@ -0,0 +1,209 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "autotuner.h"
+#include "metrics.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+// Current setting of the tuner, served by MetricsServer
+struct AutoTunerMetrics
+{
+    MetricGauge &packet;
+    MetricGauge &iterations;
+    MetricCounter &decisions;
+    MetricGauge &saturated;
+};
+
+static AutoTunerMetrics &autoTunerMetrics()
+{
+    MetricsRegistry &r = MetricsRegistry::instance();
+    static AutoTunerMetrics metrics = {
+        r.gauge("dvs_autotune_packet_events", "Packet size chosen by the auto-tuner"),
+        r.gauge("dvs_autotune_iterations", "Optimizer iterations chosen by the auto-tuner"),
+        r.counter("dvs_autotune_decisions_total", "Parameter changes of the auto-tuner"),
+        r.gauge("dvs_autotune_saturated", "1 while the auto-tuner wants a change beyond its limits")};
+    return metrics;
+}
+
+AutoTunerSettings defaultAutoTunerSettings()
+{
+    AutoTunerSettings settings;
+    settings.target_latency = 0.01;
+    settings.target_rate = 0;
+    settings.headroom = 1.2;
+    settings.min_packet = 500;
+    settings.max_packet = 5000;
+    settings.min_iterations = 2;
+    settings.max_iterations = 20;
+    settings.min_quality = 0.5f;
+    settings.window = 20;
+    settings.cooldown = 2;
+    return settings;
+}
+
+AutoTuner::AutoTuner()
+{
+    settings_ = defaultAutoTunerSettings();
+    decisions_ = 0;
+    saturated_ = NULL;
+    reset();
+    autoTunerMetrics();
+}
+
+bool AutoTuner::openLog(const std::string &filename)
+{
+    if (file_.is_open())
+        file_.close();
+    if (filename.empty())
+        return true;
+    file_.open(filename.c_str(), std::ios::app);
+    return file_.good();
+}
+
+void AutoTuner::reset()
+{
+    packets_ = 0;
+    events_ = 0;
+    span_ = 0;
+    solve_sum_ = 0;
+    lag_max_ = 0;
+    quality_sum_ = 0;
+    cooldown_ = 0;
+    setSaturated(NULL, 0, 0, 0);
+}
+
+void AutoTuner::setSaturated(const char *reason, double t, int packet, int iterations)
+{
+    if (reason && reason != saturated_)
+    { // once per episode, a saturated tuner decides the same every window
+        std::string text = std::string("at bounds, ") + reason;
+        log(t, text.c_str(), packet, packet, iterations, iterations);
+    }
+    saturated_ = reason;
+    autoTunerMetrics().saturated.set(reason ? 1 : 0);
+}
+
+void AutoTuner::setPacketSize(Tracker &tracker, int events)
+{
+    if (tracker.trackingMode() == TRACKING_PACKET)
+        tracker.setEventsPerImage(events);
+    else
+        tracker.setWindowStep(events);
+}
+
+void AutoTuner::log(double t, const char *reason, int packet, int new_packet, int iterations, int new_iterations)
+{
+    std::ostream &out = file_.is_open() ? static_cast<std::ostream &>(file_) : std::cout;
+    out << std::fixed << std::setprecision(3) << "autotune t " << t << "s " << reason << ": packet " << packet;
+    if (new_packet != packet)
+        out << " -> " << new_packet;
+    out << ", iterations " << iterations;
+    if (new_iterations != iterations)
+        out << " -> " << new_iterations;
+    out << std::setprecision(2) << " (solve " << solve_ * 1e3 << " ms, lag " << lag_ * 1e3 << " ms, latency " << latency_ * 1e3
+        << " ms, rate " << rate_ * 1e-6 << " Mev/s, capacity " << capacity_ * 1e-6 << " Mev/s, quality " << quality_ << ")"
+        << std::endl;
+}
+
+bool AutoTuner::update(Tracker &tracker, const TrackingResult &result, size_t events, double span, double solve, double lag)
+{
+    if (!result.pose_updated)
+        return false; // map initialization is not representative
+    packets_++;
+    events_ += events;
+    span_ += span;
+    solve_sum_ += solve;
+    lag_max_ = std::max(lag_max_, lag);
+    quality_sum_ += result.quality;
+    if (packets_ < settings_.window)
+        return false;
+
+    const AutoTunerSettings &s = settings_;
+    int packet = packetSize(tracker);
+    int iterations = tracker.iterations();
+    solve_ = solve_sum_ / packets_;
+    lag_ = lag_max_;
+    quality_ = quality_sum_ / packets_;
+    rate_ = span_ > 0 ? events_ / span_ : 0;
+    capacity_ = solve_ > 0 ? packet / solve_ : 0;
+    double required = std::max(s.target_rate, rate_) * s.headroom;
+    double accumulation = rate_ > 0 ? packet / rate_ : 0;
+    latency_ = accumulation + lag_ + solve_;
+    packets_ = 0;
+    events_ = span_ = solve_sum_ = lag_max_ = quality_sum_ = 0;
+    if (cooldown_ > 0)
+    {
+        cooldown_--;
+        return false;
+    }
+
+    int new_packet = packet, new_iterations = iterations;
+    const char *reason = NULL;
+    if (capacity_ < required)
+    {
+        reason = "too slow for the event rate";
+        if (iterations > s.min_iterations)
+            new_iterations = std::max(s.min_iterations, iterations * 3 / 4);
+        else
+            new_packet = std::min(s.max_packet, packet * 5 / 4);
+    }
+    else if (accumulation + solve_ > s.target_latency)
+    { // queue lag alone drains by itself once the capacity suffices
+        reason = "latency above target";
+        if (accumulation > solve_ && packet > s.min_packet)
+            new_packet = std::max(s.min_packet, packet * 4 / 5);
+        else
+            new_iterations = std::max(s.min_iterations, iterations * 3 / 4);
+    }
+    else if (latency_ < 0.5 * s.target_latency && capacity_ > 2 * required)
+    {
+        reason = "headroom";
+        int more = std::min(s.max_iterations, iterations + std::max(1, iterations / 4));
+        if (quality_ < s.min_quality && iterations < s.max_iterations)
+        {
+            reason = "headroom, low quality";
+            new_iterations = more;
+        }
+        else if (packet > s.min_packet)
+            new_packet = std::max(s.min_packet, packet * 4 / 5);
+        else
+            new_iterations = more;
+    }
+    // bounds may have changed since the last decision
+    new_packet = std::max(s.min_packet, std::min(s.max_packet, new_packet));
+    new_iterations = std::max(s.min_iterations, std::min(s.max_iterations, new_iterations));
+    if (!reason || (new_packet == packet && new_iterations == iterations))
+    { // spare headroom at the limits is no problem, missing the targets is
+        bool missed = capacity_ < required || accumulation + solve_ > s.target_latency;
+        setSaturated(missed ? reason : NULL, result.t, packet, iterations);
+        return false;
+    }
+    setSaturated(NULL, result.t, packet, iterations);
+
+    setPacketSize(tracker, new_packet);
+    tracker.setIterations(new_iterations);
+    cooldown_ = s.cooldown;
+    decisions_++;
+    autoTunerMetrics().packet.set(new_packet);
+    autoTunerMetrics().iterations.set(new_iterations);
+    autoTunerMetrics().decisions.add();
+    log(result.t, reason, packet, new_packet, iterations, new_iterations);
+    return true;
+}
@@ -0,0 +1,105 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <fstream>
+#include <string>
+
+#include "tracker.h"
+
+// Bounds and goals of the AutoTuner
+struct AutoTunerSettings
+{
+    double target_latency; // seconds from an event to its pose: packet accumulation, queue lag and solve
+    double target_rate;    // events per second to sustain, 0 for the measured input rate
+    double headroom;       // required capacity relative to the rate
+    int min_packet;
+    int max_packet;
+    int min_iterations;
+    int max_iterations;
+    float min_quality; // more iterations below this quality, while there is headroom
+    int window;        // packets per decision
+    int cooldown;      // decisions without a change after a change
+};
+
+AutoTunerSettings defaultAutoTunerSettings(void);
+
+// Online controller for packet size and optimizer iterations. Over every
+// window of packets it compares the measured solve time, queue lag, input
+// rate and tracking quality with the latency and rate targets. It then makes
+// one bounded step:
+//  - too slow for the event rate: fewer iterations, then larger packets
+//  - packet accumulation and solve above the latency target: smaller packets
+//    if accumulation dominates, else fewer iterations
+//  - headroom: more iterations if the quality is low, else smaller packets, else more iterations
+// Every change is logged with the measurements that caused it. So is a
+// missed target that the limits leave no step for; the tuner then counts as
+// saturated until a step is possible again.
+class AutoTuner
+{
+public:
+    AutoTuner();
+
+    void setSettings(const AutoTunerSettings &settings) { settings_ = settings; }
+    const AutoTunerSettings &settings(void) const { return settings_; }
+    // Appends decisions to filename, empty for stdout
+    bool openLog(const std::string &filename);
+    void reset(void);
+
+    // After every packet: events of the packet, their sensor time span,
+    // wall time of Tracker::track and the lag of the queue, in seconds.
+    // Returns true if packet size or iterations of the tracker were changed.
+    bool update(Tracker &tracker, const TrackingResult &result, size_t events, double span, double solve, double lag);
+
+    long decisions(void) const { return decisions_; }
+    // true while the targets are missed and the limits allow no step
+    bool saturated(void) const { return saturated_ != NULL; }
+
+protected:
+    // packet events in the tracker's current mode
+    static int packetSize(const Tracker &tracker) { return tracker.packetSize(); }
+    static void setPacketSize(Tracker &tracker, int events);
+    void log(double t, const char *reason, int packet, int new_packet, int iterations, int new_iterations);
+    void setSaturated(const char *reason, double t, int packet, int iterations);
+
+    AutoTunerSettings settings_;
+    std::ofstream file_;
+
+    // measurements of the current window
+    int packets_;
+    double events_;
+    double span_;
+    double solve_sum_;
+    double lag_max_;
+    double quality_sum_;
+    int cooldown_;
+    long decisions_;
+    const char *saturated_; // reason of the step beyond the limits, NULL if none
+
+    // last window, for the log
+    double rate_;
+    double capacity_;
+    double latency_;
+    double solve_;
+    double lag_;
+    float quality_;
+};
+
+#endif // AUTOTUNER_H
@@ -0,0 +1,209 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "benchmark.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+
+double BenchmarkResult::mean() const
+{
+    if (samples.empty())
+        return 0;
+    double sum = 0;
+    for (size_t i = 0; i < samples.size(); i++)
+        sum += samples[i];
+    return sum / samples.size();
+}
+
+double BenchmarkResult::percentile(double p) const
+{
+    if (samples.empty())
+        return 0;
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5))];
+}
+
+double BenchmarkResult::throughput() const
+{
+    double m = median();
+    return m > 0 ? items_per_sample / m * 1e6 : 0;
+}
+
+std::string benchmarkKey(const BenchmarkResult &result)
+{
+    std::stringstream key;
+    key << result.name;
+    if (!result.parameters.empty())
+    {
+        key << "[";
+        for (size_t i = 0; i < result.parameters.size(); i++)
+            key << (i ? "," : "") << result.parameters[i].first << "=" << result.parameters[i].second;
+        key << "]";
+    }
+    return key.str();
+}
+
+BenchmarkResult &BenchmarkReport::add(std::string name, double items_per_sample)
+{
+    results_.push_back(BenchmarkResult());
+    results_.back().name = name;
+    results_.back().items_per_sample = items_per_sample;
+    return results_.back();
+}
+
+void BenchmarkReport::print() const
+{
+    for (size_t i = 0; i < results_.size(); i++)
+    {
+        const BenchmarkResult &r = results_[i];
+        std::cout << std::left << std::setw(60) << benchmarkKey(r) << std::right << std::fixed << std::setprecision(1)
+                  << " median " << std::setw(10) << r.median() << "us  p95 " << std::setw(10) << r.percentile(0.95) << "us";
+        if (r.items_per_sample > 0)
+            std::cout << "  " << std::setprecision(2) << r.throughput() * 1e-6 << " Mev/s";
+        for (size_t k = 0; k < r.metrics.size(); k++)
+            std::cout << "  " << r.metrics[k].first << " " << std::setprecision(3) << r.metrics[k].second;
+        std::cout << std::endl;
+    }
+}
+
+bool BenchmarkReport::writeJson(std::string filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file.good())
+        return false;
+    file << "{" << std::endl
+         << "  \"info\": {";
+    for (size_t i = 0; i < info_.size(); i++)
+        file << (i ? ", " : "") << "\"" << info_[i].first << "\": \"" << info_[i].second << "\"";
+    file << "}," << std::endl
+         << "  \"results\": [" << std::endl;
+    file << std::setprecision(9);
+    for (size_t i = 0; i < results_.size(); i++)
+    {
+        const BenchmarkResult &r = results_[i];
+        file << "    {\"key\": \"" << benchmarkKey(r) << "\", \"name\": \"" << r.name << "\", \"parameters\": {";
+        for (size_t k = 0; k < r.parameters.size(); k++)
+            file << (k ? ", " : "") << "\"" << r.parameters[k].first << "\": " << r.parameters[k].second;
+        file << "}, \"samples\": " << r.samples.size()
+             << ", \"mean_us\": " << r.mean()
+             << ", \"median_us\": " << r.median()
+             << ", \"min_us\": " << r.percentile(0)
+             << ", \"p95_us\": " << r.percentile(0.95)
+             << ", \"p99_us\": " << r.percentile(0.99)
+             << ", \"items_per_second\": " << r.throughput();
+        for (size_t k = 0; k < r.metrics.size(); k++)
+            file << ", \"" << r.metrics[k].first << "\": " << r.metrics[k].second;
+        file << "}"
+             << (i + 1 < results_.size() ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl
+         << "}" << std::endl;
+    return file.good();
+}
+
+// columns are the union of all parameter and metric names, in order of appearance
+static void addColumns(const std::vector<std::pair<std::string, double> > &values, std::vector<std::string> &columns)
+{
+    for (size_t i = 0; i < values.size(); i++)
+        if (std::find(columns.begin(), columns.end(), values[i].first) == columns.end())
+            columns.push_back(values[i].first);
+}
+
+static void writeColumns(std::ofstream &file, const std::vector<std::pair<std::string, double> > &values, const std::vector<std::string> &columns)
+{
+    for (size_t c = 0; c < columns.size(); c++)
+    {
+        file << ",";
+        for (size_t i = 0; i < values.size(); i++)
+            if (values[i].first == columns[c])
+            {
+                file << values[i].second;
+                break;
+            }
+    }
+}
+
+bool BenchmarkReport::writeCsv(std::string filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file.good())
+        return false;
+    std::vector<std::string> parameters, metrics;
+    for (size_t i = 0; i < results_.size(); i++)
+    {
+        addColumns(results_[i].parameters, parameters);
+        addColumns(results_[i].metrics, metrics);
+    }
+    file << "name";
+    for (size_t c = 0; c < parameters.size(); c++)
+        file << "," << parameters[c];
+    file << ",samples,mean_us,median_us,p95_us,p99_us,items_per_second";
+    for (size_t c = 0; c < metrics.size(); c++)
+        file << "," << metrics[c];
+    file << std::endl
+         << std::setprecision(9);
+    for (size_t i = 0; i < results_.size(); i++)
+    {
+        const BenchmarkResult &r = results_[i];
+        file << r.name;
+        writeColumns(file, r.parameters, parameters);
+        file << "," << r.samples.size() << "," << r.mean() << "," << r.median() << "," << r.percentile(0.95) << ","
+             << r.percentile(0.99) << "," << r.throughput();
+        writeColumns(file, r.metrics, metrics);
+        file << std::endl;
+    }
+    return file.good();
+}
+
+// Reads back only what writeJson writes: one result per line with "key" and "median_us"
+int BenchmarkReport::compareTo(std::string filename, double tolerance) const
+{
+    std::ifstream file(filename.c_str());
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t key = line.find("\"key\": \"");
+        size_t median = line.find("\"median_us\": ");
+        if (key == std::string::npos || median == std::string::npos)
+            continue;
+        key += 8;
+        baseline[line.substr(key, line.find('"', key) - key)] = atof(line.c_str() + median + 13);
+    }
+
+    int regressions = 0;
+    for (size_t i = 0; i < results_.size(); i++)
+    {
+        std::map<std::string, double>::const_iterator it = baseline.find(benchmarkKey(results_[i]));
+        if (it == baseline.end() || it->second <= 0)
+            continue;
+        double change = results_[i].median() / it->second - 1;
+        if (change > tolerance)
+        {
+            std::cout << "REGRESSION " << it->first << ": " << it->second << "us -> " << results_[i].median() << "us (+" << change * 100 << "%)" << std::endl;
+            regressions++;
+        }
+    }
+    return regressions;
+}
@@ -0,0 +1,68 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+
+// Timing samples of one benchmark, in microseconds
+struct BenchmarkResult
+{
+    std::string name;
+    std::vector<std::pair<std::string, double> > parameters;
+    std::vector<double> samples;
+    double items_per_sample; // events processed per sample, for the throughput
+    std::vector<std::pair<std::string, double> > metrics; // e.g. accuracy, written next to the timings
+
+    double mean(void) const;
+    double percentile(double p) const;
+    double median(void) const { return percentile(0.5); }
+    double throughput(void) const; // items per second at the median
+};
+
+// Collects results and writes them as JSON, one result per line, so that
+// reports of two builds can be compared with diff or compareTo
+class BenchmarkReport
+{
+public:
+    void setInfo(std::string key, std::string value) { info_.push_back(std::make_pair(key, value)); }
+    BenchmarkResult &add(std::string name, double items_per_sample = 0);
+    std::deque<BenchmarkResult> &results(void) { return results_; }
+    const std::deque<BenchmarkResult> &results(void) const { return results_; }
+
+    void print(void) const;
+    bool writeJson(std::string filename) const;
+    // One row per result, columns for every parameter and metric
+    bool writeCsv(std::string filename) const;
+
+    // Compares the medians against a report written by writeJson. Returns the
+    // number of benchmarks that got slower by more than the relative tolerance.
+    int compareTo(std::string filename, double tolerance) const;
+
+protected:
+    std::vector<std::pair<std::string, std::string> > info_;
+    std::deque<BenchmarkResult> results_; // references returned by add stay valid
+};
+
+// Unique key of a result: name plus its parameters, e.g. "pose_update[events=1500,iterations=10]"
+std::string benchmarkKey(const BenchmarkResult &result);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,370 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// system includes
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
+#include "iu/iucutil.h"
+
+#include "event.h"
+#include "common.h"
+#include "direct.cuh"
+#include "parameters.h"
+#include "scopedtimer.h"
+#include "benchmarkworker.h"
+#include "eventsimulator.h"
+#include "benchmark.h"
+#include "trackerpool.h"
+
+struct Configuration
+{
+    int packet;
+    int iterations;
+    float upscale;
+    int panorama_width;
+};
+
+static void usage(const char *name)
+{
+    std::cout << "usage: " << name << " <calibration file> [options]" << std::endl
+              << "  --panorama <file>       scene for the generated events (default: procedural)" << std::endl
+              << "  --duration <s>          length of the generated sequence (default 1)" << std::endl
+              << "  --repetitions <n>       samples per microbenchmark (default 50)" << std::endl
+              << "  --output <file.json>    write the results as JSON" << std::endl
+              << "  --baseline <file.json>  compare against an earlier report, exit code 2 on regressions" << std::endl
+              << "  --tolerance <r>         allowed relative slowdown of the median (default 0.1)" << std::endl
+              << "  --quick                 only the default end-to-end configuration" << std::endl
+              << "  --load <file.txt>       also time loading a (large) text event file" << std::endl;
+}
+
+// median of repetitions runs of f
+template <class F>
+static void measure(BenchmarkResult &result, int repetitions, F f)
+{
+    f(); // warm-up
+    for (int i = 0; i < repetitions; i++)
+    {
+        double start = ScopedTimer::getCurrentTime();
+        f();
+        result.samples.push_back(ScopedTimer::getCurrentTime() - start);
+    }
+}
+
+// the text loader before it was parallelized, as reference
+static void loadEventsIostream(std::vector<Event> &events, std::string filename)
+{
+    std::ifstream ifs(filename.c_str());
+    Event temp_event;
+    while (ifs >> temp_event.t >> temp_event.x >> temp_event.y >> temp_event.polarity)
+        events.push_back(temp_event);
+}
+
+// text parsing throughput on one file: iostream reference, one and all threads
+static void loadBenchmarks(BenchmarkReport &report, std::string filename, int repetitions)
+{
+    std::vector<Event> loaded;
+    loadEvents(loaded, filename);
+    std::ifstream file(filename.c_str(), std::ios::ate | std::ios::binary);
+    std::pair<std::string, double> size("megabytes", file.tellg() / 1e6);
+    std::cout << "loading " << filename << ": " << size.second << " MB, " << loaded.size() << " events" << std::endl;
+
+    BenchmarkResult &reference = report.add("load_events_iostream", loaded.size());
+    reference.parameters.push_back(size);
+    measure(reference, repetitions, [&]() {
+        std::vector<Event> events;
+        loadEventsIostream(events, filename);
+    });
+    for (int threads = 1; threads >= 0; threads--)
+    {
+        BenchmarkResult &parse = report.add("load_events", loaded.size());
+        parse.parameters.push_back(size);
+        parse.parameters.push_back(std::make_pair("threads", (double)threads));
+        measure(parse, repetitions, [&]() {
+            std::vector<Event> events;
+            loadEvents(events, filename, threads);
+        });
+    }
+}
+
+static std::vector<Event> packet(const std::vector<Event> &events, size_t begin, size_t size)
+{
+    begin = std::min(begin, events.size() - std::min(size, events.size()));
+    return std::vector<Event>(events.begin() + begin, events.begin() + std::min(events.size(), begin + size));
+}
+
+static void microbenchmarks(BenchmarkReport &report, const Parameters &parameters, const std::vector<Event> &events, int repetitions)
+{
+    const int sizes[] = {500, 1500, 5000};
+
+    // parsing of the text format
+    std::string filename = "/tmp/dvs_benchmark_events.txt";
+    std::vector<Event> file_events = packet(events, 0, 1000000);
+    {
+        EventWriter writer(filename);
+        writer.write(file_events);
+    }
+    BenchmarkResult &parse = report.add("load_events", file_events.size());
+    measure(parse, std::max(1, repetitions / 10), [&]() {
+        std::vector<Event> loaded;
+        loadEvents(loaded, filename);
+    });
+    BenchmarkResult &parse_single = report.add("load_events", file_events.size());
+    parse_single.parameters.push_back(std::make_pair("threads", 1.));
+    measure(parse_single, std::max(1, repetitions / 10), [&]() {
+        std::vector<Event> loaded;
+        loadEvents(loaded, filename, 1);
+    });
+    std::remove(filename.c_str());
+
+    BenchmarkWorker worker(parameters, 1.f);
+    // build a map first, gradients of an empty map are meaningless
+    for (size_t i = 0; i + 1500 <= events.size() && i < 200 * 1500; i += 1500)
+    {
+        std::vector<Event> p = packet(events, i, 1500);
+        worker.trackSynchronized(p);
+    }
+
+    for (int s = 0; s < 3; s++)
+    {
+        std::vector<Event> p = packet(events, events.size() / 2, sizes[s]);
+        std::pair<std::string, double> size("events", p.size());
+
+        BenchmarkResult &undistort = report.add("undistort", p.size());
+        undistort.parameters.push_back(size);
+        measure(undistort, repetitions, [&]() { worker.undistort(p); });
+
+        BenchmarkResult &upload = report.add("upload", p.size());
+        upload.parameters.push_back(size);
+        measure(upload, repetitions, [&]() { worker.upload(p); });
+
+        BenchmarkResult &gradients = report.add("gradients", p.size());
+        gradients.parameters.push_back(size);
+        measure(gradients, repetitions, [&]() { worker.gradients(); });
+
+        for (int iterations = 1; iterations <= 10; iterations += 9)
+        {
+            worker.setIterations(iterations);
+            BenchmarkResult &pose = report.add("pose_update", p.size());
+            pose.parameters.push_back(size);
+            pose.parameters.push_back(std::make_pair("iterations", (double)iterations));
+            measure(pose, repetitions, [&]() { worker.poseUpdate(); });
+        }
+
+        BenchmarkResult &fusion = report.add("map_fusion", p.size());
+        fusion.parameters.push_back(size);
+        measure(fusion, repetitions, [&]() { worker.mapFusion(); });
+
+        BenchmarkResult &render = report.add("render", p.size());
+        render.parameters.push_back(size);
+        measure(render, repetitions, [&]() { worker.render(); });
+    }
+}
+
+// per packet time of the whole tracking loop
+static void endToEnd(BenchmarkReport &report, Parameters parameters, const std::vector<Event> &events, const Configuration &c)
+{
+    parameters.output_size_x = c.panorama_width;
+    parameters.output_size_y = c.panorama_width / 2;
+    parameters.px = parameters.output_size_x / 2.f;
+    parameters.py = parameters.output_size_y / 2.f;
+    BenchmarkWorker worker(parameters, c.upscale);
+    worker.setEventsPerImage(c.packet);
+    worker.setIterations(c.iterations);
+
+    BenchmarkResult &result = report.add("track", c.packet);
+    result.parameters.push_back(std::make_pair("events", (double)c.packet));
+    result.parameters.push_back(std::make_pair("iterations", (double)c.iterations));
+    result.parameters.push_back(std::make_pair("upscale", (double)c.upscale));
+    result.parameters.push_back(std::make_pair("panorama_width", (double)c.panorama_width));
+    for (size_t i = 0; i + c.packet <= events.size(); i += c.packet)
+    {
+        std::vector<Event> p = packet(events, i, c.packet);
+        double start = ScopedTimer::getCurrentTime();
+        worker.trackSynchronized(p);
+        result.samples.push_back(ScopedTimer::getCurrentTime() - start);
+    }
+}
+
+// several trackers with different calibrations sharing one TrackerPool; a
+// sample is the wall time until every stream has tracked the whole sequence
+static void concurrentStreams(BenchmarkReport &report, const Parameters &parameters, const std::vector<Event> &events, int streams, int repetitions)
+{
+    BenchmarkResult &result = report.add("track_streams", (double)streams * events.size());
+    result.parameters.push_back(std::make_pair("streams", (double)streams));
+    for (int r = 0; r < repetitions; r++)
+    {
+        std::vector<std::unique_ptr<Tracker> > trackers;
+        TrackerPool pool(streams);
+        for (int i = 0; i < streams; i++)
+        {
+            Parameters p = parameters;
+            p.K_cam(0, 0) *= 1.f + 0.01f * i;
+            p.K_cam(1, 1) *= 1.f + 0.01f * i;
+            trackers.push_back(std::unique_ptr<Tracker>(new Tracker(p)));
+        }
+        double start = ScopedTimer::getCurrentTime();
+        for (int i = 0; i < streams; i++)
+        {
+            pool.addStream(trackers[i].get());
+            pool.addEvents(i, events);
+            pool.flush(i);
+        }
+        pool.waitAll();
+        CudaSafeCall(cudaDeviceSynchronize());
+        result.samples.push_back(ScopedTimer::getCurrentTime() - start);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string panorama_file, output_file, baseline_file, load_file;
+    double duration = 1.0, tolerance = 0.1;
+    int repetitions = 50;
+    bool quick = false;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--panorama" && has_value)
+            panorama_file = argv[++i];
+        else if (arg == "--duration" && has_value)
+            duration = atof(argv[++i]);
+        else if (arg == "--repetitions" && has_value)
+            repetitions = std::max(1, atoi(argv[++i]));
+        else if (arg == "--output" && has_value)
+            output_file = argv[++i];
+        else if (arg == "--baseline" && has_value)
+            baseline_file = argv[++i];
+        else if (arg == "--tolerance" && has_value)
+            tolerance = atof(argv[++i]);
+        else if (arg == "--quick")
+            quick = true;
+        else if (arg == "--load" && has_value)
+            load_file = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Parameters parameters;
+    parameters.readFromfile(argv[1]);
+    parameters.pose_output_dir = "/tmp";
+
+    Panorama panorama;
+    if (panorama_file.empty())
+        proceduralPanorama(2048, 1024, panorama);
+    else if (!loadPanorama(panorama_file, panorama))
+    {
+        std::cerr << "could not read panorama " << panorama_file << std::endl;
+        return 1;
+    }
+
+    // the same sequence for every run: fixed trajectory and threshold seed
+    SinusoidalTrajectory trajectory(Eigen::Vector3f(0.3f, 0.3f, 0.6f), Eigen::Vector3f(0.5f, 0.4f, 0.3f));
+    EventSimulator simulator(parameters, panorama, trajectory);
+    simulator.setContrastThreshold(0.15f, 0.02f, 0);
+    std::vector<Event> events;
+    simulator.simulate(duration, events);
+    std::cout << "generated " << events.size() << " events" << std::endl;
+    if (events.size() < 10000)
+    {
+        std::cerr << "not enough events, use a longer --duration or a textured panorama" << std::endl;
+        return 1;
+    }
+
+    BenchmarkReport report;
+    cudaDeviceProp device;
+    CudaSafeCall(cudaGetDeviceProperties(&device, 0));
+    time_t now = time(NULL);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    report.setInfo("date", date);
+    report.setInfo("device", device.name);
+    report.setInfo("calibration", argv[1]);
+    report.setInfo("panorama", panorama_file.empty() ? "procedural" : panorama_file);
+    std::stringstream count;
+    count << events.size();
+    report.setInfo("events", count.str());
+
+    microbenchmarks(report, parameters, events, repetitions);
+    if (!load_file.empty())
+        loadBenchmarks(report, load_file, 2);
+
+    // vary one parameter at a time around the default configuration
+    Configuration base = {1500, 10, 1.f, parameters.output_size_x};
+    std::vector<Configuration> configurations(1, base);
+    if (!quick)
+    {
+        const int packets[] = {500, 5000};
+        const int iterations[] = {1, 5, 20};
+        const float upscales[] = {1.5f, 2.f};
+        const int widths[] = {1024, 4096};
+        for (int i = 0; i < 2; i++)
+        {
+            Configuration c = base;
+            c.packet = packets[i];
+            configurations.push_back(c);
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            Configuration c = base;
+            c.iterations = iterations[i];
+            configurations.push_back(c);
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            Configuration c = base;
+            c.upscale = upscales[i];
+            configurations.push_back(c);
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            Configuration c = base;
+            c.panorama_width = widths[i];
+            if (c.panorama_width != base.panorama_width)
+                configurations.push_back(c);
+        }
+    }
+    for (size_t i = 0; i < configurations.size(); i++)
+        endToEnd(report, parameters, events, configurations[i]);
+    if (!quick)
+        for (int streams = 1; streams <= 4; streams *= 2)
+            concurrentStreams(report, parameters, events, streams, 3);
+
+    report.print();
+    if (!output_file.empty() && !report.writeJson(output_file))
+    {
+        std::cerr << "could not write " << output_file << std::endl;
+        return 1;
+    }
+    if (!baseline_file.empty() && report.compareTo(baseline_file, tolerance) > 0)
+        return 2;
+    return 0;
+}
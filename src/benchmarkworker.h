@@ -0,0 +1,79 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BENCHMARKWORKER_H
+#define BENCHMARKWORKER_H
+
+#include <vector>
+#include <cuda_runtime.h>
+#include "iu/iucutil.h"
+
+#include "common.h"
+#include "direct.cuh"
+#include "tracker.h"
+
+// Exposes the stages of Tracker::track to the benchmarks
+class BenchmarkWorker : public Tracker
+{
+public:
+    BenchmarkWorker(const Parameters &parameters, float upscale) : Tracker(parameters, 0, upscale)
+    {
+        output_color_ = new iu::ImageGpu_8u_C4(output_->size());
+        last_.t = 0;
+    }
+    ~BenchmarkWorker() { delete output_color_; }
+
+    void undistort(std::vector<Event> &events)
+    {
+        for (size_t i = 0; i < events.size(); i++)
+            ::undistortPoint(events[i], undistorted, width_, height_);
+    }
+    void upload(std::vector<Event> &events) { uploadEvents(events.data(), events.size()); }
+    void gradients(void)
+    {
+        cuda::getGradients(geometry_, image_gradients_gpu_, output_, events_gpu_, make_float3(pose_(0), pose_(1), pose_(2)));
+        iu::copy(image_gradients_gpu_, image_gradients_cpu_);
+    }
+    void poseUpdate(void)
+    {
+        Eigen::Vector3f pose = pose_;
+        updatePose();
+        pose_ = pose; // every repetition starts from the same pose
+    }
+    void mapFusion(void)
+    {
+        cuda::updateMap(geometry_, output_, occurences_, normalization_, events_gpu_, make_float3(pose_(0), pose_(1), pose_(2)), make_float3(old_pose_(0), old_pose_(1), old_pose_(2)), width_, height_);
+        CudaSafeCall(cudaDeviceSynchronize());
+    }
+    void render(void)
+    {
+        Tracker::render(output_color_, true, true);
+        CudaSafeCall(cudaDeviceSynchronize());
+    }
+    void trackSynchronized(std::vector<Event> &events)
+    {
+        last_ = track(events);
+        CudaSafeCall(cudaDeviceSynchronize());
+    }
+    double poseTime(void) const { return last_.t; }
+
+protected:
+    iu::ImageGpu_8u_C4 *output_color_;
+    TrackingResult last_;
+};
+
+#endif // BENCHMARKWORKER_H
@@ -15,57 +15,12 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-#include "dvscameraworker.h"
 
-void DVSCameraWorker::run()
-{
-    if(init()) {
-        running_ = true;
-        while(running_)
-        {
-            // get event and update timestamps
-            caerEventPacketContainer packetContainer = caerDeviceDataGet(dvs128_handle_);
-            if (packetContainer == NULL) {
-                msleep(1);
-                continue; // Skip if nothing there.
-            }
-            events_buffer_.clear();
-            int32_t packetNum = caerEventPacketContainerGetEventPacketsNumber(packetContainer);
-            for (int32_t i = 0; i < packetNum; i++) {
-                caerEventPacketHeader packetHeader = caerEventPacketContainerGetEventPacket(packetContainer, i);
-                if (packetHeader == NULL) {
-                    continue; // Skip if nothing there.
-                }
-                // Packet 0 is always the special events packet for DVS128, while packet is the polarity events packet.
-                if (i == POLARITY_EVENT) {
-
-                    caerPolarityEventPacket polarity = (caerPolarityEventPacket) packetHeader;
-                    for (int32_t caerPolarityIteratorCounter = 0; caerPolarityIteratorCounter < caerEventPacketHeaderGetEventNumber(&(polarity)->packetHeader);caerPolarityIteratorCounter++) {
-                        caerPolarityEvent caerPolarityIteratorElement = caerPolarityEventPacketGetEvent(polarity, caerPolarityIteratorCounter);
-                        if (!caerPolarityEventIsValid(caerPolarityIteratorElement)) { continue; }
-                        Event event;
-                        event.t = caerPolarityEventGetTimestamp(caerPolarityIteratorElement)*1e-6;
-                        event.x = caerPolarityEventGetX(caerPolarityIteratorElement); // don't know why it is other way round?
-                        event.y = caerPolarityEventGetY(caerPolarityIteratorElement);
-                        event.polarity = caerPolarityEventGetPolarity(caerPolarityIteratorElement)?1.0f:-1.0f;
-    //                    if(undistortPoint(event,params.K_cam,params.radial))
-                        events_buffer_.push_back(event);
-                    }
-                }
-            }
-            caerEventPacketContainerFree(packetContainer);
-            ugly_->addEvents(events_buffer_);
-        }
-        deinit();
-    }
-}
+#include "caereventsource.h"
+#include "tracing.h"
+#include "caerpacket.h"
 
-DVSCameraWorker::DVSCameraWorker(TrackingWorker *worker):ugly_(worker)
-{
-
-}
-
-bool DVSCameraWorker::init()
+bool CaerEventSource::open()
 {
     // init camera
     // Open a DVS128, give it a device ID of 1, and don't care about USB bus or SN restrictions.
@@ -113,10 +68,41 @@ bool DVSCameraWorker::init()
     return true;
 }
 
-void DVSCameraWorker::deinit()
+void CaerEventSource::close()
 {
+    if (!dvs128_handle_)
+        return;
     caerDeviceDataStop(dvs128_handle_);
 
     caerDeviceClose(&dvs128_handle_);
+    dvs128_handle_ = NULL;
 }
 
+bool CaerEventSource::read(std::vector<Event> &batch)
+{
+    batch.clear();
+    if (!dvs128_handle_)
+        return false;
+    // get event and update timestamps
+    caerEventPacketContainer packetContainer = caerDeviceDataGet(dvs128_handle_);
+    if (packetContainer == NULL)
+        return true; // Skip if nothing there.
+    if (recorder_)
+    {
+        TRACE_SCOPE("record");
+        int32_t packetNum = caerEventPacketContainerGetEventPacketsNumber(packetContainer);
+        for (int32_t i = 0; i < packetNum; i++) {
+            caerEventPacketHeader packetHeader = caerEventPacketContainerGetEventPacket(packetContainer, i);
+            if (packetHeader != NULL)
+                recorder_->write(packetHeader);
+        }
+    }
+    TraceSpan span("decode");
+    // Packet 0 is always the special events packet for DVS128, while packet is the polarity events packet.
+    caerEventPacketHeader packetHeader = caerEventPacketContainerGetEventPacket(packetContainer, POLARITY_EVENT);
+    if (packetHeader != NULL)
+        decodeCaerPolarityPacket(packetHeader, batch);
+    caerEventPacketContainerFree(packetContainer);
+    span.setArg(batch.size());
+    return true;
+}
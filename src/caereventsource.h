@@ -0,0 +1,47 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef CAEREVENTSOURCE_H
+#define CAEREVENTSOURCE_H
+
+#include <libcaer/libcaer.h>
+#include <libcaer/devices/dvs128.h>
+
+#include "eventsource.h"
+#include "recorder.h"
+
+// Live events of a DVS128 through libcaer, one batch per packet container
+class CaerEventSource : public EventSource
+{
+public:
+    CaerEventSource() : dvs128_handle_(NULL), recorder_(NULL) {}
+    ~CaerEventSource() { close(); }
+    bool open(void);
+    void close(void);
+    bool isOpen(void) const { return dvs128_handle_ != NULL; }
+    bool read(std::vector<Event> &batch);
+    bool realTime(void) const { return true; }
+    // every packet read is also appended to recorder, not owned
+    void setRecorder(EventRecorder *recorder) { recorder_ = recorder; }
+
+protected:
+    caerDeviceHandle dvs128_handle_;
+    EventRecorder *recorder_;
+};
+
+#endif // CAEREVENTSOURCE_H
@@ -0,0 +1,71 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "caerpacket.h"
+#include <cstring>
+
+static_assert(sizeof(CaerPacketHeader) == 28, "libcaer packet header is 28 bytes");
+
+// polarity event: uint32 data (valid bit 0, polarity bit 1, y bits 2-16,
+// x bits 17-31) and int32 timestamp in microseconds
+static const uint32_t polarity_valid = 0x1;
+static const uint32_t polarity_on = 0x2;
+static const int polarity_y_shift = 2;
+static const int polarity_x_shift = 17;
+static const uint32_t polarity_address_mask = 0x7FFF;
+
+size_t caerPacketSize(const CaerPacketHeader &header)
+{
+    if (header.event_size < 8 || header.event_number < 0 || header.event_ts_offset < 0 ||
+        header.event_ts_offset + 4 > header.event_size)
+        return 0;
+    return sizeof(CaerPacketHeader) + (size_t)header.event_number * header.event_size;
+}
+
+size_t decodeCaerPolarityPacket(const void *packet, std::vector<Event> &events)
+{
+    CaerPacketHeader header;
+    memcpy(&header, packet, sizeof(header));
+    if (header.event_type != CAER_POLARITY_EVENT_TYPE || caerPacketSize(header) == 0)
+        return 0;
+    const char *raw = static_cast<const char *>(packet) + sizeof(header);
+    size_t first = events.size();
+    events.resize(first + header.event_number);
+    Event *out = events.data() + first;
+    // timestamps wrap every 2^31 us, the overflow counter extends them
+    int64_t ts_base = (int64_t)header.event_ts_overflow << 31;
+    size_t valid = 0;
+    for (int32_t i = 0; i < header.event_number; i++)
+    {
+        uint32_t data;
+        int32_t ts;
+        memcpy(&data, raw + (size_t)i * header.event_size, 4);
+        memcpy(&ts, raw + (size_t)i * header.event_size + header.event_ts_offset, 4);
+        // every event is written, invalid ones are overwritten by the next
+        Event &event = out[valid];
+        event.t = (ts_base + ts) * 1e-6;
+        event.x = (data >> polarity_x_shift) & polarity_address_mask;
+        event.y = (data >> polarity_y_shift) & polarity_address_mask;
+        event.polarity = (data & polarity_on) ? 1.f : -1.f;
+        event.x_undist = 0;
+        event.y_undist = 0;
+        valid += data & polarity_valid;
+    }
+    events.resize(first + valid);
+    return valid;
+}
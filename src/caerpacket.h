@@ -0,0 +1,56 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef CAERPACKET_H
+#define CAERPACKET_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "event.h"
+
+// Layout of libcaer's event packet header, which precedes the events of a
+// packet in memory and in AEDAT 3 files. Declared here so that packets can
+// be decoded without libcaer, e.g. from recordings.
+struct CaerPacketHeader
+{
+    int16_t event_type;
+    int16_t event_source;
+    int32_t event_size;
+    int32_t event_ts_offset;
+    int32_t event_ts_overflow;
+    int32_t event_capacity;
+    int32_t event_number;
+    int32_t event_valid;
+};
+
+enum
+{
+    CAER_POLARITY_EVENT_TYPE = 1
+};
+
+// Appends the valid events of a polarity packet (header and event_number
+// events) to events in one pass over the raw event words, without libcaer
+// accessors. Returns the number of events appended, 0 for other packets.
+size_t decodeCaerPolarityPacket(const void *packet, std::vector<Event> &events);
+
+// Size of a packet including its header, 0 if the header is implausible
+size_t caerPacketSize(const CaerPacketHeader &header);
+
+#endif // CAERPACKET_H
@@ -0,0 +1,116 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CAMERAMODELS_CUH
+#define CAMERAMODELS_CUH
+
+#include <cuda_runtime.h>
+#include <cmath>
+
+#include "common.h"
+
+// Camera models are policy classes with static __host__ __device__ members.
+// The kernels and the host-side optimizer are instantiated per model, so the
+// per-event code contains no runtime switch.
+//
+// bearing() maps an undistorted pixel to a ray in the map (sphere) frame. The
+// fixed axis permutation between camera and sphere frame (camera z -> sphere x,
+// camera x -> sphere y, camera y -> sphere z) is part of it and resolved at
+// compile time.
+// distort() maps an ideal normalized image point to a distorted one and is used
+// to build the undistortion lookup table on the host.
+
+enum CameraModel
+{
+    CAMERA_PINHOLE,
+    CAMERA_RADTAN,
+    CAMERA_EQUIDISTANT
+};
+
+struct CameraGeometry
+{
+    float fx;
+    float fy;
+    float cx;
+    float cy;
+    Distort distort;
+};
+
+inline __host__ __device__ float3 toSphereFrame(float x, float y, float z)
+{
+    return make_float3(z, x, y);
+}
+
+struct PinholeCamera
+{
+    static __host__ __device__ float3 bearing(const CameraGeometry &cam, float2 px)
+    {
+        return toSphereFrame((px.x - cam.cx) / cam.fx, (px.y - cam.cy) / cam.fy, 1.f);
+    }
+
+    static __host__ __device__ float2 distort(const CameraGeometry &cam, float2 xn)
+    {
+        return xn;
+    }
+};
+
+// Brown-Conrady radial-tangential model with k1, k2, k3, p1, p2
+struct RadTanCamera
+{
+    static __host__ __device__ float3 bearing(const CameraGeometry &cam, float2 px)
+    {
+        return PinholeCamera::bearing(cam, px);
+    }
+
+    static __host__ __device__ float2 distort(const CameraGeometry &cam, float2 xn)
+    {
+        const Distort &d = cam.distort;
+        float r2 = xn.x * xn.x + xn.y * xn.y;
+        float radial = 1.f + r2 * (d.k1 + r2 * (d.k2 + r2 * d.k3));
+        return make_float2(xn.x * radial + 2.f * d.p1 * xn.x * xn.y + d.p2 * (r2 + 2.f * xn.x * xn.x),
+                           xn.y * radial + d.p1 * (r2 + 2.f * xn.y * xn.y) + 2.f * d.p2 * xn.x * xn.y);
+    }
+};
+
+// Equidistant fisheye (Kannala-Brandt). The undistorted image is the ideal
+// equidistant projection r = f*theta, which stays valid beyond 180 deg FOV.
+struct EquidistantCamera
+{
+    static __host__ __device__ float3 bearing(const CameraGeometry &cam, float2 px)
+    {
+        float x = (px.x - cam.cx) / cam.fx;
+        float y = (px.y - cam.cy) / cam.fy;
+        float theta = sqrtf(x * x + y * y);
+        if (theta < 1e-8f)
+            return toSphereFrame(0.f, 0.f, 1.f);
+        float s = sinf(theta) / theta;
+        return toSphereFrame(x * s, y * s, cosf(theta));
+    }
+
+    static __host__ __device__ float2 distort(const CameraGeometry &cam, float2 xn)
+    {
+        const Distort &d = cam.distort;
+        float theta = sqrtf(xn.x * xn.x + xn.y * xn.y);
+        if (theta < 1e-8f)
+            return xn;
+        float t2 = theta * theta;
+        float theta_d = theta * (1.f + t2 * (d.k1 + t2 * (d.k2 + t2 * (d.k3 + t2 * d.k4))));
+        return make_float2(xn.x * theta_d / theta, xn.y * theta_d / theta);
+    }
+};
+
+#endif // CAMERAMODELS_CUH
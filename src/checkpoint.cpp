@@ -0,0 +1,93 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+
+static const char checkpoint_magic[8] = "DVSCKPT";
+static const uint32_t checkpoint_version = 1;
+static const size_t checkpoint_alignment = 4096;
+
+static size_t alignOffset(size_t offset)
+{
+    return (offset + checkpoint_alignment - 1) / checkpoint_alignment * checkpoint_alignment;
+}
+
+static size_t planeOffset(const CheckpointHeader &header, int index)
+{
+    size_t plane_size = (size_t)header.width * header.height * sizeof(float);
+    return alignOffset(sizeof(CheckpointHeader)) + index * alignOffset(plane_size);
+}
+
+void initCheckpointHeader(CheckpointHeader &header)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+    header.version = checkpoint_version;
+    header.planes = CHECKPOINT_PLANES;
+}
+
+bool writeCheckpoint(const std::string &filename, const CheckpointHeader &header, const std::vector<const float *> &planes)
+{
+    if (planes.size() != header.planes)
+        return false;
+    std::string tmp = filename + ".tmp";
+    FILE *file = fopen(tmp.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t plane_size = (size_t)header.width * header.height * sizeof(float);
+    for (size_t i = 0; ok && i < planes.size(); i++)
+    {
+        ok = fseek(file, planeOffset(header, i), SEEK_SET) == 0 && fwrite(planes[i], 1, plane_size, file) == plane_size;
+    }
+    // pad the last plane so every plane is fully backed by the file
+    if (ok && alignOffset(plane_size) > plane_size)
+        ok = fseek(file, planeOffset(header, planes.size()) - 1, SEEK_SET) == 0 && fputc(0, file) != EOF;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool CheckpointFile::open(const std::string &filename)
+{
+    if (!file_.open(filename))
+        return false;
+    const CheckpointHeader &h = header();
+    if (file_.size() < sizeof(CheckpointHeader) || memcmp(h.magic, checkpoint_magic, sizeof(h.magic)) != 0 ||
+        h.version != checkpoint_version || h.planes != CHECKPOINT_PLANES || h.width <= 0 || h.height <= 0 ||
+        planeOffset(h, h.planes) > file_.size())
+    {
+        file_.close();
+        return false;
+    }
+    // the planes are read once, front to back
+    file_.advise(MADV_SEQUENTIAL);
+    return true;
+}
+
+const float *CheckpointFile::plane(int index) const
+{
+    return reinterpret_cast<const float *>(file_.data() + planeOffset(header(), index));
+}
@@ -0,0 +1,73 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "mappedfile.h"
+
+// Binary tracker state: a fixed header followed by the map planes
+// (width * height float32 each, row major, no padding) at 4 KiB aligned
+// offsets so they can be copied to the GPU straight from the mapping.
+struct CheckpointHeader
+{
+    char magic[8]; // "DVSCKPT\0"
+    uint32_t version;
+    uint32_t planes;
+    int32_t width;
+    int32_t height;
+    int32_t camera_model;
+    int32_t map_projection;
+    float upscale;
+    float pose[3];
+    float old_pose[3];
+    float quality;
+    float async_information[9];
+    int64_t events_tracked;
+    double last_time; // sensor time of the last tracked event
+};
+
+enum CheckpointPlane
+{
+    CHECKPOINT_MAP,
+    CHECKPOINT_OCCURENCES,
+    CHECKPOINT_NORMALIZATION,
+    CHECKPOINT_PLANES
+};
+
+void initCheckpointHeader(CheckpointHeader &header);
+// Written next to filename and renamed, so a crash never leaves a partial file
+bool writeCheckpoint(const std::string &filename, const CheckpointHeader &header, const std::vector<const float *> &planes);
+
+// Read only mapping of a checkpoint
+class CheckpointFile
+{
+public:
+    bool open(const std::string &filename);
+    void close(void) { file_.close(); }
+    const CheckpointHeader &header(void) const { return *reinterpret_cast<const CheckpointHeader *>(file_.data()); }
+    const float *plane(int index) const;
+
+protected:
+    MappedFile file_;
+};
+
+#endif // CHECKPOINT_H
@@ -16,6 +16,8 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "common.h"
+#include "mappedfile.h"
+#include "eventparser.h"
 #include <fstream>
 #include "cnpy.h"
 #include "iu/iuio.h"
@@ -36,6 +38,54 @@ void saveEvents(std::string filename, std::vector<Event> &events)
     file.close();
 }
 
+EventWriter::EventWriter(std::string filename)
+{
+    binary_ = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".dat") == 0;
+    file_ = fopen(filename.c_str(), binary_ ? "wb" : "w");
+}
+
+EventWriter::~EventWriter()
+{
+    if (file_)
+        fclose(file_);
+}
+
+void EventWriter::write(const std::vector<Event> &events)
+{
+    if (!file_)
+        return;
+    if (binary_)
+    {
+        // <timestamp in us> <x | y << 9 | polarity << 17>, see FileEventSource
+        buffer_.resize(events.size() * 8);
+        unsigned int *out = (unsigned int *)buffer_.data();
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            out[2 * i] = (unsigned int)(events[i].t / TIME_CONSTANT + 0.5f);
+            out[2 * i + 1] = (events[i].x & 0x1FF) | ((events[i].y & 0xFF) << 9) | ((events[i].polarity > 0 ? 1 : 0) << 17);
+        }
+        fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    }
+    else
+    {
+        // same format as saveEvents, but without an iostream flush per event.
+        // 40 bytes per event are typical, longer lines grow the buffer.
+        buffer_.resize(std::max(buffer_.size(), events.size() * 40 + 1));
+        size_t used = 0;
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            int n;
+            while ((n = snprintf(buffer_.data() + used, buffer_.size() - used, "%.6f %d %d %d\n", events[i].t, events[i].x, events[i].y, events[i].polarity > 0 ? 1 : -1)) >= 0 &&
+                   (size_t)n >= buffer_.size() - used)
+                buffer_.resize(2 * buffer_.size() + n);
+            if (n < 0)
+                break;
+            used += n;
+        }
+        fwrite(buffer_.data(), 1, used, file_);
+    }
+}
+
 bool undistortPoint(Event &event, const std::vector<int> &undistort, int camera_width, int camera_height)
 {
     int idx = event.y * camera_width + event.x;
@@ -83,33 +133,11 @@ bool undistortPoint(Event &event, const std::vector<int> &undistort, int camera_
 //     }
 // }
 
-void loadEvents(std::vector<Event> &events, std::string filename)
+void loadEvents(std::vector<Event> &events, std::string filename, int threads)
 {
-    std::ifstream ifs;
-    ifs.open(filename.c_str(), std::ifstream::in);
-    if (ifs.good())
-    {
-        Event temp_event;
-        //        double time;
-        //        // throw away the first events
-        //        for(int i=0;i<100000;i++)
-        //        {
-        //            ifs >> time;
-        //            ifs >> temp_event.y;
-        //            ifs >> temp_event.x;
-        //            ifs >> temp_event.polarity;
-        //        }
-        while (!ifs.eof())
-        {
-            ifs >> temp_event.t;
-            ifs >> temp_event.x;
-            ifs >> temp_event.y;
-            ifs >> temp_event.polarity;
-
-            events.push_back(temp_event);
-        }
-        ifs.close();
-    }
+    MappedFile file;
+    if (file.open(filename))
+        parseEvents(file.data(), file.size(), events, threads);
 }
 
 void saveState(std::string filename, const iu::ImageGpu_32f_C1 *mat, bool as_png, bool as_npy, bool as_exr)
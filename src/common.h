@@ -21,6 +21,7 @@
 #include "event.h"
 #include <string>
 #include <vector>
+#include <cstdio>
 #include <Eigen/Dense>
 
 #define GPU_BLOCK_SIZE 16
@@ -35,12 +36,31 @@ struct Distort
     float k2;
     float p1;
     float p2;
+    float k3;
+    float k4; // equidistant model only
 };
 
 // IO functions
 //void loadEvents(std::vector<Event> &events, const Matrix3fr &K, Distort distort, std::string filename);
-void loadEvents(std::vector<Event> &events, std::string filename);
+// Appends the events of a text file, parsed on threads (0: all cores)
+void loadEvents(std::vector<Event> &events, std::string filename, int threads = 0);
 void saveEvents(std::string filename, std::vector<Event> &events);
+
+// Streaming writer for the text format (<t> <x> <y> <p> per line, .txt/.aer2)
+// and the binary format of Bardow et al. (.dat), chosen by file extension.
+class EventWriter
+{
+public:
+    EventWriter(std::string filename);
+    ~EventWriter();
+    bool good(void) const { return file_ != NULL; }
+    void write(const std::vector<Event> &events);
+
+protected:
+    FILE *file_;
+    bool binary_;
+    std::vector<char> buffer_;
+};
 void saveState(std::string filename, const iu::ImageGpu_32f_C1 *mat, bool as_png, bool as_npy, bool as_exr);
 void saveState(std::string filename, const iu::ImageGpu_8u_C4 *mat);
 // helper function
@@ -18,23 +18,6 @@
 #include "direct.cuh"
 #include "iu/iuhelpermath.h"
 
-__constant__ float2 const_pp;
-__constant__ float3 const_Kcaminv[3];
-__constant__ float3 const_Kcam[3];
-__constant__ float  const_scale;
-
-
-
-__device__ float3 ProjectLine(float2 pos)
-{
-    float3 posh = make_float3(pos.x,pos.y,1.f);
-    float3 p;
-    p.x = dot(posh,const_Kcaminv[0]);
-    p.y = dot(posh,const_Kcaminv[1]);
-    p.z = dot(posh,const_Kcaminv[2]);
-    return p;
-}
-
 __device__ __host__ float3 RotatePoint(float3 pos, float3* rotation)
 {
     float3 point;
@@ -105,59 +88,36 @@ inline __device__ int2 round(float2 p)
 __device__ int2 InsideImage(float2 point, int width, int height)
 {
     int2 retval = round(point);
-    if(retval.x<0 || retval.x>width || retval.y<0 || retval.y>height)
+    if(retval.x<0 || retval.x>=width || retval.y<0 || retval.y>=height)
     {
         retval = make_int2(-1,-1);
     }
     return retval;
 }
 
-inline __device__ __host__ float3 RotatePointSpherical(float3 pos, float3* rotation)
+template <class Camera, class Projection>
+inline __device__ float2 ProjectToMap(const CameraGeometry &camera, const MapGeometry &panorama, float2 px, float3 *R)
 {
-    return RotatePoint(make_float3(pos.z,pos.x,pos.y),rotation);
+    return Projection::project(panorama, RotatePoint(Camera::bearing(camera, px), R));
 }
 
-__device__ float2 ProjectMapSpherical(float3 pos)
-{
-
-    // float2 point;
-    // float el = pos.z/sqrt(pos.x*pos.x+pos.y*pos.y);
-    // float az = atan2(pos.y,pos.x);
-
-    // point.x = az/M_PI*const_pp.x*1.7+const_pp.x;
-    // point.y = el*const_pp.y*1.7/(const_pp.x/const_pp.y)+const_pp.y;
-
-    // return point;
-
-    // yunfan
-    float x = pos.x;
-    float y = pos.y;
-    float z = pos.z;
-
-    float rho = sqrt(x*x+y*y+z*z);
-    float2 pt_on_mosaic;
-    pt_on_mosaic.x = const_pp.x + const_scale * const_pp.x * atan2(y,x)/M_PI;
-    pt_on_mosaic.y = const_pp.y + const_scale * (const_pp.y*2) * asin(z/rho)/M_PI;
-    return pt_on_mosaic;
-
-}
-
-
-__global__ void updateOccurences_kernel(iu::ImageGpu_32f_C1::KernelData occurences, iu::LinearDeviceMemory_32f_C2::KernelData events, float3 pose){
+template <class Camera, class Projection>
+__global__ void updateOccurences_kernel(CameraGeometry camera, MapGeometry panorama, iu::ImageGpu_32f_C1::KernelData occurences, iu::LinearDeviceMemory_32f_C2::KernelData events, float3 pose){
     int event_id = blockIdx.x*blockDim.x + threadIdx.x;
 
     if(event_id<events.numel_) {
         // get last template point
         float3 R[3];
         rodrigues(pose,R);
-        float2 p = ProjectMapSpherical(RotatePointSpherical(ProjectLine(events(event_id)),R));
+        float2 p = ProjectToMap<Camera,Projection>(camera,panorama,events(event_id),R);
         int2 idx = InsideImage(p,occurences.width_,occurences.height_);
         if(idx.x>=0)
             occurences(idx.x,idx.y)++;
     }
 }
 
-__global__ void updateNormalization_kernel(iu::ImageGpu_32f_C1::KernelData normalization, float3 pose, float3 old_pose, int cam_width, int cam_height){
+template <class Camera, class Projection>
+__global__ void updateNormalization_kernel(CameraGeometry camera, MapGeometry panorama, iu::ImageGpu_32f_C1::KernelData normalization, float3 pose, float3 old_pose, int cam_width, int cam_height){
     int x = blockIdx.x*blockDim.x + threadIdx.x;
     int y = blockIdx.y*blockDim.y + threadIdx.y;
 
@@ -165,12 +125,12 @@ __global__ void updateNormalization_kernel(iu::ImageGpu_32f_C1::KernelData norma
     {
         float3 R[3];
         rodrigues(pose,R);
-        float2 p_m_curr = ProjectMapSpherical(RotatePointSpherical(ProjectLine(make_float2(x,y)),R));
+        float2 p_m_curr = ProjectToMap<Camera,Projection>(camera,panorama,make_float2(x,y),R);
 
         int2 curr_idx = InsideImage(p_m_curr,normalization.width_,normalization.height_);
         if(curr_idx.x>=0){
             rodrigues(old_pose,R);
-            float2 p_m_old = ProjectMapSpherical(RotatePointSpherical(ProjectLine(make_float2(x,y)),R));
+            float2 p_m_old = ProjectToMap<Camera,Projection>(camera,panorama,make_float2(x,y),R);
 
             // yunfan
             double l = length(p_m_old-p_m_curr);
@@ -192,23 +152,148 @@ __global__ void updateMap_kernel(iu::ImageGpu_32f_C1::KernelData map, iu::ImageG
     }
 }
 
-__global__ void getGradients_kernel(iu::LinearDeviceMemory_32f_C4::KernelData output, cudaTextureObject_t map, iu::LinearDeviceMemory_32f_C2::KernelData events, float3 pose){
+template <class Camera, class Projection>
+__global__ void getGradients_kernel(CameraGeometry camera, MapGeometry panorama, iu::LinearDeviceMemory_32f_C4::KernelData output, cudaTextureObject_t map, iu::LinearDeviceMemory_32f_C2::KernelData events, float3 pose){
     int event_id = blockIdx.x*blockDim.x + threadIdx.x;
 
     if(event_id<events.numel_) {
         // get last template point
         float3 R[3];
         rodrigues(pose,R);
-        float2 p = ProjectMapSpherical(RotatePointSpherical(ProjectLine(events(event_id)),R));
-        const float xx = p.x+0.5;
-        const float yy = p.y+0.5;
-        output(event_id) = make_float4(tex2D<float>(map,xx+0.5f,yy) - tex2D<float>(map,xx-0.5f,yy),
-                                       tex2D<float>(map,xx,yy+0.5f) - tex2D<float>(map,xx,yy-0.5f),
-                                       tex2D<float>(map,xx,yy),
+        float2 p = ProjectToMap<Camera,Projection>(camera,panorama,events(event_id),R);
+        // neighbours are continued across the seams of the map (azimuth wrap, cube faces)
+        const float2 px = Projection::neighbour(panorama,p,0.5f,0.f)+0.5f;
+        const float2 mx = Projection::neighbour(panorama,p,-0.5f,0.f)+0.5f;
+        const float2 py = Projection::neighbour(panorama,p,0.f,0.5f)+0.5f;
+        const float2 my = Projection::neighbour(panorama,p,0.f,-0.5f)+0.5f;
+        output(event_id) = make_float4(tex2D<float>(map,px.x,px.y) - tex2D<float>(map,mx.x,mx.y),
+                                       tex2D<float>(map,py.x,py.y) - tex2D<float>(map,my.x,my.y),
+                                       tex2D<float>(map,p.x+0.5f,p.y+0.5f),
                                        0.f);
     }
 }
 
+// One block per candidate rotation (xyz of rotations): mean map value at the
+// events seen from it, the same measure as the tracking quality
+template <class Camera, class Projection>
+__global__ void scoreRotations_kernel(CameraGeometry camera, MapGeometry panorama, iu::LinearDeviceMemory_32f_C1::KernelData scores, cudaTextureObject_t map, iu::LinearDeviceMemory_32f_C2::KernelData events, iu::LinearDeviceMemory_32f_C4::KernelData rotations)
+{
+    __shared__ float sum[GPU_BLOCK_SIZE*GPU_BLOCK_SIZE];
+    __shared__ float3 R[3];
+
+    if(threadIdx.x==0) {
+        float4 r = rotations(blockIdx.x);
+        rodrigues(make_float3(r.x,r.y,r.z),R);
+    }
+    __syncthreads();
+
+    float s = 0.f;
+    for(int event_id=threadIdx.x; event_id<events.numel_; event_id+=blockDim.x) {
+        float2 p = ProjectToMap<Camera,Projection>(camera,panorama,events(event_id),R);
+        s += tex2D<float>(map,p.x+0.5f,p.y+0.5f);
+    }
+    sum[threadIdx.x] = s;
+    __syncthreads();
+    for(int n=blockDim.x/2; n>0; n>>=1) {
+        if(threadIdx.x<n)
+            sum[threadIdx.x] += sum[threadIdx.x+n];
+        __syncthreads();
+    }
+    if(threadIdx.x==0)
+        scores(blockIdx.x) = sum[0]/max(events.numel_,1);
+}
+
+// separable max filter, one direction per launch
+__global__ void dilateMap_kernel(iu::ImageGpu_32f_C1::KernelData output, iu::ImageGpu_32f_C1::KernelData map, int2 step, int radius)
+{
+    int x = blockIdx.x*blockDim.x + threadIdx.x;
+    int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if(x<output.width_ && y<output.height_) {
+        float m = 0.f;
+        for(int d=-radius; d<=radius; d++) {
+            int xx = min(max(x+d*step.x,0),map.width_-1);
+            int yy = min(max(y+d*step.y,0),map.height_-1);
+            m = max(m,map(xx,yy));
+        }
+        output(x,y) = m;
+    }
+}
+
+// copies the borders of the adjacent faces into the gutter around every cube face.
+// The values are recomputed from occurences and normalization at interior texels,
+// which this launch never writes, so the result does not depend on thread order.
+__global__ void fillCubeGutters_kernel(MapGeometry panorama, iu::ImageGpu_32f_C1::KernelData map, iu::ImageGpu_32f_C1::KernelData occurences, iu::ImageGpu_32f_C1::KernelData normalization)
+{
+    int x = blockIdx.x*blockDim.x + threadIdx.x;
+    int y = blockIdx.y*blockDim.y + threadIdx.y;
+    const int P = CubeMapProjection::pitch(panorama);
+
+    if(x<3*P && y<2*P && x<map.width_ && y<map.height_)
+    {
+        int cx = x%P;
+        int cy = y%P;
+        if(cx!=0 && cx!=P-1 && cy!=0 && cy!=P-1)
+            return;
+        // ray through the gutter pixel, extended beyond its own face
+        float s,t;
+        int f = CubeMapProjection::faceCoordinates(panorama,make_float2(x,y),0.f,0.f,s,t);
+        int2 idx = InsideImage(CubeMapProjection::project(panorama,CubeMapProjection::faceRay(f,s,t)),map.width_,map.height_);
+        if(idx.x>=0) {
+            // corner rays can hit another gutter, keep the source inside its face
+            int ox = idx.x - idx.x%P;
+            int oy = idx.y - idx.y%P;
+            idx.x = ox + min(max(idx.x-ox,1),P-2);
+            idx.y = oy + min(max(idx.y-oy,1),P-2);
+            map(x,y) = min(1.f,occurences(idx.x,idx.y)/normalization(idx.x,idx.y));
+        }
+    }
+}
+
+template <class Projection>
+__global__ void exportEquirectangular_kernel(MapGeometry panorama, iu::ImageGpu_32f_C1::KernelData output, cudaTextureObject_t map, MapGeometry equirect)
+{
+    int x = blockIdx.x*blockDim.x + threadIdx.x;
+    int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if(x<output.width_ && y<output.height_)
+    {
+        float2 p = Projection::project(panorama,EquirectangularProjection::unproject(equirect,make_float2(x,y)));
+        output(x,y) = tex2D<float>(map,p.x+0.5f,p.y+0.5f);
+    }
+}
+
+template <class Projection>
+__global__ void exportEquirectangular_kernel(MapGeometry panorama, iu::ImageGpu_8u_C4::KernelData output, iu::ImageGpu_8u_C4::KernelData map, MapGeometry equirect)
+{
+    int x = blockIdx.x*blockDim.x + threadIdx.x;
+    int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if(x<output.width_ && y<output.height_)
+    {
+        float2 p = Projection::project(panorama,EquirectangularProjection::unproject(equirect,make_float2(x,y)));
+        int2 idx = InsideImage(p,map.width_,map.height_);
+        output(x,y) = idx.x>=0 ? map(idx.x,idx.y) : make_uchar4(255,255,255,255);
+    }
+}
+
+// keeps the maximum of the panorama and the map seen through rotation
+template <class Projection>
+__global__ void fuseEquirectangular_kernel(MapGeometry panorama, iu::ImageGpu_32f_C1::KernelData output, cudaTextureObject_t map, MapGeometry equirect, float3 rotation)
+{
+    int x = blockIdx.x*blockDim.x + threadIdx.x;
+    int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+    if(x<output.width_ && y<output.height_)
+    {
+        // direction in the frame of the output, rotated into the frame of the map
+        float3 R[3];
+        rodrigues(make_float3(-rotation.x,-rotation.y,-rotation.z),R);
+        float2 p = Projection::project(panorama,RotatePoint(EquirectangularProjection::unproject(equirect,make_float2(x,y)),R));
+        output(x,y) = max(output(x,y),tex2D<float>(map,p.x+0.5f,p.y+0.5f));
+    }
+}
+
 __global__ void createOutput1_kernel(iu::ImageGpu_8u_C4::KernelData output, iu::ImageGpu_32f_C1::KernelData map)
 {
     // map location
@@ -222,7 +307,8 @@ __global__ void createOutput1_kernel(iu::ImageGpu_8u_C4::KernelData output, iu::
     }
 }
 
-__global__ void createOutput2_kernel(iu::ImageGpu_8u_C4::KernelData output, float3 pose, int cam_width, int cam_height, float quality)
+template <class Camera, class Projection>
+__global__ void createOutput2_kernel(CameraGeometry camera, MapGeometry panorama, iu::ImageGpu_8u_C4::KernelData output, float3 pose, int cam_width, int cam_height, float quality)
 {
     // camera pixel
     int x = blockIdx.x*blockDim.x + threadIdx.x;
@@ -232,7 +318,7 @@ __global__ void createOutput2_kernel(iu::ImageGpu_8u_C4::KernelData output, floa
     {
         float3 R[3];
         rodrigues(pose,R);
-        float2 p = ProjectMapSpherical(RotatePointSpherical(ProjectLine(make_float2(x,y)),R));
+        float2 p = ProjectToMap<Camera,Projection>(camera,panorama,make_float2(x,y),R);
 
         int2 idx = InsideImage(p,output.width_,output.height_);
         if(idx.x>=0)
@@ -240,7 +326,8 @@ __global__ void createOutput2_kernel(iu::ImageGpu_8u_C4::KernelData output, floa
     }
 }
 
-__global__ void createOutput3_kernel(iu::ImageGpu_8u_C4::KernelData output, iu::LinearDeviceMemory_32f_C2::KernelData events, float3 pose)
+template <class Camera, class Projection>
+__global__ void createOutput3_kernel(CameraGeometry camera, MapGeometry panorama, iu::ImageGpu_8u_C4::KernelData output, iu::LinearDeviceMemory_32f_C2::KernelData events, float3 pose)
 {
     int event_id = blockIdx.x*blockDim.x + threadIdx.x;;
 
@@ -248,114 +335,291 @@ __global__ void createOutput3_kernel(iu::ImageGpu_8u_C4::KernelData output, iu::
         // get last template point
         float3 R[3];
         rodrigues(pose,R);
-        float2 p = ProjectMapSpherical(RotatePointSpherical(ProjectLine(events(event_id)),R));
+        float2 p = ProjectToMap<Camera,Projection>(camera,panorama,events(event_id),R);
         int2 idx = InsideImage(p,output.width_,output.height_);
         if(idx.x>=0)
             output(idx.x,idx.y) = make_uchar4(0,255,0,255);
     }
 }
 
-namespace cuda{
-
-// -------------Interface functions-------------------------------
-void setCameraMatrices(Eigen::Matrix<float, 3, 3, Eigen::RowMajor>& Kcam, Eigen::Matrix<float, 3, 3, Eigen::RowMajor>& Kcaminv, float p_x, float p_y, float scale)
+template <class Projection>
+inline void fillGutters(Projection, const MapGeometry &, iu::ImageGpu_32f_C1 *, iu::ImageGpu_32f_C1 *, iu::ImageGpu_32f_C1 *)
 {
-    cudaMemcpyToSymbol(const_Kcam, Kcam.data(), 3 * sizeof(float3));
-    CudaCheckError();
-    cudaMemcpyToSymbol(const_Kcaminv, Kcaminv.data(), 3 * sizeof(float3));
-    CudaCheckError();
-    cudaMemcpyToSymbol(const_scale,&scale, sizeof(float));
-    CudaCheckError();
-    float2 pp = make_float2(p_x,p_y);
+}
 
-    cudaMemcpyToSymbol(const_pp, &pp, sizeof(float2));
+inline void fillGutters(CubeMapProjection, const MapGeometry &panorama, iu::ImageGpu_32f_C1 *map, iu::ImageGpu_32f_C1 *occurences, iu::ImageGpu_32f_C1 *normalization)
+{
+    dim3 dimBlock(GPU_BLOCK_SIZE,GPU_BLOCK_SIZE);
+    dim3 dimGrid(iu::divUp(map->width(),GPU_BLOCK_SIZE),iu::divUp(map->height(),GPU_BLOCK_SIZE));
+    fillCubeGutters_kernel<<<dimGrid,dimBlock>>>(panorama,*map,*occurences,*normalization);
     CudaCheckError();
-
 }
 
-void updateMap(iu::ImageGpu_32f_C1 *map, iu::ImageGpu_32f_C1 *occurences, iu::ImageGpu_32f_C1 *normalization, iu::LinearDeviceMemory_32f_C2 *events, float3 pose, float3 old_pose, int cam_width, int cam_height)
+// Launchers instantiate the kernels for one camera model / projection pair.
+// The geometry is a kernel argument, so every tracker can use its own.
+struct UpdateMapLauncher
 {
-    // GPU_BLOCK_SIZE = 16
+    TrackingGeometry geometry;
+    iu::ImageGpu_32f_C1 *map;
+    iu::ImageGpu_32f_C1 *occurences;
+    iu::ImageGpu_32f_C1 *normalization;
+    iu::LinearDeviceMemory_32f_C2 *events;
+    float3 pose;
+    float3 old_pose;
+    int cam_width;
+    int cam_height;
+
+    template <class Camera, class Projection>
+    void operator()(Camera, Projection)
+    {
+        // GPU_BLOCK_SIZE = 16
 
-    int gpu_block_x = GPU_BLOCK_SIZE*GPU_BLOCK_SIZE; //256
-    int gpu_block_y = 1;
+        int gpu_block_x = GPU_BLOCK_SIZE*GPU_BLOCK_SIZE; //256
+        int gpu_block_y = 1;
 
-    // compute number of Blocks
-    int nb_x = iu::divUp(events->numel(),gpu_block_x);
-    int nb_y = 1;
+        // compute number of Blocks
+        int nb_x = iu::divUp(events->numel(),gpu_block_x);
+        int nb_y = 1;
 
-    dim3 dimBlock(gpu_block_x,gpu_block_y); // each block has 256 threads
-    dim3 dimGrid(nb_x,nb_y); // total threads number = events.size()
+        dim3 dimBlock(gpu_block_x,gpu_block_y); // each block has 256 threads
+        dim3 dimGrid(nb_x,nb_y); // total threads number = events.size()
 
-    updateOccurences_kernel<<<dimGrid,dimBlock>>>(*occurences,*events,pose);
-    CudaCheckError();
+        updateOccurences_kernel<Camera,Projection><<<dimGrid,dimBlock>>>(geometry.camera,geometry.map,*occurences,*events,pose);
+        CudaCheckError();
 
-    gpu_block_x = GPU_BLOCK_SIZE;
-    gpu_block_y = GPU_BLOCK_SIZE;
+        gpu_block_x = GPU_BLOCK_SIZE;
+        gpu_block_y = GPU_BLOCK_SIZE;
 
-    // compute number of Blocks
-    nb_x = iu::divUp(cam_width,gpu_block_x);
-    nb_y = iu::divUp(cam_height,gpu_block_y);
+        // compute number of Blocks
+        nb_x = iu::divUp(cam_width,gpu_block_x);
+        nb_y = iu::divUp(cam_height,gpu_block_y);
 
-    dimBlock = dim3(gpu_block_x,gpu_block_y); // each block has 256 threads
-    dimGrid = dim3(nb_x,nb_y); // total threads number = camera pixel number
+        dimBlock = dim3(gpu_block_x,gpu_block_y); // each block has 256 threads
+        dimGrid = dim3(nb_x,nb_y); // total threads number = camera pixel number
 
-    updateNormalization_kernel<<<dimGrid,dimBlock>>>(*normalization,pose,old_pose,cam_width,cam_height);
-    CudaCheckError();
+        updateNormalization_kernel<Camera,Projection><<<dimGrid,dimBlock>>>(geometry.camera,geometry.map,*normalization,pose,old_pose,cam_width,cam_height);
+        CudaCheckError();
 
-    nb_x = iu::divUp(map->width(),gpu_block_x);
-    nb_y = iu::divUp(map->height(),gpu_block_y);
+        nb_x = iu::divUp(map->width(),gpu_block_x);
+        nb_y = iu::divUp(map->height(),gpu_block_y);
 
-    dimBlock = dim3(gpu_block_x,gpu_block_y); // each block has 256 threads
-    dimGrid = dim3(nb_x,nb_y); // total threads number = map pixel number
+        dimBlock = dim3(gpu_block_x,gpu_block_y); // each block has 256 threads
+        dimGrid = dim3(nb_x,nb_y); // total threads number = map pixel number
 
-    updateMap_kernel<<<dimGrid,dimBlock>>>(*map,*occurences,*normalization);
-    CudaCheckError();
-}
+        updateMap_kernel<<<dimGrid,dimBlock>>>(*map,*occurences,*normalization);
+        CudaCheckError();
 
-void getGradients(iu::LinearDeviceMemory_32f_C4 *output, iu::ImageGpu_32f_C1* map, iu::LinearDeviceMemory_32f_C2 *events, float3 pose) {
-    int gpu_block_x = GPU_BLOCK_SIZE*GPU_BLOCK_SIZE;
-    int gpu_block_y = 1;
+        fillGutters(Projection(),geometry.map,map,occurences,normalization);
+    }
+};
 
-    // compute number of Blocks
-    int nb_x = iu::divUp(events->numel(),gpu_block_x);
-    int nb_y = 1;
+struct GetGradientsLauncher
+{
+    TrackingGeometry geometry;
+    iu::LinearDeviceMemory_32f_C4 *output;
+    iu::ImageGpu_32f_C1 *map;
+    iu::LinearDeviceMemory_32f_C2 *events;
+    float3 pose;
+
+    template <class Camera, class Projection>
+    void operator()(Camera, Projection)
+    {
+        int gpu_block_x = GPU_BLOCK_SIZE*GPU_BLOCK_SIZE;
+        int gpu_block_y = 1;
 
-    dim3 dimBlock(gpu_block_x,gpu_block_y);
-    dim3 dimGrid(nb_x,nb_y);
+        // compute number of Blocks
+        int nb_x = iu::divUp(events->numel(),gpu_block_x);
+        int nb_y = 1;
 
-    getGradients_kernel<<<dimGrid,dimBlock>>>(*output,map->getTexture(),*events,pose);
-    CudaCheckError();
-}
+        dim3 dimBlock(gpu_block_x,gpu_block_y);
+        dim3 dimGrid(nb_x,nb_y);
 
-void createOutput(iu::ImageGpu_8u_C4 *out, iu::ImageGpu_32f_C1 *map, iu::LinearDeviceMemory_32f_C2 *events, float3 pose, int cam_width, int cam_height, float quality){
-    int nb_x = iu::divUp(out->width(),GPU_BLOCK_SIZE);
-    int nb_y = iu::divUp(out->height(),GPU_BLOCK_SIZE);
+        getGradients_kernel<Camera,Projection><<<dimGrid,dimBlock>>>(geometry.camera,geometry.map,*output,map->getTexture(),*events,pose);
+        CudaCheckError();
+    }
+};
 
-    dim3 dimBlock(GPU_BLOCK_SIZE,GPU_BLOCK_SIZE); // 256
-    dim3 dimGrid(nb_x,nb_y);
+struct ScoreRotationsLauncher
+{
+    TrackingGeometry geometry;
+    iu::LinearDeviceMemory_32f_C1 *scores;
+    iu::ImageGpu_32f_C1 *map;
+    iu::LinearDeviceMemory_32f_C2 *events;
+    iu::LinearDeviceMemory_32f_C4 *rotations;
+
+    template <class Camera, class Projection>
+    void operator()(Camera, Projection)
+    {
+        dim3 dimBlock(GPU_BLOCK_SIZE*GPU_BLOCK_SIZE,1); // events of one candidate
+        dim3 dimGrid(rotations->numel(),1);             // one block per candidate
 
-    // generate map
-    createOutput1_kernel<<<dimGrid,dimBlock>>>(*out,*map); // total threads = map pixel number
+        scoreRotations_kernel<Camera,Projection><<<dimGrid,dimBlock>>>(geometry.camera,geometry.map,*scores,map->getTexture(),*events,*rotations);
+        CudaCheckError();
+    }
+};
 
-    nb_x = iu::divUp(cam_width,GPU_BLOCK_SIZE);
-    nb_y = iu::divUp(cam_height,GPU_BLOCK_SIZE);
+struct CreateOutputLauncher
+{
+    TrackingGeometry geometry;
+    iu::ImageGpu_8u_C4 *out;
+    iu::ImageGpu_32f_C1 *map;
+    iu::LinearDeviceMemory_32f_C2 *events;
+    float3 pose;
+    int cam_width;
+    int cam_height;
+    float quality;
+
+    template <class Camera, class Projection>
+    void operator()(Camera, Projection)
+    {
+        int nb_x = iu::divUp(out->width(),GPU_BLOCK_SIZE);
+        int nb_y = iu::divUp(out->height(),GPU_BLOCK_SIZE);
+
+        dim3 dimBlock(GPU_BLOCK_SIZE,GPU_BLOCK_SIZE); // 256
+        dim3 dimGrid(nb_x,nb_y);
+
+        // generate map
+        createOutput1_kernel<<<dimGrid,dimBlock>>>(*out,*map); // total threads = map pixel number
+
+        nb_x = iu::divUp(cam_width,GPU_BLOCK_SIZE);
+        nb_y = iu::divUp(cam_height,GPU_BLOCK_SIZE);
+
+        dimBlock = dim3(GPU_BLOCK_SIZE,GPU_BLOCK_SIZE); //256
+        dimGrid = dim3(nb_x,nb_y);
+        if(quality>0)
+            // generate camera pose display
+            createOutput2_kernel<Camera,Projection><<<dimGrid,dimBlock>>>(geometry.camera,geometry.map,*out,pose,cam_width,cam_height,min(quality,1.f)); // total threads = camera pixel number
+
+        // generate events display
+        if(events) {
+             nb_x = iu::divUp(events->numel(),GPU_BLOCK_SIZE);
+             nb_y = 1;
+             dimBlock = dim3(GPU_BLOCK_SIZE*GPU_BLOCK_SIZE,1);
+             dimGrid = dim3(nb_x,nb_y);
+             createOutput3_kernel<Camera,Projection><<<dimGrid,dimBlock>>>(geometry.camera,geometry.map,*out,*events,pose);
+        }
+        CudaCheckError();
+    }
+};
 
-    dimBlock = dim3(GPU_BLOCK_SIZE,GPU_BLOCK_SIZE); //256
-    dimGrid = dim3(nb_x,nb_y);
-    if(quality>0)
-        // generate camera pose display
-        createOutput2_kernel<<<dimGrid,dimBlock>>>(*out,pose,cam_width,cam_height,min(quality,1.f)); // total threads = camera pixel number
+template <class Image>
+struct ExportEquirectangularLauncher
+{
+    TrackingGeometry geometry;
+    Image *out;
+    Image *map;
+
+    // full sphere at scale 1
+    MapGeometry equirect() const
+    {
+        MapGeometry sphere;
+        sphere.pp = make_float2(out->width()/2.f,out->height()/2.f);
+        sphere.scale = 1.f;
+        sphere.width = out->width();
+        sphere.height = out->height();
+        sphere.face_size = 0;
+        return sphere;
+    }
 
-    // generate events display
-    if(events) {
-         nb_x = iu::divUp(events->numel(),GPU_BLOCK_SIZE);
-         nb_y = 1;
-         dimBlock = dim3(GPU_BLOCK_SIZE*GPU_BLOCK_SIZE,1);
-         dimGrid = dim3(nb_x,nb_y);
-         createOutput3_kernel<<<dimGrid,dimBlock>>>(*out,*events,pose);
+    template <class Projection>
+    void launch(Projection, iu::ImageGpu_32f_C1 *)
+    {
+        map->prepareTexture(cudaReadModeElementType,cudaFilterModeLinear,cudaAddressModeClamp);
+        exportEquirectangular_kernel<Projection><<<grid(),block()>>>(geometry.map,*out,map->getTexture(),equirect());
+    }
+
+    template <class Projection>
+    void launch(Projection, iu::ImageGpu_8u_C4 *)
+    {
+        exportEquirectangular_kernel<Projection><<<grid(),block()>>>(geometry.map,*out,*map,equirect());
     }
+
+    dim3 block() const { return dim3(GPU_BLOCK_SIZE,GPU_BLOCK_SIZE); }
+    dim3 grid() const { return dim3(iu::divUp(out->width(),GPU_BLOCK_SIZE),iu::divUp(out->height(),GPU_BLOCK_SIZE)); }
+
+    template <class Projection>
+    void operator()(Projection projection)
+    {
+        launch(projection,map);
+        CudaCheckError();
+    }
+};
+
+struct FuseEquirectangularLauncher
+{
+    TrackingGeometry geometry;
+    iu::ImageGpu_32f_C1 *out;
+    iu::ImageGpu_32f_C1 *map;
+    float3 rotation;
+
+    template <class Projection>
+    void operator()(Projection)
+    {
+        MapGeometry equirect;
+        equirect.pp = make_float2(out->width()/2.f,out->height()/2.f);
+        equirect.scale = 1.f;
+        equirect.width = out->width();
+        equirect.height = out->height();
+        equirect.face_size = 0;
+
+        dim3 dimBlock(GPU_BLOCK_SIZE,GPU_BLOCK_SIZE);
+        dim3 dimGrid(iu::divUp(out->width(),GPU_BLOCK_SIZE),iu::divUp(out->height(),GPU_BLOCK_SIZE));
+        map->prepareTexture(cudaReadModeElementType,cudaFilterModeLinear,cudaAddressModeClamp);
+        fuseEquirectangular_kernel<Projection><<<dimGrid,dimBlock>>>(geometry.map,*out,map->getTexture(),equirect,rotation);
+        CudaCheckError();
+    }
+};
+
+namespace cuda{
+
+// -------------Interface functions-------------------------------
+void updateMap(const TrackingGeometry &geometry, iu::ImageGpu_32f_C1 *map, iu::ImageGpu_32f_C1 *occurences, iu::ImageGpu_32f_C1 *normalization, iu::LinearDeviceMemory_32f_C2 *events, float3 pose, float3 old_pose, int cam_width, int cam_height)
+{
+    UpdateMapLauncher launcher = {geometry, map, occurences, normalization, events, pose, old_pose, cam_width, cam_height};
+    dispatchModels(geometry.camera_model, geometry.map_projection, launcher);
+}
+
+void getGradients(const TrackingGeometry &geometry, iu::LinearDeviceMemory_32f_C4 *output, iu::ImageGpu_32f_C1* map, iu::LinearDeviceMemory_32f_C2 *events, float3 pose) {
+    GetGradientsLauncher launcher = {geometry, output, map, events, pose};
+    dispatchModels(geometry.camera_model, geometry.map_projection, launcher);
+}
+
+void scoreRotations(const TrackingGeometry &geometry, iu::LinearDeviceMemory_32f_C1 *scores, iu::ImageGpu_32f_C1 *map, iu::LinearDeviceMemory_32f_C2 *events, iu::LinearDeviceMemory_32f_C4 *rotations)
+{
+    ScoreRotationsLauncher launcher = {geometry, scores, map, events, rotations};
+    dispatchModels(geometry.camera_model, geometry.map_projection, launcher);
+}
+
+void dilateMap(iu::ImageGpu_32f_C1 *out, iu::ImageGpu_32f_C1 *map, iu::ImageGpu_32f_C1 *tmp, int radius)
+{
+    dim3 dimBlock(GPU_BLOCK_SIZE,GPU_BLOCK_SIZE);
+    dim3 dimGrid(iu::divUp(map->width(),GPU_BLOCK_SIZE),iu::divUp(map->height(),GPU_BLOCK_SIZE));
+    dilateMap_kernel<<<dimGrid,dimBlock>>>(*tmp,*map,make_int2(1,0),radius);
+    dilateMap_kernel<<<dimGrid,dimBlock>>>(*out,*tmp,make_int2(0,1),radius);
     CudaCheckError();
 }
 
+void createOutput(const TrackingGeometry &geometry, iu::ImageGpu_8u_C4 *out, iu::ImageGpu_32f_C1 *map, iu::LinearDeviceMemory_32f_C2 *events, float3 pose, int cam_width, int cam_height, float quality){
+    CreateOutputLauncher launcher = {geometry, out, map, events, pose, cam_width, cam_height, quality};
+    dispatchModels(geometry.camera_model, geometry.map_projection, launcher);
+}
+
+void exportEquirectangular(const TrackingGeometry &geometry, iu::ImageGpu_32f_C1 *out, iu::ImageGpu_32f_C1 *map)
+{
+    ExportEquirectangularLauncher<iu::ImageGpu_32f_C1> launcher = {geometry, out, map};
+    dispatchProjection(geometry.map_projection, launcher);
+}
+
+void exportEquirectangular(const TrackingGeometry &geometry, iu::ImageGpu_8u_C4 *out, iu::ImageGpu_8u_C4 *map)
+{
+    ExportEquirectangularLauncher<iu::ImageGpu_8u_C4> launcher = {geometry, out, map};
+    dispatchProjection(geometry.map_projection, launcher);
+}
+
+void fuseEquirectangular(const TrackingGeometry &geometry, iu::ImageGpu_32f_C1 *out, iu::ImageGpu_32f_C1 *map, float3 rotation)
+{
+    FuseEquirectangularLauncher launcher = {geometry, out, map, rotation};
+    dispatchProjection(geometry.map_projection, launcher);
+}
+
 }
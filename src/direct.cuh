@@ -21,12 +21,22 @@
 #include <Eigen/Dense>
 
 #include "common.h"
+#include "models.cuh"
 
 namespace  cuda {
-    void setCameraMatrices(Matrix3fr &Kcam, Matrix3fr &Kcaminv, float p_x, float p_y, float scale);
-    void updateMap(iu::ImageGpu_32f_C1 *map, iu::ImageGpu_32f_C1 *occurences, iu::ImageGpu_32f_C1 *normalization, iu::LinearDeviceMemory_32f_C2 *events, float3 pose, float3 old_pose, int cam_width, int cam_height);
-    void getGradients(iu::LinearDeviceMemory_32f_C4 *output, iu::ImageGpu_32f_C1* map, iu::LinearDeviceMemory_32f_C2 *events, float3 pose);
-    void createOutput(iu::ImageGpu_8u_C4 *out, iu::ImageGpu_32f_C1 *map, iu::LinearDeviceMemory_32f_C2 *events, float3 pose, int cam_width, int cam_height, float quality);
+    // All functions take the camera and map parameters of the calling tracker
+    void updateMap(const TrackingGeometry &geometry, iu::ImageGpu_32f_C1 *map, iu::ImageGpu_32f_C1 *occurences, iu::ImageGpu_32f_C1 *normalization, iu::LinearDeviceMemory_32f_C2 *events, float3 pose, float3 old_pose, int cam_width, int cam_height);
+    void getGradients(const TrackingGeometry &geometry, iu::LinearDeviceMemory_32f_C4 *output, iu::ImageGpu_32f_C1* map, iu::LinearDeviceMemory_32f_C2 *events, float3 pose);
+    // scores(i) = mean map value at the events rotated by the rotation vector xyz of rotations(i)
+    void scoreRotations(const TrackingGeometry &geometry, iu::LinearDeviceMemory_32f_C1 *scores, iu::ImageGpu_32f_C1 *map, iu::LinearDeviceMemory_32f_C2 *events, iu::LinearDeviceMemory_32f_C4 *rotations);
+    // max filter over (2*radius+1)^2 pixels, tmp has the size of map
+    void dilateMap(iu::ImageGpu_32f_C1 *out, iu::ImageGpu_32f_C1 *map, iu::ImageGpu_32f_C1 *tmp, int radius);
+    void createOutput(const TrackingGeometry &geometry, iu::ImageGpu_8u_C4 *out, iu::ImageGpu_32f_C1 *map, iu::LinearDeviceMemory_32f_C2 *events, float3 pose, int cam_width, int cam_height, float quality);
+    // reprojects the map (in its current projection) to a full equirectangular panorama of the size of out
+    void exportEquirectangular(const TrackingGeometry &geometry, iu::ImageGpu_32f_C1 *out, iu::ImageGpu_32f_C1 *map);
+    void exportEquirectangular(const TrackingGeometry &geometry, iu::ImageGpu_8u_C4 *out, iu::ImageGpu_8u_C4 *map);
+    // out = max(out, map) with the map rotated into the frame of the equirectangular out (rotation vector)
+    void fuseEquirectangular(const TrackingGeometry &geometry, iu::ImageGpu_32f_C1 *out, iu::ImageGpu_32f_C1 *map, float3 rotation);
 }
 
 #endif //DIRECT_CUH
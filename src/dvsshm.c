@@ -0,0 +1,152 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "dvsshm.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct dvs_shm_reader
+{
+    const uint8_t *base;
+    size_t size;
+};
+
+dvs_shm_reader *dvs_shm_open(const char *name)
+{
+    int fd = shm_open(name ? name : DVS_SHM_DEFAULT_NAME, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct dvs_shm_header))
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    const struct dvs_shm_header *header = (const struct dvs_shm_header *)base;
+    if (header->magic != DVS_SHM_MAGIC || header->version != DVS_SHM_VERSION || header->size > (uint64_t)st.st_size)
+    {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+    dvs_shm_reader *reader = (dvs_shm_reader *)malloc(sizeof(dvs_shm_reader));
+    reader->base = (const uint8_t *)base;
+    reader->size = st.st_size;
+    return reader;
+}
+
+void dvs_shm_close(dvs_shm_reader *reader)
+{
+    if (!reader)
+        return;
+    munmap((void *)reader->base, reader->size);
+    free(reader);
+}
+
+const struct dvs_shm_header *dvs_shm_get_header(const dvs_shm_reader *reader)
+{
+    return (const struct dvs_shm_header *)reader->base;
+}
+
+uint64_t dvs_shm_poses_written(const dvs_shm_reader *reader)
+{
+    return __atomic_load_n(&dvs_shm_get_header(reader)->poses_written, __ATOMIC_ACQUIRE);
+}
+
+int dvs_shm_writer_closed(const dvs_shm_reader *reader)
+{
+    return __atomic_load_n(&dvs_shm_get_header(reader)->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+/* Seqlock read of publication sequence from a slot: 1 read, 0 not yet
+ * published (or a writer died while writing it), -1 overwritten. extra_size
+ * bytes at extra are copied into data with the slot. */
+static int readSlot(const uint8_t *slot, size_t size, uint64_t sequence, void *out, const uint8_t *extra, size_t extra_size, uint8_t *data)
+{
+    const uint64_t *seq = (const uint64_t *)slot;
+    const uint64_t complete = 2 * sequence + 2;
+    for (int attempt = 0; attempt < (1 << 20); attempt++)
+    {
+        uint64_t before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (before < complete - 1)
+            return 0;
+        if (before > complete)
+            return -1;
+        if (before == complete)
+        {
+            memcpy(out, slot, size);
+            if (data)
+                memcpy(data, extra, extra_size);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            uint64_t after = __atomic_load_n(seq, __ATOMIC_RELAXED);
+            if (after == before)
+                return 1;
+            if (after > complete)
+                return -1;
+        }
+        /* being written */
+    }
+    return 0;
+}
+
+int dvs_shm_read_pose(dvs_shm_reader *reader, uint64_t sequence, struct dvs_shm_pose *pose)
+{
+    const struct dvs_shm_header *header = dvs_shm_get_header(reader);
+    if (header->pose_capacity == 0)
+        return 0;
+    const uint8_t *slot = reader->base + header->pose_offset + (sequence % header->pose_capacity) * sizeof(struct dvs_shm_pose);
+    return readSlot(slot, sizeof(struct dvs_shm_pose), sequence, pose, NULL, 0, NULL);
+}
+
+int dvs_shm_latest_pose(dvs_shm_reader *reader, struct dvs_shm_pose *pose)
+{
+    for (;;)
+    {
+        uint64_t written = dvs_shm_poses_written(reader);
+        if (written == 0)
+            return 0;
+        int result = dvs_shm_read_pose(reader, written - 1, pose);
+        if (result >= 0)
+            return result;
+        /* lapped while reading, take the newer one */
+    }
+}
+
+int dvs_shm_latest_map(dvs_shm_reader *reader, struct dvs_shm_map *map, uint8_t *pixels)
+{
+    const struct dvs_shm_header *header = dvs_shm_get_header(reader);
+    if (header->map_slots == 0)
+        return 0;
+    size_t bytes = (size_t)header->map_width * header->map_height;
+    for (;;)
+    {
+        uint64_t written = __atomic_load_n(&header->maps_written, __ATOMIC_ACQUIRE);
+        if (written == 0)
+            return 0;
+        uint64_t sequence = written - 1;
+        const uint8_t *slot = reader->base + header->map_offset + (sequence % header->map_slots) * header->map_slot_size;
+        int result = readSlot(slot, sizeof(struct dvs_shm_map), sequence, map, slot + sizeof(struct dvs_shm_map), bytes, pixels);
+        if (result >= 0)
+            return result;
+    }
+}
@@ -0,0 +1,116 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef DVSSHM_H
+#define DVSSHM_H
+
+/* Poses and map snapshots of the tracker in POSIX shared memory, for
+ * consumers on the same host. Plain C, no dependencies besides librt.
+ *
+ * Layout of the object: struct dvs_shm_header, a ring of pose_capacity
+ * struct dvs_shm_pose at pose_offset and map_slots slots of map_slot_size
+ * bytes at map_offset (a struct dvs_shm_map followed by width * height
+ * pixels, 8 bit, map value * 255, equirectangular).
+ *
+ * Every slot is a seqlock: while publication n is written its seq is 2n+1,
+ * afterwards 2n+2. A reader copies the slot and accepts the copy if seq was
+ * 2n+2 before and after. The writer never waits for readers. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DVS_SHM_MAGIC 0x4d485344u /* "DSHM" */
+#define DVS_SHM_VERSION 1
+#define DVS_SHM_DEFAULT_NAME "/dvs-tracking"
+
+/* flags of a pose */
+#define DVS_SHM_POSE_LOST 1u        /* tracking lost, map updates paused */
+#define DVS_SHM_POSE_RELOCALIZED 2u /* reinitialized by the rotation search */
+
+struct dvs_shm_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pose_capacity;
+    uint32_t map_slots;     /* 0: no maps */
+    uint32_t map_width;
+    uint32_t map_height;
+    uint64_t pose_offset;   /* bytes from the start of the object */
+    uint64_t map_offset;
+    uint64_t map_slot_size;
+    uint64_t size;          /* of the whole object */
+    int32_t writer_pid;
+    uint32_t closed;        /* set when the writer stops */
+    uint64_t poses_written; /* written atomically after each pose */
+    uint64_t maps_written;
+};
+
+struct dvs_shm_pose
+{
+    uint64_t seq;
+    uint64_t sequence;     /* 0, 1, 2, ... per pose */
+    double t;              /* sensor time, seconds */
+    double published;      /* CLOCK_MONOTONIC of the writer, seconds */
+    float rotation[3];     /* rotation vector of the tracker */
+    float quaternion[4];   /* x y z w, as in estimated_pose_rpg.txt */
+    float quality;
+    uint32_t flags;
+    uint8_t padding[60];   /* one slot per two cache lines */
+};
+
+struct dvs_shm_map
+{
+    uint64_t seq;
+    uint64_t sequence;
+    double t;
+    double published;
+    float rotation[3];     /* pose at the time of the snapshot */
+    uint32_t width;
+    uint32_t height;
+    uint8_t padding[12];   /* pixels start at 64 bytes */
+};
+
+/* Reader */
+typedef struct dvs_shm_reader dvs_shm_reader;
+
+/* NULL if the object does not exist or has another version */
+dvs_shm_reader *dvs_shm_open(const char *name);
+void dvs_shm_close(dvs_shm_reader *reader);
+const struct dvs_shm_header *dvs_shm_get_header(const dvs_shm_reader *reader);
+/* poses published so far; the writer stopped if closed is set */
+uint64_t dvs_shm_poses_written(const dvs_shm_reader *reader);
+int dvs_shm_writer_closed(const dvs_shm_reader *reader);
+
+/* Newest pose. Returns 1, or 0 if none was published yet. */
+int dvs_shm_latest_pose(dvs_shm_reader *reader, struct dvs_shm_pose *pose);
+/* Pose number sequence: 1 if read, 0 if not published yet, -1 if already
+ * overwritten by the ring */
+int dvs_shm_read_pose(dvs_shm_reader *reader, uint64_t sequence, struct dvs_shm_pose *pose);
+/* Newest map, pixels must hold map_width * map_height bytes. Returns 1, or 0
+ * without maps. */
+int dvs_shm_latest_map(dvs_shm_reader *reader, struct dvs_shm_map *map, uint8_t *pixels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DVSSHM_H */
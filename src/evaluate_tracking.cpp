@@ -0,0 +1,378 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// system includes
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <cuda_runtime.h>
+
+#include "event.h"
+#include "common.h"
+#include "parameters.h"
+#include "scopedtimer.h"
+#include "tracker.h"
+#include "trackerpool.h"
+#include "eventsimulator.h"
+#include "eventsource.h"
+#include "evaluation.h"
+#include "benchmark.h"
+
+struct Recording
+{
+    std::string name;
+    std::vector<Event> events; // decoded once, tracked in place by every configuration
+    SampledTrajectory groundtruth;
+};
+
+struct Configuration
+{
+    size_t recording;
+    int packet;
+    int iterations;
+    float upscale;
+    float acceleration;
+    int panorama_width;
+};
+
+// One configuration in flight: its own tracker (map, pose) and the results,
+// written by the pool thread tracking it
+struct SweepRun
+{
+    std::unique_ptr<Tracker> tracker;
+    int stream;
+    long packets; // full packets of the recording
+    long tracked;
+    double total; // seconds spent in track
+    SampledTrajectory estimate;
+    BenchmarkResult *result;
+};
+
+static void usage(const char *name)
+{
+    std::cout << "usage: " << name << " --estimate <poses.txt> --groundtruth <poses.txt> [--rpe-delta <s>] [--no-align]" << std::endl
+              << "       " << name << " <calibration file> [options]" << std::endl
+              << "  --recording <events.txt> <groundtruth.txt>  may be repeated (default: one synthetic sequence)" << std::endl
+              << "  --packets <n,n,..>      events per packet (default 500,1500,5000)" << std::endl
+              << "  --iterations <n,n,..>   optimizer iterations (default 1,5,10)" << std::endl
+              << "  --upscale <s,s,..>      map upscale (default 1)" << std::endl
+              << "  --acceleration <a,a,..> optimizer acceleration (default 0.4)" << std::endl
+              << "  --panorama-width <w,..> panorama width, the height is half (default from the calibration)" << std::endl
+              << "  --jobs <n>              configurations tracked in parallel (default: one per core)" << std::endl
+              << "  --rpe-delta <s>         time between poses of the relative error (default 0.5)" << std::endl
+              << "  --no-align              do not remove a constant rotation before the ATE" << std::endl
+              << "  --output <file.json>    write the results as JSON" << std::endl
+              << "  --table <file.csv>      write the results as one CSV table" << std::endl;
+}
+
+static std::vector<double> parseList(const char *arg)
+{
+    std::vector<double> values;
+    std::stringstream str(arg);
+    std::string value;
+    while (std::getline(str, value, ','))
+        values.push_back(atof(value.c_str()));
+    return values;
+}
+
+static void printError(const TrajectoryError &e)
+{
+    std::cout << std::fixed << std::setprecision(4)
+              << "poses " << e.poses << std::endl
+              << "ATE rmse " << e.ate_rmse << " deg, mean " << e.ate_mean << " deg, max " << e.ate_max << " deg" << std::endl
+              << "RPE rmse " << e.rpe_rmse << " deg (" << e.rpe_pairs << " pairs)" << std::endl;
+}
+
+// Configurations whose last packet has been tracked
+struct SweepQueue
+{
+    std::mutex mutex;
+    std::condition_variable finished_cv;
+    std::deque<size_t> finished;
+
+    void finish(size_t index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(index);
+        }
+        finished_cv.notify_one();
+    }
+};
+
+static void startRun(SweepRun &run, size_t index, SweepQueue &queue, TrackerPool &pool, Parameters parameters, const Recording &recording, const Configuration &c)
+{
+    parameters.output_size_x = c.panorama_width;
+    parameters.output_size_y = c.panorama_width / 2;
+    parameters.px = parameters.output_size_x / 2.f;
+    parameters.py = parameters.output_size_y / 2.f;
+    run.tracker.reset(new Tracker(parameters, 0, c.upscale));
+    run.tracker->setEventsPerImage(c.packet);
+    run.tracker->setIterations(c.iterations);
+    run.tracker->setAcceleration(c.acceleration);
+    run.packets = recording.events.size() / c.packet;
+    run.tracked = 0;
+    run.total = 0;
+    SweepRun *r = &run;
+    run.stream = pool.addStream(run.tracker.get(), [r, index, &queue](int, const TrackingResult &result) {
+        // includes the map fusion still running on this thread's stream
+        CudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
+        double elapsed = ScopedTimer::getCurrentTime() * 1e-6 - result.started;
+        r->result->samples.push_back(elapsed * 1e6);
+        r->total += elapsed;
+        r->estimate.add(result.t, poseToQuaternion(result.pose));
+        if (++r->tracked == r->packets)
+            queue.finish(index);
+    });
+    if (run.packets == 0)
+        queue.finish(index);
+    else
+        pool.addEventsInPlace(run.stream, recording.events.data(), run.packets * c.packet);
+}
+
+static void finishRun(SweepRun &run, TrackerPool &pool, const Recording &recording, const Configuration &c, double rpe_delta, bool align)
+{
+    pool.removeStream(run.stream);
+    run.tracker.reset(); // frees the map and buffers before the next configuration starts
+    TrajectoryError error = evaluateTrajectory(run.estimate, recording.groundtruth, rpe_delta, align);
+    BenchmarkResult &result = *run.result;
+    result.metrics.push_back(std::make_pair("ate_rmse_deg", error.ate_rmse));
+    result.metrics.push_back(std::make_pair("ate_max_deg", error.ate_max));
+    result.metrics.push_back(std::make_pair("rpe_rmse_deg", error.rpe_rmse));
+    result.metrics.push_back(std::make_pair("events_per_second", run.total > 0 ? run.tracked * c.packet / run.total : 0));
+}
+
+// Tracks every configuration on its recording, jobs of them at a time. Each
+// configuration has its own tracker; the recordings are shared read-only.
+// Timings are per packet under the load of the other configurations.
+static void sweep(BenchmarkReport &report, const Parameters &parameters, const std::vector<Recording> &recordings,
+                  const std::vector<Configuration> &configurations, int jobs, double rpe_delta, bool align)
+{
+    std::vector<SweepRun> runs(configurations.size());
+    for (size_t i = 0; i < configurations.size(); i++)
+    {
+        const Configuration &c = configurations[i];
+        BenchmarkResult &result = report.add("evaluate", c.packet);
+        result.parameters.push_back(std::make_pair("recording", (double)c.recording));
+        result.parameters.push_back(std::make_pair("events", (double)c.packet));
+        result.parameters.push_back(std::make_pair("iterations", (double)c.iterations));
+        result.parameters.push_back(std::make_pair("upscale", (double)c.upscale));
+        result.parameters.push_back(std::make_pair("acceleration", (double)c.acceleration));
+        result.parameters.push_back(std::make_pair("panorama_width", (double)c.panorama_width));
+        runs[i].result = &result;
+    }
+
+    TrackerPool pool(jobs);
+    SweepQueue queue;
+    size_t next = 0, active = 0, done = 0;
+    // device memory in use by the sweep, checked after every configuration
+    size_t free_start, free_now, total;
+    CudaSafeCall(cudaMemGetInfo(&free_start, &total));
+    size_t peak = 0;
+    while (done < configurations.size())
+    {
+        // one tracker per thread in flight, bounds the GPU memory of the maps
+        for (; active < (size_t)pool.threads() && next < configurations.size(); next++, active++)
+            startRun(runs[next], next, queue, pool, parameters, recordings[configurations[next].recording], configurations[next]);
+
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.finished_cv.wait(lock, [&]() { return !queue.finished.empty(); });
+            index = queue.finished.front();
+            queue.finished.pop_front();
+        }
+        const Configuration &c = configurations[index];
+        CudaSafeCall(cudaMemGetInfo(&free_now, &total));
+        peak = std::max(peak, free_start > free_now ? free_start - free_now : 0);
+        finishRun(runs[index], pool, recordings[c.recording], c, rpe_delta, align);
+        active--;
+        done++;
+        std::cout << "\r" << done << "/" << configurations.size() << " configurations" << std::flush;
+    }
+    std::cout << std::endl;
+    CudaSafeCall(cudaMemGetInfo(&free_now, &total));
+    std::cout << "peak device memory of the sweep: " << peak / (1 << 20) << " MiB" << std::endl;
+    if (free_now + (16 << 20) < free_start)
+        std::cerr << (free_start - free_now) / (1 << 20) << " MiB of device memory still in use after the sweep" << std::endl;
+}
+
+// A configuration is on the Pareto front of its recording if no other one is
+// at least as accurate and as fast, and better in one of both
+static void markParetoFront(BenchmarkReport &report)
+{
+    std::deque<BenchmarkResult> &results = report.results();
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        bool dominated = false;
+        for (size_t j = 0; j < results.size() && !dominated; j++)
+        {
+            if (i == j || results[i].parameters[0].second != results[j].parameters[0].second)
+                continue;
+            double ate_i = results[i].metrics[0].second, ate_j = results[j].metrics[0].second;
+            double rate_i = results[i].metrics[3].second, rate_j = results[j].metrics[3].second;
+            dominated = ate_j <= ate_i && rate_j >= rate_i && (ate_j < ate_i || rate_j > rate_i);
+        }
+        results[i].metrics.push_back(std::make_pair("pareto", dominated ? 0. : 1.));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string estimate_file, groundtruth_file, output_file, table_file;
+    std::vector<std::pair<std::string, std::string> > recording_files;
+    std::vector<double> packets = parseList("500,1500,5000");
+    std::vector<double> iterations = parseList("1,5,10");
+    std::vector<double> upscales = parseList("1");
+    std::vector<double> accelerations = parseList("0.4");
+    std::vector<double> widths;
+    int jobs = 0;
+    double rpe_delta = 0.5;
+    bool align = true;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--estimate" && has_value)
+            estimate_file = argv[++i];
+        else if (arg == "--groundtruth" && has_value)
+            groundtruth_file = argv[++i];
+        else if (arg == "--recording" && i + 2 < argc)
+        {
+            recording_files.push_back(std::make_pair(argv[i + 1], argv[i + 2]));
+            i += 2;
+        }
+        else if (arg == "--packets" && has_value)
+            packets = parseList(argv[++i]);
+        else if (arg == "--iterations" && has_value)
+            iterations = parseList(argv[++i]);
+        else if (arg == "--upscale" && has_value)
+            upscales = parseList(argv[++i]);
+        else if (arg == "--acceleration" && has_value)
+            accelerations = parseList(argv[++i]);
+        else if (arg == "--panorama-width" && has_value)
+            widths = parseList(argv[++i]);
+        else if (arg == "--jobs" && has_value)
+            jobs = atoi(argv[++i]);
+        else if (arg == "--rpe-delta" && has_value)
+            rpe_delta = atof(argv[++i]);
+        else if (arg == "--no-align")
+            align = false;
+        else if (arg == "--output" && has_value)
+            output_file = argv[++i];
+        else if (arg == "--table" && has_value)
+            table_file = argv[++i];
+        else if (i == 1 && arg[0] != '-')
+            continue; // calibration file
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // compare two trajectory files only
+    if (!estimate_file.empty() || !groundtruth_file.empty())
+    {
+        SampledTrajectory estimate, groundtruth;
+        if (!estimate.load(estimate_file) || !groundtruth.load(groundtruth_file))
+        {
+            std::cerr << "could not read " << estimate_file << " or " << groundtruth_file << std::endl;
+            return 1;
+        }
+        printError(evaluateTrajectory(estimate, groundtruth, rpe_delta, align));
+        return 0;
+    }
+
+    if (argc < 2 || argv[1][0] == '-')
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    Parameters parameters;
+    parameters.readFromfile(argv[1]);
+    parameters.pose_output_dir = "/tmp";
+
+    std::vector<Recording> recordings(std::max((size_t)1, recording_files.size()));
+    if (recording_files.empty())
+    {
+        Panorama panorama;
+        proceduralPanorama(2048, 1024, panorama);
+        SinusoidalTrajectory trajectory(Eigen::Vector3f(0.3f, 0.3f, 0.6f), Eigen::Vector3f(0.5f, 0.4f, 0.3f));
+        EventSimulator simulator(parameters, panorama, trajectory);
+        simulator.setContrastThreshold(0.15f, 0.02f, 0);
+        std::vector<std::pair<double, Eigen::Vector3f> > poses;
+        simulator.simulate(2.0, recordings[0].events, &poses);
+        for (size_t i = 0; i < poses.size(); i++)
+            recordings[0].groundtruth.add(poses[i].first, poseToQuaternion(poses[i].second));
+        recordings[0].name = "synthetic";
+    }
+    for (size_t i = 0; i < recording_files.size(); i++)
+    {
+        recordings[i].name = recording_files[i].first;
+        if (!loadRecording(recordings[i].events, recording_files[i].first) || !recordings[i].groundtruth.load(recording_files[i].second))
+        {
+            std::cerr << "could not read recording " << recording_files[i].first << " / " << recording_files[i].second << std::endl;
+            return 1;
+        }
+    }
+
+    if (widths.empty())
+        widths.push_back(parameters.output_size_x);
+    std::vector<Configuration> configurations;
+    BenchmarkReport report;
+    report.setInfo("calibration", argv[1]);
+    for (size_t r = 0; r < recordings.size(); r++)
+    {
+        std::stringstream key;
+        key << "recording" << r;
+        report.setInfo(key.str(), recordings[r].name);
+        for (size_t p = 0; p < packets.size(); p++)
+            for (size_t it = 0; it < iterations.size(); it++)
+                for (size_t u = 0; u < upscales.size(); u++)
+                    for (size_t a = 0; a < accelerations.size(); a++)
+                        for (size_t w = 0; w < widths.size(); w++)
+                        {
+                            Configuration c = {r, (int)packets[p], (int)iterations[it], (float)upscales[u], (float)accelerations[a], (int)widths[w]};
+                            configurations.push_back(c);
+                        }
+    }
+    double start = ScopedTimer::getCurrentTime();
+    sweep(report, parameters, recordings, configurations, jobs, rpe_delta, align);
+    std::stringstream wall;
+    wall << (ScopedTimer::getCurrentTime() - start) * 1e-6;
+    report.setInfo("wall_seconds", wall.str());
+    markParetoFront(report);
+
+    report.print();
+    if (!output_file.empty() && !report.writeJson(output_file))
+    {
+        std::cerr << "could not write " << output_file << std::endl;
+        return 1;
+    }
+    if (!table_file.empty() && !report.writeCsv(table_file))
+    {
+        std::cerr << "could not write " << table_file << std::endl;
+        return 1;
+    }
+    return 0;
+}
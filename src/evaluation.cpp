@@ -0,0 +1,96 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "evaluation.h"
+#include <cmath>
+#include <algorithm>
+
+double rotationAngle(const Eigen::Quaterniond &a, const Eigen::Quaterniond &b)
+{
+    double d = std::min(1.0, std::abs(a.dot(b)));
+    return 2 * std::acos(d) * 180.0 / M_PI;
+}
+
+Eigen::Quaterniond alignRotations(const std::vector<Eigen::Quaterniond> &a, const std::vector<Eigen::Quaterniond> &b)
+{
+    Eigen::Matrix3d M = Eigen::Matrix3d::Zero();
+    for (size_t i = 0; i < a.size() && i < b.size(); i++)
+        M += a[i].toRotationMatrix() * b[i].toRotationMatrix().transpose();
+    Eigen::JacobiSVD<Eigen::Matrix3d> svd(M, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Matrix3d S = Eigen::Matrix3d::Identity();
+    if ((svd.matrixU() * svd.matrixV().transpose()).determinant() < 0)
+        S(2, 2) = -1;
+    return Eigen::Quaterniond(svd.matrixU() * S * svd.matrixV().transpose());
+}
+
+TrajectoryError evaluateTrajectory(const SampledTrajectory &estimate, const SampledTrajectory &groundtruth, double rpe_delta, bool align)
+{
+    TrajectoryError error = {0, 0, 0, 0, 0, 0};
+    if (estimate.empty() || groundtruth.empty())
+        return error;
+
+    // associate by timestamp
+    std::vector<double> times;
+    std::vector<Eigen::Quaterniond> est, gt;
+    double t_begin = groundtruth.time(0), t_end = groundtruth.time(groundtruth.size() - 1);
+    for (size_t i = 0; i < estimate.size(); i++)
+    {
+        if (estimate.time(i) < t_begin || estimate.time(i) > t_end)
+            continue;
+        times.push_back(estimate.time(i));
+        est.push_back(estimate.rotation(i));
+        gt.push_back(groundtruth.rotation(estimate.time(i)));
+    }
+    error.poses = times.size();
+    if (times.empty())
+        return error;
+
+    Eigen::Quaterniond alignment = Eigen::Quaterniond::Identity();
+    if (align)
+        alignment = alignRotations(gt, est);
+
+    double sum2 = 0;
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        double e = rotationAngle(gt[i], alignment * est[i]);
+        sum2 += e * e;
+        error.ate_mean += e;
+        error.ate_max = std::max(error.ate_max, e);
+    }
+    error.ate_rmse = std::sqrt(sum2 / times.size());
+    error.ate_mean /= times.size();
+
+    // relative error between poses rpe_delta seconds apart, independent of the alignment
+    sum2 = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        j = std::max(j, i + 1);
+        while (j < times.size() && times[j] < times[i] + rpe_delta)
+            j++;
+        if (j == times.size())
+            break;
+        Eigen::Quaterniond gt_delta = gt[i].conjugate() * gt[j];
+        Eigen::Quaterniond est_delta = est[i].conjugate() * est[j];
+        double e = rotationAngle(gt_delta, est_delta);
+        sum2 += e * e;
+        error.rpe_pairs++;
+    }
+    if (error.rpe_pairs > 0)
+        error.rpe_rmse = std::sqrt(sum2 / error.rpe_pairs);
+    return error;
+}
@@ -0,0 +1,48 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "eventsimulator.h"
+
+// Rotational errors in degrees
+struct TrajectoryError
+{
+    int poses;          // estimated poses within the ground truth time range
+    double ate_rmse;    // absolute trajectory error
+    double ate_mean;
+    double ate_max;
+    double rpe_rmse;    // relative error over rpe_delta seconds
+    int rpe_pairs;
+};
+
+// Geodesic distance between two rotations, degrees
+double rotationAngle(const Eigen::Quaterniond &a, const Eigen::Quaterniond &b);
+
+// Rotation A minimizing sum ||a_i - A b_i||, the chordal L2 mean of a_i * b_i^T
+Eigen::Quaterniond alignRotations(const std::vector<Eigen::Quaterniond> &a, const std::vector<Eigen::Quaterniond> &b);
+
+// Associates every estimated pose with the ground truth interpolated at its
+// timestamp. With align, the constant rotation between both frames is removed
+// first (chordal L2 mean of R_gt * R_est^T).
+TrajectoryError evaluateTrajectory(const SampledTrajectory &estimate, const SampledTrajectory &groundtruth, double rpe_delta = 0.5, bool align = true);
+
+#endif // EVALUATION_H
@@ -0,0 +1,215 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "eventparser.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+static const double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+// Decimal number in the usual notations: [+-]digits[.digits][e[+-]digits].
+// One multiplication or division of two exact doubles is correctly rounded,
+// so the fast path takes mantissas up to 2^53 (every number of up to 15
+// significant digits) with exponents the table covers. That is everything
+// the event files contain; longer mantissas and other tokens (inf, nan, hex)
+// are handed to strtod.
+static bool parseNumber(const char *&p, const char *end, double &value)
+{
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+        negative = *s++ == '-';
+    uint64_t mantissa = 0;
+    int significant = 0, exponent = 0;
+    bool any = false, truncated = false;
+    for (; s < end && isDigit(*s); s++, any = true)
+    {
+        if (significant < 19)
+        {
+            mantissa = mantissa * 10 + (*s - '0');
+            significant += mantissa != 0;
+        }
+        else
+        {
+            truncated = true;
+            exponent++;
+        }
+    }
+    if (s < end && *s == '.')
+    {
+        for (s++; s < end && isDigit(*s); s++, any = true)
+        {
+            if (significant < 19)
+            {
+                mantissa = mantissa * 10 + (*s - '0');
+                significant += mantissa != 0;
+                exponent--;
+            }
+            else
+                truncated = true;
+        }
+    }
+    if (!any)
+    {
+        // not a plain decimal number, let the C library try
+        char token[64];
+        size_t length = 0;
+        while (p + length < end && length < sizeof(token) - 1 && !isSeparator(p[length]) && p[length] != '\n')
+        {
+            token[length] = p[length];
+            length++;
+        }
+        token[length] = 0;
+        char *next;
+        value = strtod(token, &next);
+        if (next == token)
+            return false;
+        p += next - token;
+        return true;
+    }
+    if (s < end && (*s == 'e' || *s == 'E'))
+    {
+        const char *e = s + 1;
+        bool negative_exponent = false;
+        if (e < end && (*e == '-' || *e == '+'))
+            negative_exponent = *e++ == '-';
+        if (e < end && isDigit(*e))
+        {
+            int digits = 0;
+            for (; e < end && isDigit(*e); e++)
+                digits = std::min(digits * 10 + (*e - '0'), 100000);
+            exponent += negative_exponent ? -digits : digits;
+            s = e;
+        }
+    }
+    if (truncated || mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+    {
+        std::string token(p, s);
+        value = strtod(token.c_str(), NULL);
+        p = s;
+        return true;
+    }
+    double result = (double)mantissa;
+    if (exponent < 0)
+        result /= powers_of_ten[-exponent];
+    else if (exponent > 0)
+        result *= powers_of_ten[exponent];
+    value = negative ? -result : result;
+    p = s;
+    return true;
+}
+
+bool parseEventLine(const char *&p, const char *end, Event &event)
+{
+    double values[4];
+    int fields = 0;
+    while (fields < 4)
+    {
+        while (p < end && isSeparator(*p))
+            p++;
+        if (p == end || *p == '\n' || !parseNumber(p, end, values[fields]))
+            break;
+        fields++;
+    }
+    // rest of the line
+    const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+    p = newline ? newline + 1 : end;
+    if (fields < 4)
+        return false;
+    event.t = values[0];
+    event.x = (int)values[1];
+    event.y = (int)values[2];
+    event.polarity = values[3];
+    event.x_undist = 0;
+    event.y_undist = 0;
+    return true;
+}
+
+static void parseChunk(const char *p, const char *end, std::vector<Event> &events)
+{
+    events.reserve((end - p) / 20); // a typical line has 20-25 characters
+    Event event;
+    while (p < end)
+    {
+        if (parseEventLine(p, end, event))
+            events.push_back(event);
+    }
+}
+
+void parseEvents(const char *data, size_t size, std::vector<Event> &events, int threads)
+{
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    // a few chunks per thread balance uneven lines, but each is at least 1 MB
+    const size_t min_chunk = 1 << 20;
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(threads * 4, size / min_chunk));
+    threads = std::min<size_t>(threads, chunks);
+
+    // chunk boundaries at the start of a line
+    std::vector<const char *> bounds(chunks + 1);
+    const char *end = data + size;
+    bounds[0] = data;
+    bounds[chunks] = end;
+    for (size_t i = 1; i < chunks; i++)
+    {
+        const char *p = std::max(bounds[i - 1], data + size / chunks * i);
+        const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        bounds[i] = newline ? newline + 1 : end;
+    }
+
+    std::vector<std::vector<Event> > parsed(chunks);
+    if (threads == 1)
+        for (size_t i = 0; i < chunks; i++)
+            parseChunk(bounds[i], bounds[i + 1], parsed[i]);
+    else
+    {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++)
+            workers.push_back(std::thread([&, t]() {
+                for (size_t i = t; i < chunks; i += threads)
+                    parseChunk(bounds[i], bounds[i + 1], parsed[i]);
+            }));
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < chunks; i++)
+        total += parsed[i].size();
+    events.reserve(events.size() + total);
+    for (size_t i = 0; i < chunks; i++)
+    {
+        events.insert(events.end(), parsed[i].begin(), parsed[i].end());
+        std::vector<Event>().swap(parsed[i]);
+    }
+}
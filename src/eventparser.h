@@ -0,0 +1,36 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef EVENTPARSER_H
+#define EVENTPARSER_H
+
+#include <vector>
+#include <stddef.h>
+
+#include "event.h"
+
+// Parses the line starting at p (<t> <x> <y> <p>, separated by spaces, tabs
+// or commas) without locale or null termination and moves p to the start of
+// the next line. Returns false for lines that are not events, e.g. headers.
+bool parseEventLine(const char *&p, const char *end, Event &event);
+
+// Appends the events of a text buffer, split at line boundaries and parsed
+// on threads (0: all cores); the order of the file is kept
+void parseEvents(const char *data, size_t size, std::vector<Event> &events, int threads = 0);
+
+#endif // EVENTPARSER_H
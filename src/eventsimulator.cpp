@@ -0,0 +1,351 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "eventsimulator.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <cmath>
+#include "cnpy.h"
+
+static const int STEPS_PER_BLOCK = 64;
+
+bool loadPanorama(std::string filename, Panorama &panorama)
+{
+    std::vector<float> intensity;
+    if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".npy") == 0)
+    {
+        cnpy::NpyArray array = cnpy::npy_load(filename);
+        if (array.shape.size() != 2 || array.fortran_order)
+            return false;
+        panorama.height = array.shape[0];
+        panorama.width = array.shape[1];
+        intensity.resize(panorama.width * panorama.height);
+        for (size_t i = 0; i < intensity.size(); i++)
+        {
+            if (array.word_size == 4)
+                intensity[i] = ((float *)array.data)[i];
+            else if (array.word_size == 1)
+                intensity[i] = ((unsigned char *)array.data)[i] / 255.f;
+            else
+                return false;
+        }
+        array.destruct();
+    }
+    else
+    {
+        std::ifstream file(filename.c_str(), std::ios::binary);
+        std::string magic;
+        int max_value;
+        file >> magic;
+        // skip comments
+        while (file >> std::ws && file.peek() == '#')
+            file.ignore(4096, '\n');
+        file >> panorama.width >> panorama.height >> max_value;
+        if (!file.good() || (magic != "P5" && magic != "P2"))
+            return false;
+        file.get();
+        intensity.resize(panorama.width * panorama.height);
+        for (size_t i = 0; i < intensity.size(); i++)
+        {
+            int value;
+            if (magic == "P2")
+                file >> value;
+            else if (max_value < 256)
+                value = (unsigned char)file.get();
+            else
+            {
+                value = (unsigned char)file.get() << 8;
+                value |= (unsigned char)file.get();
+            }
+            intensity[i] = float(value) / max_value;
+        }
+        if (!file.good())
+            return false;
+    }
+    panorama.log_intensity.resize(intensity.size());
+    for (size_t i = 0; i < intensity.size(); i++)
+        panorama.log_intensity[i] = std::log(intensity[i] + 1e-3f);
+    return true;
+}
+
+// sum of sinusoids of different frequencies and orientations plus a checkerboard
+// for sharp edges, periodic in azimuth
+void proceduralPanorama(int width, int height, Panorama &panorama)
+{
+    panorama.width = width;
+    panorama.height = height;
+    panorama.log_intensity.resize(width * height);
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    const int waves = 12;
+    float kx[waves], ky[waves], phase[waves];
+    for (int i = 0; i < waves; i++)
+    {
+        kx[i] = 2 * M_PI * (int)(2 + 30 * uniform(generator)) / width;
+        ky[i] = 2 * M_PI * (1 + 15 * uniform(generator)) / height;
+        phase[i] = 2 * M_PI * uniform(generator);
+    }
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            float value = 0;
+            for (int i = 0; i < waves; i++)
+                value += std::sin(kx[i] * x + ky[i] * y + phase[i]);
+            bool checker = ((x * 16 / width) + (y * 8 / height)) % 2;
+            float intensity = 0.5f + 0.25f * value / std::sqrt((float)waves) + (checker ? 0.15f : -0.15f);
+            panorama.log_intensity[y * width + x] = std::log(std::min(std::max(intensity, 0.f), 1.f) + 1e-3f);
+        }
+    }
+}
+
+Eigen::Vector3f SinusoidalTrajectory::pose(double t) const
+{
+    Eigen::Vector3f pose;
+    for (int i = 0; i < 3; i++)
+        pose(i) = amplitude_(i) * std::sin(2 * M_PI * frequency_(i) * t);
+    return pose;
+}
+
+// the tracker writes the axis as (pose[1], pose[2], pose[0])
+Eigen::Quaterniond poseToQuaternion(const Eigen::Vector3f &pose)
+{
+    double rad = pose.norm();
+    if (rad < 1e-12)
+        return Eigen::Quaterniond::Identity();
+    Eigen::AngleAxisd aa(rad, Eigen::Vector3d(pose[1], pose[2], pose[0]) / rad);
+    return Eigen::Quaterniond(aa);
+}
+
+Eigen::Vector3f quaternionToPose(const Eigen::Quaterniond &q)
+{
+    Eigen::AngleAxisd aa(q);
+    Eigen::Vector3d axis = aa.axis() * aa.angle();
+    return Eigen::Vector3f(axis(2), axis(0), axis(1));
+}
+
+bool SampledTrajectory::load(std::string filename)
+{
+    times_.clear();
+    rotations_.clear();
+    std::ifstream file(filename.c_str());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::stringstream str(line);
+        double t, x, y, z, qx, qy, qz, qw;
+        if (!(str >> t >> x >> y >> z >> qx >> qy >> qz >> qw))
+            continue;
+        add(t, Eigen::Quaterniond(qw, qx, qy, qz));
+    }
+    return !times_.empty();
+}
+
+void SampledTrajectory::add(double t, const Eigen::Quaterniond &q)
+{
+    times_.push_back(t);
+    rotations_.push_back(q.normalized());
+}
+
+Eigen::Quaterniond SampledTrajectory::rotation(double t) const
+{
+    if (times_.empty())
+        return Eigen::Quaterniond::Identity();
+    size_t i = std::upper_bound(times_.begin(), times_.end(), t) - times_.begin();
+    if (i == 0)
+        return rotations_.front();
+    if (i == times_.size())
+        return rotations_.back();
+    double s = (t - times_[i - 1]) / (times_[i] - times_[i - 1]);
+    return rotations_[i - 1].slerp(s, rotations_[i]);
+}
+
+Eigen::Vector3f SampledTrajectory::pose(double t) const
+{
+    return quaternionToPose(rotation(t));
+}
+
+// same rotation as rodrigues() in direct.cu
+static Eigen::Matrix3f rotationMatrix(const Eigen::Vector3f &pose)
+{
+    float angle = pose.norm();
+    if (angle < 1e-8f)
+        return Eigen::Matrix3f::Identity();
+    return Eigen::AngleAxisf(angle, pose / angle).toRotationMatrix();
+}
+
+template <class Camera>
+static void setupPixels(const CameraGeometry &cam, int width, int height, std::vector<Eigen::Vector3f> &bearings, std::vector<int> &raw_x, std::vector<int> &raw_y)
+{
+    for (int v = 0; v < height; v++)
+    {
+        for (int u = 0; u < width; u++)
+        {
+            float3 ray = Camera::bearing(cam, make_float2(u, v));
+            float2 distorted = Camera::distort(cam, make_float2((u - cam.cx) / cam.fx, (v - cam.cy) / cam.fy));
+            // truncation as in TrackingWorker::getUndistortMap
+            float u_distorted = cam.fx * distorted.x + cam.cx;
+            float v_distorted = cam.fy * distorted.y + cam.cy;
+            bool inside = u_distorted >= 0 && v_distorted >= 0 && u_distorted < width && v_distorted < height;
+            bearings.push_back(Eigen::Vector3f(ray.x, ray.y, ray.z));
+            raw_x.push_back(inside ? (int)u_distorted : -1);
+            raw_y.push_back(inside ? (int)v_distorted : -1);
+        }
+    }
+}
+
+EventSimulator::EventSimulator(const Parameters &parameters, const Panorama &panorama, const RotationTrajectory &trajectory, int threads)
+    : panorama_(panorama), trajectory_(trajectory)
+{
+    threads_ = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    dt_ = 1e-4;
+    t_ = 0;
+
+    panorama_geometry_.pp = make_float2(panorama.width / 2.f, panorama.height / 2.f);
+    panorama_geometry_.scale = 1.f;
+    panorama_geometry_.width = panorama.width;
+    panorama_geometry_.height = panorama.height;
+    panorama_geometry_.face_size = 0;
+
+    CameraGeometry cam = parameters.cameraGeometry();
+    int width = parameters.camera_width, height = parameters.camera_height;
+    switch (parameters.camera_model)
+    {
+    case CAMERA_PINHOLE:
+        setupPixels<PinholeCamera>(cam, width, height, bearings_, raw_x_, raw_y_);
+        break;
+    case CAMERA_EQUIDISTANT:
+        setupPixels<EquidistantCamera>(cam, width, height, bearings_, raw_x_, raw_y_);
+        break;
+    default:
+        setupPixels<RadTanCamera>(cam, width, height, bearings_, raw_x_, raw_y_);
+        break;
+    }
+
+    Eigen::Matrix3f R = rotationMatrix(trajectory_.pose(0));
+    last_.resize(bearings_.size());
+    for (size_t i = 0; i < bearings_.size(); i++)
+        last_[i] = sample(R, i);
+    reference_ = last_;
+    setContrastThreshold(0.15f);
+}
+
+void EventSimulator::setContrastThreshold(float threshold, float sigma, unsigned int seed)
+{
+    // fixed seed: per-pixel mismatch is reproducible
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> mismatch(0.f, sigma);
+    threshold_.resize(bearings_.size());
+    for (size_t i = 0; i < threshold_.size(); i++)
+        threshold_[i] = std::max(0.01f, threshold + (sigma > 0 ? mismatch(generator) : 0.f));
+}
+
+float EventSimulator::sample(const Eigen::Matrix3f &R, int pixel) const
+{
+    Eigen::Vector3f d = R * bearings_[pixel];
+    float2 p = EquirectangularProjection::project(panorama_geometry_, make_float3(d(0), d(1), d(2)));
+    // bilinear, wrapping in azimuth
+    float x = p.x, y = std::min(std::max(p.y, 0.f), panorama_.height - 1.f);
+    int x0 = (int)std::floor(x), y0 = (int)y;
+    float fx = x - x0, fy = y - y0;
+    int y1 = std::min(y0 + 1, panorama_.height - 1);
+    x0 = ((x0 % panorama_.width) + panorama_.width) % panorama_.width;
+    int x1 = (x0 + 1) % panorama_.width;
+    const float *row0 = &panorama_.log_intensity[y0 * panorama_.width];
+    const float *row1 = &panorama_.log_intensity[y1 * panorama_.width];
+    return (1 - fy) * ((1 - fx) * row0[x0] + fx * row0[x1]) + fy * ((1 - fx) * row1[x0] + fx * row1[x1]);
+}
+
+void EventSimulator::simulatePixels(int begin, int end, int steps, const std::vector<Eigen::Matrix3f> &rotations, std::vector<std::vector<Event> > &buckets)
+{
+    Event event;
+    event.x_undist = event.y_undist = 0;
+    for (int pixel = begin; pixel < end; pixel++)
+    {
+        if (raw_x_[pixel] < 0)
+            continue;
+        event.x = raw_x_[pixel];
+        event.y = raw_y_[pixel];
+        float reference = reference_[pixel];
+        float last = last_[pixel];
+        const float C = threshold_[pixel];
+        for (int k = 0; k < steps; k++)
+        {
+            float current = sample(rotations[k], pixel);
+            double t_prev = t_ + k * dt_;
+            // one event per threshold crossing, time interpolated linearly within the step
+            while (current - reference >= C || reference - current >= C)
+            {
+                event.polarity = current > reference ? 1.f : -1.f;
+                reference += event.polarity * C;
+                float s = std::abs(current - last) > 1e-12f ? (reference - last) / (current - last) : 1.f;
+                event.t = t_prev + dt_ * std::min(std::max(s, 0.f), 1.f);
+                buckets[k].push_back(event);
+            }
+            last = current;
+        }
+        reference_[pixel] = reference;
+        last_[pixel] = last;
+    }
+}
+
+void EventSimulator::simulate(double t_end, std::vector<Event> &events, std::vector<std::pair<double, Eigen::Vector3f> > *poses)
+{
+    int total_steps = (int)std::floor((t_end - t_) / dt_ + 1e-9);
+    int pixels = bearings_.size();
+    int chunk = (pixels + threads_ - 1) / threads_;
+    std::vector<std::vector<std::vector<Event> > > buckets(threads_, std::vector<std::vector<Event> >(STEPS_PER_BLOCK));
+    std::vector<Eigen::Matrix3f> rotations(STEPS_PER_BLOCK);
+
+    for (int block = 0; block < total_steps; block += STEPS_PER_BLOCK)
+    {
+        int steps = std::min(STEPS_PER_BLOCK, total_steps - block);
+        for (int k = 0; k < steps; k++)
+        {
+            double t = t_ + (k + 1) * dt_;
+            Eigen::Vector3f pose = trajectory_.pose(t);
+            rotations[k] = rotationMatrix(pose);
+            if (poses)
+                poses->push_back(std::make_pair(t, pose));
+        }
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads_; i++)
+        {
+            for (int k = 0; k < steps; k++)
+                buckets[i][k].clear();
+            workers.push_back(std::thread(&EventSimulator::simulatePixels, this, i * chunk, std::min(pixels, (i + 1) * chunk), steps, std::cref(rotations), std::ref(buckets[i])));
+        }
+        for (int i = 0; i < threads_; i++)
+            workers[i].join();
+
+        // merge the threads' events of every step in time order
+        for (int k = 0; k < steps; k++)
+        {
+            size_t first = events.size();
+            for (int i = 0; i < threads_; i++)
+                events.insert(events.end(), buckets[i][k].begin(), buckets[i][k].end());
+            std::sort(events.begin() + first, events.end(), [](const Event &a, const Event &b) { return a.t < b.t; });
+        }
+        t_ += steps * dt_;
+    }
+}
@@ -0,0 +1,123 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EVENTSIMULATOR_H
+#define EVENTSIMULATOR_H
+
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "event.h"
+#include "parameters.h"
+
+// Equirectangular panorama (full sphere), stored as log intensity
+struct Panorama
+{
+    int width;
+    int height;
+    std::vector<float> log_intensity;
+};
+
+// Loads binary/ascii PGM (P5/P2) or a 2D .npy (float32 or uint8) image
+bool loadPanorama(std::string filename, Panorama &panorama);
+
+// Deterministic textured panorama for runs without an image
+void proceduralPanorama(int width, int height, Panorama &panorama);
+
+// Rotation over time in the parametrization of TrackingWorker::pose_
+class RotationTrajectory
+{
+public:
+    virtual ~RotationTrajectory() {}
+    virtual Eigen::Vector3f pose(double t) const = 0;
+};
+
+// pose(t) = amplitude .* sin(2 pi frequency t), starts at the identity
+class SinusoidalTrajectory : public RotationTrajectory
+{
+public:
+    SinusoidalTrajectory(Eigen::Vector3f amplitude, Eigen::Vector3f frequency) : amplitude_(amplitude), frequency_(frequency) {}
+    Eigen::Vector3f pose(double t) const;
+
+protected:
+    Eigen::Vector3f amplitude_;
+    Eigen::Vector3f frequency_;
+};
+
+// Stamped rotations, read from a trajectory file in the format written by the
+// tracker (t x y z qx qy qz qw) or added in time order; interpolated with slerp
+class SampledTrajectory : public RotationTrajectory
+{
+public:
+    SampledTrajectory() {}
+    SampledTrajectory(std::string filename) { load(filename); }
+    bool load(std::string filename);
+    void add(double t, const Eigen::Quaterniond &q);
+
+    bool empty(void) const { return times_.empty(); }
+    size_t size(void) const { return times_.size(); }
+    double time(size_t i) const { return times_[i]; }
+    const Eigen::Quaterniond &rotation(size_t i) const { return rotations_[i]; }
+    Eigen::Quaterniond rotation(double t) const;
+    Eigen::Vector3f pose(double t) const;
+
+protected:
+    std::vector<double> times_;
+    std::vector<Eigen::Quaterniond> rotations_;
+};
+
+// Conversions between pose vectors and the quaternions written to estimated_pose_rpg.txt
+Eigen::Quaterniond poseToQuaternion(const Eigen::Vector3f &pose);
+Eigen::Vector3f quaternionToPose(const Eigen::Quaterniond &q);
+
+// Contrast threshold event camera looking at a panorama. Pixels are split
+// across threads; events of one time step are merged and sorted by time.
+class EventSimulator
+{
+public:
+    EventSimulator(const Parameters &parameters, const Panorama &panorama, const RotationTrajectory &trajectory, int threads = 0);
+
+    void setContrastThreshold(float threshold, float sigma = 0.f, unsigned int seed = 0);
+    void setTimeStep(double dt) { dt_ = dt; }
+
+    // Simulates from the current time up to t_end and appends the events.
+    // Ground truth poses of every time step are appended to poses, if given.
+    void simulate(double t_end, std::vector<Event> &events, std::vector<std::pair<double, Eigen::Vector3f> > *poses = NULL);
+    double time(void) const { return t_; }
+
+protected:
+    float sample(const Eigen::Matrix3f &R, int pixel) const;
+    void simulatePixels(int begin, int end, int steps, const std::vector<Eigen::Matrix3f> &rotations, std::vector<std::vector<Event> > &buckets);
+
+    const Panorama &panorama_;
+    const RotationTrajectory &trajectory_;
+    MapGeometry panorama_geometry_;
+    int threads_;
+    double dt_;
+    double t_;
+
+    // per pixel: bearing of the undistorted pixel and the raw pixel it is observed at
+    std::vector<Eigen::Vector3f> bearings_;
+    std::vector<int> raw_x_;
+    std::vector<int> raw_y_;
+    std::vector<float> reference_;
+    std::vector<float> last_;
+    std::vector<float> threshold_;
+};
+
+#endif // EVENTSIMULATOR_H
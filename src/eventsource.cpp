@@ -0,0 +1,437 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "eventsource.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "common.h"
+#include "caerpacket.h"
+#include "eventparser.h"
+
+static bool eventBefore(const Event &event, double t)
+{
+    return event.t < t;
+}
+
+bool MemoryEventSource::read(std::vector<Event> &batch)
+{
+    size_t end = std::min(events_.size(), position_ + batch_size_);
+    batch.assign(events_.begin() + position_, events_.begin() + end);
+    position_ = end;
+    return !batch.empty();
+}
+
+bool MemoryEventSource::seek(double t)
+{
+    position_ = std::lower_bound(events_.begin(), events_.end(), t, eventBefore) - events_.begin();
+    return true;
+}
+
+static bool endsWith(const std::string &s, const char *suffix)
+{
+    size_t n = strlen(suffix);
+    return s.size() > n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+bool FileEventSource::open(const std::string &filename)
+{
+    prefix_.clear();
+    index_.clear();
+    file_number_ = 0;
+    files_ = 0;
+    if (endsWith(filename, ".idx"))
+    {
+        prefix_ = filename.substr(0, filename.size() - 4);
+        if (!loadRecordingIndex(prefix_, index_))
+            return false;
+        while (access(recordingFile(prefix_, files_).c_str(), R_OK) == 0)
+            files_++;
+        if (files_ == 0 || !openFile(recordingFile(prefix_, files_ - 1)))
+            return false;
+        double end = end_time_;
+        if (!openFile(recordingFile(prefix_, 0)))
+            return false;
+        end_time_ = end;
+        return true;
+    }
+    // a file of a rotated recording seeks with the index of the recording
+    size_t underscore = filename.rfind('_');
+    if (endsWith(filename, ".aedat") && underscore != std::string::npos)
+    {
+        std::string prefix = filename.substr(0, underscore);
+        int number = atoi(filename.c_str() + underscore + 1);
+        std::vector<RecordingIndexEntry> entries;
+        if (recordingFile(prefix, number) == filename && loadRecordingIndex(prefix, entries))
+        {
+            file_number_ = number;
+            for (size_t i = 0; i < entries.size(); i++)
+                if (entries[i].file == number)
+                    index_.push_back(entries[i]);
+        }
+    }
+    return openFile(filename);
+}
+
+bool FileEventSource::openPart(int number)
+{
+    double start = start_time_, end = end_time_;
+    bool opened = openFile(recordingFile(prefix_, number));
+    start_time_ = start;
+    end_time_ = end;
+    file_number_ = number;
+    return opened;
+}
+
+bool FileEventSource::openFile(const std::string &filename)
+{
+    position_ = 0;
+    data_offset_ = 0;
+    start_time_ = end_time_ = 0;
+    if (!file_.open(filename))
+        return false;
+    file_.advise(MADV_SEQUENTIAL);
+    format_ = endsWith(filename, ".dat") ? FORMAT_DAT : FORMAT_TEXT;
+    if (endsWith(filename, ".aedat") || (file_.size() >= 10 && memcmp(file_.data(), "#!AER-DAT3", 10) == 0))
+        format_ = FORMAT_AEDAT;
+    Event event;
+    if (format_ == FORMAT_DAT)
+    {
+        if (records() == 0)
+            return true;
+        decode(0, event);
+        start_time_ = event.t;
+        decode(records() - 1, event);
+        end_time_ = event.t;
+        return true;
+    }
+    if (format_ == FORMAT_AEDAT)
+    {
+        // header lines start with '#' and end with #!END-HEADER
+        static const char end_header[] = "#!END-HEADER\r\n";
+        const char *data = file_.data();
+        while (data_offset_ < file_.size() && data[data_offset_] == '#')
+        {
+            bool last = file_.size() - data_offset_ >= sizeof(end_header) - 1 && memcmp(data + data_offset_, end_header, sizeof(end_header) - 1) == 0;
+            data_offset_ = lineStart(data_offset_ + 1);
+            if (last)
+                break;
+        }
+        position_ = data_offset_;
+        // packets are hopped over by their headers, the events are not touched
+        bool first = true;
+        double packet_first, packet_last;
+        for (size_t offset = data_offset_, size; (size = packetSize(offset)) > 0; offset += size)
+        {
+            if (!packetTimes(offset, packet_first, packet_last))
+                continue;
+            if (first)
+                start_time_ = packet_first;
+            first = false;
+            end_time_ = packet_last;
+        }
+        return true;
+    }
+    bool valid = false;
+    for (size_t offset = 0; offset < file_.size() && !valid;)
+        offset = parseLine(offset, event, valid);
+    if (!valid)
+        return true;
+    start_time_ = event.t;
+    // last valid line, searching backwards from the end
+    size_t end = file_.size();
+    while (end > 0)
+    {
+        size_t begin = end - 1;
+        while (begin > 0 && file_.data()[begin - 1] != '\n')
+            begin--;
+        parseLine(begin, event, valid);
+        if (valid)
+        {
+            end_time_ = event.t;
+            break;
+        }
+        end = begin;
+    }
+    return true;
+}
+
+size_t FileEventSource::packetSize(size_t offset) const
+{
+    if (file_.size() - offset < sizeof(CaerPacketHeader))
+        return 0;
+    CaerPacketHeader header;
+    memcpy(&header, file_.data() + offset, sizeof(header));
+    size_t size = caerPacketSize(header);
+    return size <= file_.size() - offset ? size : 0;
+}
+
+bool FileEventSource::packetTimes(size_t offset, double &first, double &last) const
+{
+    CaerPacketHeader header;
+    memcpy(&header, file_.data() + offset, sizeof(header));
+    if (header.event_type != CAER_POLARITY_EVENT_TYPE || header.event_number == 0)
+        return false;
+    const char *events = file_.data() + offset + sizeof(header);
+    int64_t ts_base = (int64_t)header.event_ts_overflow << 31;
+    int32_t ts;
+    memcpy(&ts, events + header.event_ts_offset, 4);
+    first = (ts_base + ts) * 1e-6;
+    memcpy(&ts, events + (size_t)(header.event_number - 1) * header.event_size + header.event_ts_offset, 4);
+    last = (ts_base + ts) * 1e-6;
+    return true;
+}
+
+size_t FileEventSource::parseLine(size_t offset, Event &event, bool &valid) const
+{
+    const char *p = file_.data() + offset;
+    valid = parseEventLine(p, file_.data() + file_.size(), event);
+    return p - file_.data();
+}
+
+size_t FileEventSource::lineStart(size_t offset) const
+{
+    if (offset == 0)
+        return 0;
+    const char *data = file_.data();
+    const char *newline = static_cast<const char *>(memchr(data + offset - 1, '\n', file_.size() - offset + 1));
+    return newline ? newline - data + 1 : file_.size();
+}
+
+void FileEventSource::decode(size_t record, Event &event) const
+{
+    // <timestamp in us> <x | y << 9 | polarity << 17>, see EventWriter
+    uint32_t data[2];
+    memcpy(data, file_.data() + record * 8, 8);
+    event.t = data[0] * TIME_CONSTANT;
+    event.x = data[1] & 0x000001FF;
+    event.y = (data[1] & 0x0001FE00) >> 9;
+    event.polarity = (data[1] & 0x00020000) ? 1 : -1;
+    event.x_undist = event.y_undist = 0;
+}
+
+bool FileEventSource::read(std::vector<Event> &batch)
+{
+    batch.clear();
+    Event event;
+    if (format_ == FORMAT_AEDAT)
+    { // whole packets, up to batch_size events unless a single packet is larger
+        while (batch.size() < batch_size_)
+        {
+            size_t size = packetSize(position_);
+            if (size == 0)
+            { // continue with the next file of a rotated recording
+                if (prefix_.empty() || file_number_ + 1 >= files_ || !openPart(file_number_ + 1))
+                    break;
+                continue;
+            }
+            decodeCaerPolarityPacket(file_.data() + position_, batch);
+            position_ += size;
+        }
+        return !batch.empty() || packetSize(position_) > 0;
+    }
+    if (format_ == FORMAT_DAT)
+    {
+        size_t end = std::min(records(), position_ + batch_size_);
+        batch.resize(end - position_);
+        for (size_t i = position_; i < end; i++)
+            decode(i, batch[i - position_]);
+        position_ = end;
+        return !batch.empty();
+    }
+    while (batch.size() < batch_size_ && position_ < file_.size())
+    {
+        bool valid;
+        position_ = parseLine(position_, event, valid);
+        if (valid)
+            batch.push_back(event);
+    }
+    return !batch.empty();
+}
+
+bool FileEventSource::seek(double t)
+{
+    if (!file_.isOpen())
+        return false;
+    Event event;
+    if (format_ == FORMAT_AEDAT)
+    { // first packet that ends at or after t, searched from the indexed packet before t
+        RecordingIndexEntry entry;
+        bool indexed = findRecordingPosition(index_, t, entry) && (!prefix_.empty() || entry.file == file_number_);
+        if (!prefix_.empty() && (indexed ? entry.file : 0) != file_number_ && !openPart(indexed ? entry.file : 0))
+            return false;
+        position_ = indexed && entry.offset >= data_offset_ ? entry.offset : data_offset_;
+        double first, last;
+        while (true)
+        {
+            size_t size = packetSize(position_);
+            if (size == 0)
+            {
+                if (prefix_.empty() || file_number_ + 1 >= files_ || !openPart(file_number_ + 1))
+                    break;
+                position_ = data_offset_;
+                continue;
+            }
+            if (packetTimes(position_, first, last) && last >= t)
+                break;
+            position_ += size;
+        }
+        return true;
+    }
+    size_t low = 0, high = format_ == FORMAT_DAT ? records() : file_.size();
+    // binary search for the first record / byte offset whose next event is at or after t
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        bool after = true;
+        if (format_ == FORMAT_DAT)
+        {
+            decode(middle, event);
+            after = event.t >= t;
+        }
+        else
+        {
+            bool valid = false;
+            for (size_t offset = lineStart(middle); offset < file_.size() && !valid;)
+                offset = parseLine(offset, event, valid);
+            after = !valid || event.t >= t;
+        }
+        if (after)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    position_ = format_ == FORMAT_DAT ? low : lineStart(low);
+    return true;
+}
+
+bool SyntheticEventSource::read(std::vector<Event> &batch)
+{
+    batch.clear();
+    if (simulator_.time() >= duration_)
+        return false;
+    simulator_.simulate(std::min(duration_, simulator_.time() + chunk_), batch);
+    return true;
+}
+
+ReplayEventSource::ReplayEventSource(EventSource &source, double speed, bool loop, double slice)
+    : source_(source), speed_(speed), loop_(loop), slice_(slice), position_(0), offset_(0), started_(false), last_t_(0), anchored_(false), anchor_t_(0)
+{
+}
+
+void ReplayEventSource::setSpeed(double speed)
+{
+    speed_ = speed;
+    anchored_ = false;
+}
+
+bool ReplayEventSource::fill()
+{
+    pending_.clear();
+    position_ = 0;
+    if (!source_.read(pending_))
+    {
+        if (!loop_ || !source_.seekable() || !started_)
+            return false;
+        // the next loop continues one slice after the last event
+        source_.seek(source_.startTime());
+        offset_ = last_t_ + slice_ - source_.startTime();
+        if (!source_.read(pending_))
+            return false;
+    }
+    if (offset_ != 0)
+        for (size_t i = 0; i < pending_.size(); i++)
+            pending_[i].t += offset_;
+    return true;
+}
+
+bool ReplayEventSource::read(std::vector<Event> &batch)
+{
+    batch.clear();
+    if (position_ >= pending_.size())
+    {
+        if (!fill())
+            return false;
+        if (pending_.empty())
+            return true; // live source without events
+    }
+    size_t end = position_;
+    double slice_end = pending_[position_].t + slice_;
+    while (end < pending_.size() && (speed_ <= 0 || pending_[end].t < slice_end))
+        end++;
+
+    if (speed_ > 0)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!anchored_)
+        {
+            anchor_host_ = now;
+            anchor_t_ = pending_[position_].t;
+            anchored_ = true;
+        }
+        // a batch is due when its newest event would have been recorded
+        std::chrono::steady_clock::time_point due =
+            anchor_host_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((pending_[end - 1].t - anchor_t_) / speed_));
+        // wait in short steps so the reader can be stopped during long gaps
+        const std::chrono::milliseconds max_wait(50);
+        if (due - now > max_wait)
+        {
+            std::this_thread::sleep_for(max_wait);
+            return true;
+        }
+        std::this_thread::sleep_until(due);
+    }
+    batch.assign(pending_.begin() + position_, pending_.begin() + end);
+    position_ = end;
+    last_t_ = batch.back().t;
+    started_ = true;
+    return true;
+}
+
+bool ReplayEventSource::seek(double t)
+{
+    if (!source_.seek(t))
+        return false;
+    pending_.clear();
+    position_ = 0;
+    // keep timestamps increasing for the tracker
+    offset_ = started_ ? last_t_ + slice_ - t : 0;
+    anchored_ = false;
+    return true;
+}
+
+bool loadRecording(std::vector<Event> &events, const std::string &filename)
+{
+    std::string extension = filename.substr(filename.find_last_of('.') + 1);
+    if (extension != "dat" && extension != "aedat" && extension != "idx")
+    {
+        loadEvents(events, filename);
+        return !events.empty();
+    }
+    FileEventSource source(1 << 20);
+    if (!source.open(filename))
+        return false;
+    std::vector<Event> batch;
+    while (source.read(batch))
+        events.insert(events.end(), batch.begin(), batch.end());
+    return !events.empty();
+}
@@ -0,0 +1,179 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef EVENTSOURCE_H
+#define EVENTSOURCE_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "event.h"
+#include "mappedfile.h"
+#include "eventsimulator.h"
+#include "recorder.h"
+
+// Producer of events in time order, read in batches
+class EventSource
+{
+public:
+    virtual ~EventSource() {}
+
+    // Replaces the contents of batch (keeping its capacity) with the next
+    // events. Returns false at the end of the stream; live sources may
+    // return an empty batch if nothing arrived yet.
+    virtual bool read(std::vector<Event> &batch) = 0;
+
+    // Recordings can be positioned at the first event at or after t (sensor
+    // time in seconds) and know their time range
+    virtual bool seekable(void) const { return false; }
+    virtual bool seek(double t) { return false; }
+    virtual double startTime(void) const { return 0; }
+    virtual double endTime(void) const { return 0; }
+    // Events arrive at the pace of their timestamps (cameras, paced replay),
+    // so the host clock tells how stale queued events are
+    virtual bool realTime(void) const { return false; }
+};
+
+// Events already in memory; the vector is referenced, not copied
+class MemoryEventSource : public EventSource
+{
+public:
+    MemoryEventSource(const std::vector<Event> &events, size_t batch_size = 4096) : events_(events), batch_size_(batch_size), position_(0) {}
+    bool read(std::vector<Event> &batch);
+    bool seekable(void) const { return true; }
+    bool seek(double t);
+    double startTime(void) const { return events_.empty() ? 0 : events_.front().t; }
+    double endTime(void) const { return events_.empty() ? 0 : events_.back().t; }
+
+protected:
+    const std::vector<Event> &events_;
+    size_t batch_size_;
+    size_t position_;
+};
+
+// Event file, memory-mapped and parsed batch by batch: text (<t> <x> <y> <p>
+// per line, .txt/.aer2), the binary format of Bardow et al. (.dat) or
+// libcaer packets as in AEDAT 3 (.aedat, raw captures). AEDAT files seek to
+// the packet containing t. The index <prefix>.idx of an EventRecorder opens
+// all of its files <prefix>_NNNN.aedat as one recording; seeks in it, or in
+// one of its files, jump to the nearest indexed packet.
+class FileEventSource : public EventSource
+{
+public:
+    FileEventSource(size_t batch_size = 4096) : batch_size_(batch_size), position_(0), data_offset_(0), format_(FORMAT_TEXT), start_time_(0), end_time_(0), file_number_(0), files_(0) {}
+    bool open(const std::string &filename);
+    void close(void) { file_.close(); }
+    bool isOpen(void) const { return file_.isOpen(); }
+
+    bool read(std::vector<Event> &batch);
+    bool seekable(void) const { return true; }
+    bool seek(double t);
+    double startTime(void) const { return start_time_; }
+    double endTime(void) const { return end_time_; }
+
+protected:
+    enum Format
+    {
+        FORMAT_TEXT,
+        FORMAT_DAT,
+        FORMAT_AEDAT
+    };
+
+    bool openFile(const std::string &filename);
+    // file number of a rotated recording, keeps the time range of the whole set
+    bool openPart(int number);
+
+    // text: parses the line at offset, returns the start of the next line
+    size_t parseLine(size_t offset, Event &event, bool &valid) const;
+    size_t lineStart(size_t offset) const; // first line starting at or after offset
+    void decode(size_t record, Event &event) const; // .dat
+    size_t records(void) const { return file_.size() / 8; }
+    // .aedat: size of the packet at offset, 0 at the end or if truncated
+    size_t packetSize(size_t offset) const;
+    bool packetTimes(size_t offset, double &first, double &last) const;
+
+    MappedFile file_;
+    size_t batch_size_;
+    size_t position_; // byte offset (text, .aedat) or record (.dat)
+    size_t data_offset_; // first packet after the AEDAT header
+    Format format_;
+    double start_time_;
+    double end_time_;
+
+    // rotated recordings
+    std::string prefix_; // opened from <prefix>.idx, else empty
+    int file_number_;    // of the open file
+    int files_;
+    std::vector<RecordingIndexEntry> index_; // entries of the open file only, unless prefix_ is set
+};
+
+// Events of an EventSimulator, generated chunk by chunk up to duration
+class SyntheticEventSource : public EventSource
+{
+public:
+    SyntheticEventSource(EventSimulator &simulator, double duration, double chunk = 0.01) : simulator_(simulator), duration_(duration), chunk_(chunk) {}
+    bool read(std::vector<Event> &batch);
+    double endTime(void) const { return duration_; }
+
+protected:
+    EventSimulator &simulator_;
+    double duration_;
+    double chunk_;
+};
+
+// Hands out the events of another source at the pace of their timestamps,
+// speed times faster than real time (<= 0: as fast as possible). Paced
+// batches span at most slice seconds of sensor time. With loop, seekable sources
+// restart at their beginning, shifted in time so timestamps keep increasing.
+class ReplayEventSource : public EventSource
+{
+public:
+    ReplayEventSource(EventSource &source, double speed = 1, bool loop = false, double slice = 1e-3);
+    void setSpeed(double speed);
+
+    bool read(std::vector<Event> &batch);
+    bool seekable(void) const { return source_.seekable(); }
+    bool seek(double t);
+    double startTime(void) const { return source_.startTime(); }
+    double endTime(void) const { return source_.endTime(); }
+    bool realTime(void) const { return speed_ > 0; }
+
+protected:
+    bool fill(void);
+
+    EventSource &source_;
+    double speed_;
+    bool loop_;
+    double slice_;
+    std::vector<Event> pending_;
+    size_t position_;
+    double offset_; // added to the timestamps after a loop or seek
+    bool started_;  // any events handed out
+    double last_t_;
+    // host time at which the sensor time anchor_t_ is due
+    bool anchored_;
+    std::chrono::steady_clock::time_point anchor_host_;
+    double anchor_t_;
+};
+
+// Whole recording in memory: text files are parsed on all cores, .dat and
+// .aedat are decoded as a whole
+bool loadRecording(std::vector<Event> &events, const std::string &filename);
+
+#endif // EVENTSOURCE_H
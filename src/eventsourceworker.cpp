@@ -0,0 +1,45 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "eventsourceworker.h"
+#include "tracing.h"
+
+void EventSourceWorker::run()
+{
+    if (!source_)
+        return;
+    Tracer::setThreadName("events");
+    running_ = true;
+    while(running_)
+    {
+        if (!source_->read(events_buffer_))
+            break; // end of a recording
+        if (events_buffer_.empty()) {
+            // real-time sources already wait for their events in read
+            if (!source_->realTime())
+                msleep(1);
+            continue; // Skip if nothing there.
+        }
+        ugly_->addEvents(events_buffer_);
+    }
+}
+
+EventSourceWorker::EventSourceWorker(TrackingWorker *worker):source_(NULL),ugly_(worker),running_(false)
+{
+
+}
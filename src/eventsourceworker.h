@@ -15,33 +15,34 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-#ifndef DVSCAMERAWORKER_H
-#define DVSCAMERAWORKER_H
+
+#ifndef EVENTSOURCEWORKER_H
+#define EVENTSOURCEWORKER_H
 
 #include <QThread>
-#include <libcaer/libcaer.h>
-#include <libcaer/devices/dvs128.h>
-#include <queue>
 
 #include "event.h"
+#include "eventsource.h"
 #include "trackingworker.h"
 
-class DVSCameraWorker : public QThread
+// Reads an EventSource on its own thread and queues the batches in the
+// TrackingWorker until the source ends or stop is called
+class EventSourceWorker : public QThread
 {
     Q_OBJECT
    void run() Q_DECL_OVERRIDE;
 public:
-    DVSCameraWorker(TrackingWorker *worker = 0);
+    EventSourceWorker(TrackingWorker *worker = 0);
+    // not owned, must not change while running
+    void setSource(EventSource *source) { source_ = source; }
 public slots:
     void stop(void){running_=false;}
 
 protected:
-    bool init(void);
-    void deinit(void);
     std::vector<Event> events_buffer_;
-    caerDeviceHandle dvs128_handle_;
+    EventSource *source_;
     TrackingWorker *ugly_;
     bool running_;
 };
 
-#endif // DVSCAMERAWORKER_H
+#endif // EVENTSOURCEWORKER_H
@@ -0,0 +1,155 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// system includes
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "event.h"
+#include "common.h"
+#include "parameters.h"
+#include "eventsimulator.h"
+
+static void usage(const char *name)
+{
+    std::cout << "usage: " << name << " <calibration file> <panorama .pgm/.npy> <output prefix> [options]" << std::endl
+              << "  --duration <s>          length of the sequence (default 2)" << std::endl
+              << "  --dt <s>                simulation time step (default 1e-4)" << std::endl
+              << "  --threshold <C>         contrast threshold (default 0.15)" << std::endl
+              << "  --sigma <s>             per-pixel threshold mismatch (default 0)" << std::endl
+              << "  --seed <n>              seed of the threshold mismatch (default 0)" << std::endl
+              << "  --amplitude <a0 a1 a2>  sinusoidal trajectory amplitude [rad] (default 0.3 0.3 0.6)" << std::endl
+              << "  --frequency <f0 f1 f2>  sinusoidal trajectory frequency [Hz] (default 0.5 0.4 0.3)" << std::endl
+              << "  --trajectory <file>     read the trajectory from a file (t x y z qx qy qz qw)" << std::endl
+              << "  --format <txt|dat>      event file format (default txt)" << std::endl
+              << "  --threads <n>           worker threads (default: all cores)" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    double duration = 2.0, dt = 1e-4;
+    float threshold = 0.15f, sigma = 0.f;
+    unsigned int seed = 0;
+    int threads = 0;
+    Eigen::Vector3f amplitude(0.3f, 0.3f, 0.6f), frequency(0.5f, 0.4f, 0.3f);
+    std::string trajectory_file, format = "txt";
+    for (int i = 4; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--duration" && has_value)
+            duration = atof(argv[++i]);
+        else if (arg == "--dt" && has_value)
+            dt = atof(argv[++i]);
+        else if (arg == "--threshold" && has_value)
+            threshold = atof(argv[++i]);
+        else if (arg == "--sigma" && has_value)
+            sigma = atof(argv[++i]);
+        else if (arg == "--seed" && has_value)
+            seed = atoi(argv[++i]);
+        else if (arg == "--threads" && has_value)
+            threads = atoi(argv[++i]);
+        else if (arg == "--format" && has_value)
+            format = argv[++i];
+        else if (arg == "--trajectory" && has_value)
+            trajectory_file = argv[++i];
+        else if ((arg == "--amplitude" || arg == "--frequency") && i + 3 < argc)
+        {
+            Eigen::Vector3f &v = arg == "--amplitude" ? amplitude : frequency;
+            for (int k = 0; k < 3; k++)
+                v(k) = atof(argv[++i]);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Parameters parameters;
+    parameters.readFromfile(argv[1]);
+
+    Panorama panorama;
+    if (!loadPanorama(argv[2], panorama))
+    {
+        std::cerr << "could not read panorama " << argv[2] << std::endl;
+        return 1;
+    }
+
+    SinusoidalTrajectory sinusoidal(amplitude, frequency);
+    SampledTrajectory from_file;
+    if (!trajectory_file.empty() && !from_file.load(trajectory_file))
+    {
+        std::cerr << "could not read trajectory " << trajectory_file << std::endl;
+        return 1;
+    }
+    const RotationTrajectory &trajectory = trajectory_file.empty() ? (const RotationTrajectory &)sinusoidal : from_file;
+
+    std::string prefix = argv[3];
+    EventWriter writer(prefix + (format == "dat" ? ".dat" : ".txt"));
+    std::ofstream groundtruth((prefix + "_groundtruth.txt").c_str());
+    if (!writer.good() || !groundtruth.good())
+    {
+        std::cerr << "could not open output files for " << prefix << std::endl;
+        return 1;
+    }
+    groundtruth << "# timestamp tx ty tz qx qy qz qw" << std::endl;
+
+    EventSimulator simulator(parameters, panorama, trajectory, threads);
+    simulator.setTimeStep(dt);
+    simulator.setContrastThreshold(threshold, sigma, seed);
+
+    // simulate in chunks to bound memory for long sequences
+    const double chunk = 0.05;
+    std::vector<Event> events;
+    std::vector<std::pair<double, Eigen::Vector3f> > poses;
+    long total_events = 0;
+    double simulation_time = 0;
+    while (true)
+    {
+        events.clear();
+        poses.clear();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        simulator.simulate(std::min(duration, simulator.time() + chunk), events, &poses);
+        simulation_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (poses.empty())
+            break;
+        writer.write(events);
+        for (size_t i = 0; i < poses.size(); i++)
+        {
+            Eigen::Quaterniond q = poseToQuaternion(poses[i].second);
+            groundtruth << std::fixed << std::setprecision(6) << poses[i].first << " 0 0 0 "
+                        << std::setprecision(9) << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << "\n";
+        }
+        total_events += events.size();
+    }
+
+    std::cout << "generated " << total_events << " events over " << duration << "s ("
+              << total_events / std::max(simulation_time, 1e-9) * 1e-6 << " Mev/s simulation rate)" << std::endl;
+    return 0;
+}
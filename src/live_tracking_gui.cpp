@@ -17,6 +17,9 @@
 
 // system includes
 #include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
 #include <QApplication>
 #include <QVBoxLayout>
 #include "iu/iugui.h"
@@ -26,6 +29,12 @@
 #include "scopedtimer.h"
 #include "trackingmainwindow.h"
 #include "common.h"
+#include "metrics.h"
+#include "tracing.h"
+#include "eventsource.h"
+#include "eventsimulator.h"
+#include "recorder.h"
+#include "autotuner.h"
 
 int main(int argc, char **argv)
 {
@@ -45,9 +54,164 @@ int main(int argc, char **argv)
     //    if (numDevices > 1)
     //        deviceNumber = 1;
 
+    // optional metrics endpoint: --metrics <port | host:port | unix:path>
+    // and timeline of the pipeline: --trace <file.json>
+    MetricsServer metrics_server;
+    std::string trace_file, pose_file, video_file, autosave_prefix, resume_file, map_file, checkpoint_file;
+    double video_fps = 30, autosave_interval = 10;
+    // replay of loaded files: --replay-speed <x> (0: as fast as possible),
+    // --loop, --seek <s>; --synthetic <s> simulates input instead of the camera
+    double replay_speed = 0, seek = 0, synthetic_duration = 0;
+    bool loop = false;
+    // raw capture of the camera: --record <prefix>, rotated after
+    // --record-size <MB> (default 1024) or --record-time <s>
+    std::string record_prefix;
+    double record_size = 1024, record_time = 0;
+    // packet size and iterations adapted to --autotune <latency ms>, within
+    // --autotune-packets <min,max> and --autotune-iterations <min,max>;
+    // --autotune-rate <Mev/s> to sustain, decisions to --autotune-log <file>
+    AutoTunerSettings autotune = defaultAutoTunerSettings();
+    bool autotune_enabled = false;
+    std::string autotune_log;
+    // tracking counts as lost below --lost-quality <q> (0: no relocalization)
+    float lost_quality = 0.1f;
+    // poses for local processes in shared memory: --shm <name>, with
+    // --shm-map <width> snapshots every --shm-map-interval <s>
+    std::string shm_name;
+    int shm_map_width = 0;
+    double shm_map_interval = 1;
+    for (int i = 2; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--loop")
+            loop = true;
+        else if (i + 1 == argc)
+            break;
+        else if (std::string(argv[i]) == "--metrics")
+        {
+            if (metrics_server.start(argv[i + 1]))
+                std::cout << "serving metrics on " << argv[i + 1] << std::endl;
+            else
+                std::cerr << "could not serve metrics on " << argv[i + 1] << std::endl;
+        }
+        else if (std::string(argv[i]) == "--trace")
+            trace_file = argv[i + 1];
+        else if (std::string(argv[i]) == "--poses")
+            pose_file = argv[i + 1];
+        else if (std::string(argv[i]) == "--video")
+            video_file = argv[i + 1];
+        else if (std::string(argv[i]) == "--video-fps")
+            video_fps = atof(argv[i + 1]);
+        else if (std::string(argv[i]) == "--autosave")
+            autosave_prefix = argv[i + 1];
+        else if (std::string(argv[i]) == "--autosave-interval")
+            autosave_interval = atof(argv[i + 1]);
+        else if (std::string(argv[i]) == "--resume")
+            resume_file = argv[i + 1];
+        else if (std::string(argv[i]) == "--map")
+            map_file = argv[i + 1];
+        else if (std::string(argv[i]) == "--checkpoint")
+            checkpoint_file = argv[i + 1];
+        else if (std::string(argv[i]) == "--replay-speed")
+            replay_speed = atof(argv[i + 1]);
+        else if (std::string(argv[i]) == "--seek")
+            seek = atof(argv[i + 1]);
+        else if (std::string(argv[i]) == "--synthetic")
+            synthetic_duration = atof(argv[i + 1]);
+        else if (std::string(argv[i]) == "--record")
+            record_prefix = argv[i + 1];
+        else if (std::string(argv[i]) == "--record-size")
+            record_size = atof(argv[i + 1]);
+        else if (std::string(argv[i]) == "--record-time")
+            record_time = atof(argv[i + 1]);
+        else if (std::string(argv[i]) == "--autotune")
+        {
+            autotune.target_latency = atof(argv[i + 1]) * 1e-3;
+            autotune_enabled = true;
+        }
+        else if (std::string(argv[i]) == "--autotune-rate")
+            autotune.target_rate = atof(argv[i + 1]) * 1e6;
+        else if (std::string(argv[i]) == "--autotune-packets")
+            sscanf(argv[i + 1], "%d,%d", &autotune.min_packet, &autotune.max_packet);
+        else if (std::string(argv[i]) == "--autotune-iterations")
+            sscanf(argv[i + 1], "%d,%d", &autotune.min_iterations, &autotune.max_iterations);
+        else if (std::string(argv[i]) == "--autotune-log")
+            autotune_log = argv[i + 1];
+        else if (std::string(argv[i]) == "--lost-quality")
+            lost_quality = atof(argv[i + 1]);
+        else if (std::string(argv[i]) == "--shm")
+            shm_name = argv[i + 1];
+        else if (std::string(argv[i]) == "--shm-map")
+            shm_map_width = atoi(argv[i + 1]);
+        else if (std::string(argv[i]) == "--shm-map-interval")
+            shm_map_interval = atof(argv[i + 1]);
+    }
+    if (!trace_file.empty())
+    {
+        Tracer::start(trace_file);
+        Tracer::setThreadName("gui");
+    }
+
+    // simulated camera in a procedural scene, same trajectory as generate_synthetic_events;
+    // declared before the window, which reads it until it is destroyed
+    Panorama panorama;
+    SinusoidalTrajectory trajectory(Eigen::Vector3f(0.3f, 0.3f, 0.6f), Eigen::Vector3f(0.5f, 0.4f, 0.3f));
+    std::unique_ptr<EventSimulator> simulator;
+    std::unique_ptr<SyntheticEventSource> synthetic;
+    if (synthetic_duration > 0)
+    {
+        Parameters parameters;
+        parameters.readFromfile(argv[1]);
+        proceduralPanorama(2048, 1024, panorama);
+        simulator.reset(new EventSimulator(parameters, panorama, trajectory));
+        synthetic.reset(new SyntheticEventSource(*simulator, synthetic_duration));
+    }
+
+    EventRecorder recorder;
+    if (!record_prefix.empty() && !recorder.open(record_prefix, record_size * (1 << 20), record_time))
+        std::cerr << "could not record to " << record_prefix << std::endl;
+
     QApplication app(argc, argv);
-    TrackingMainWindow window(argv[1], deviceNumber);
-    window.show();
+    int result;
+    { // the window stops the camera and workers when it is destroyed
+        TrackingMainWindow window(argv[1], deviceNumber);
+        if (!pose_file.empty()) // instead of <pose_output_dir>/output_pose/estimated_pose_rpg.txt
+            window.setPoseOutput(pose_file);
+        window.setVideoOutput(video_file, video_fps);
+        window.setAutosave(autosave_prefix, autosave_interval);
+        if (!resume_file.empty())
+            window.setResume(resume_file, true);
+        else if (!map_file.empty()) // known environment, pose starts at zero
+            window.setResume(map_file, false);
+        window.setCheckpointOutput(checkpoint_file);
+        if (autotune_enabled)
+            window.setAutoTuning(autotune, autotune_log);
+        window.setRelocalization(lost_quality > 0, lost_quality);
+        if (!shm_name.empty() && !window.setSharedMemoryOutput(shm_name, shm_map_width, shm_map_interval))
+            std::cerr << "could not create shared memory " << shm_name << std::endl;
+        window.setReplay(replay_speed, loop, seek);
+        window.setEventSource(synthetic.get());
+        if (recorder.isOpen())
+            window.setRecorder(&recorder);
+        window.show();
 
-    return app.exec();
+        result = app.exec();
+    }
+    if (recorder.isOpen())
+    {
+        recorder.close();
+        std::cout << "recorded " << recorder.bytesWritten() << " bytes to " << record_prefix << "_*.aedat";
+        if (recorder.droppedPackets() > 0)
+            std::cout << ", dropped " << recorder.droppedPackets() << " packets";
+        std::cout << std::endl;
+        if (recorder.failed())
+            std::cerr << "writing the recording failed" << std::endl;
+    }
+    if (!trace_file.empty())
+    {
+        if (Tracer::stop())
+            std::cout << "trace written to " << trace_file << std::endl;
+        else
+            std::cerr << "could not write trace to " << trace_file << std::endl;
+    }
+    return result;
 }
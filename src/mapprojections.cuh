@@ -0,0 +1,233 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MAPPROJECTIONS_CUH
+#define MAPPROJECTIONS_CUH
+
+#include <cuda_runtime.h>
+#include <cmath>
+
+// Panorama projections are policy classes like the camera models.
+// project() maps a ray in the sphere frame to map pixel coordinates,
+// jacobian() returns the two rows d(u,v)/d(ray) used by the Gauss-Newton step,
+// unproject() maps a map pixel back to a ray and neighbour() returns the map
+// position of p+(dx,dy), continued across the seams of the map.
+
+enum MapProjection
+{
+    MAP_EQUIRECTANGULAR,
+    MAP_CYLINDRICAL,
+    MAP_CUBEMAP
+};
+
+struct MapGeometry
+{
+    float2 pp;      // center of the map
+    float scale;    // upscale factor
+    int width;
+    int height;
+    int face_size;  // edge length of one cube face (cube map only)
+};
+
+#define MAP_PI 3.14159265358979f
+
+// wraps the azimuth of a panorama which spans 2*pi horizontally
+inline __host__ __device__ float2 wrapAzimuth(const MapGeometry &map, float2 p)
+{
+    float period = 2.f * map.scale * map.pp.x;
+    float lo = map.pp.x - 0.5f * period;
+    p.x = lo + fmodf(fmodf(p.x - lo, period) + period, period);
+    return p;
+}
+
+struct EquirectangularProjection
+{
+    static __host__ __device__ float2 project(const MapGeometry &map, float3 pos)
+    {
+        float rho = sqrtf(pos.x * pos.x + pos.y * pos.y + pos.z * pos.z);
+        return make_float2(map.pp.x + map.scale * map.pp.x * atan2f(pos.y, pos.x) / MAP_PI,
+                           map.pp.y + map.scale * (map.pp.y * 2) * asinf(pos.z / rho) / MAP_PI);
+    }
+
+    static __host__ __device__ void jacobian(const MapGeometry &map, float3 pos, float3 &du, float3 &dv)
+    {
+        float r2 = pos.x * pos.x + pos.y * pos.y;
+        float r = sqrtf(r2);
+        float rho2 = r2 + pos.z * pos.z;
+        float ku = map.scale * map.pp.x / MAP_PI;
+        float kv = map.scale * (map.pp.y * 2) / MAP_PI;
+        du = make_float3(-ku * pos.y / r2, ku * pos.x / r2, 0.f);
+        dv = make_float3(-kv * pos.x * pos.z / (r * rho2), -kv * pos.y * pos.z / (r * rho2), kv * r / rho2);
+    }
+
+    static __host__ __device__ float3 unproject(const MapGeometry &map, float2 p)
+    {
+        float az = (p.x - map.pp.x) / (map.scale * map.pp.x) * MAP_PI;
+        float el = (p.y - map.pp.y) / (map.scale * map.pp.y * 2) * MAP_PI;
+        return make_float3(cosf(el) * cosf(az), cosf(el) * sinf(az), sinf(el));
+    }
+
+    static __host__ __device__ float2 neighbour(const MapGeometry &map, float2 p, float dx, float dy)
+    {
+        return wrapAzimuth(map, make_float2(p.x + dx, p.y + dy));
+    }
+};
+
+// Same horizontal resolution as the equirectangular map, elevation is mapped
+// through tan() which keeps straight vertical lines straight.
+struct CylindricalProjection
+{
+    static __host__ __device__ float2 project(const MapGeometry &map, float3 pos)
+    {
+        float r = sqrtf(pos.x * pos.x + pos.y * pos.y);
+        float k = map.scale * map.pp.x / MAP_PI;
+        return make_float2(map.pp.x + k * atan2f(pos.y, pos.x),
+                           map.pp.y + k * pos.z / r);
+    }
+
+    static __host__ __device__ void jacobian(const MapGeometry &map, float3 pos, float3 &du, float3 &dv)
+    {
+        float r2 = pos.x * pos.x + pos.y * pos.y;
+        float r = sqrtf(r2);
+        float k = map.scale * map.pp.x / MAP_PI;
+        du = make_float3(-k * pos.y / r2, k * pos.x / r2, 0.f);
+        dv = make_float3(-k * pos.z * pos.x / (r2 * r), -k * pos.z * pos.y / (r2 * r), k / r);
+    }
+
+    static __host__ __device__ float3 unproject(const MapGeometry &map, float2 p)
+    {
+        float k = map.scale * map.pp.x / MAP_PI;
+        float az = (p.x - map.pp.x) / k;
+        return make_float3(cosf(az), sinf(az), (p.y - map.pp.y) / k);
+    }
+
+    static __host__ __device__ float2 neighbour(const MapGeometry &map, float2 p, float dx, float dy)
+    {
+        return wrapAzimuth(map, make_float2(p.x + dx, p.y + dy));
+    }
+};
+
+// Six faces laid out as a 3x2 atlas: +X -X +Y in the first row, -Y +Z -Z in
+// the second one. Projection is a face selection and one division. Every face
+// is surrounded by a one pixel gutter which holds a copy of the adjacent faces,
+// so bilinear lookups are seamless (see fillCubeGutters_kernel).
+struct CubeMapProjection
+{
+    static __host__ __device__ int pitch(const MapGeometry &map)
+    {
+        return map.face_size + 2;
+    }
+
+    // face-local coordinates (s,t) in [-1,1] and the major axis value
+    static __host__ __device__ int face(float3 pos, float &sc, float &tc, float &ma)
+    {
+        float ax = fabsf(pos.x), ay = fabsf(pos.y), az = fabsf(pos.z);
+        if (ax >= ay && ax >= az)
+        {
+            ma = ax;
+            sc = pos.x > 0 ? -pos.y : pos.y;
+            tc = -pos.z;
+            return pos.x > 0 ? 0 : 1;
+        }
+        else if (ay >= az)
+        {
+            ma = ay;
+            sc = pos.y > 0 ? pos.x : -pos.x;
+            tc = -pos.z;
+            return pos.y > 0 ? 2 : 3;
+        }
+        ma = az;
+        sc = pos.z > 0 ? pos.y : -pos.y;
+        tc = pos.z > 0 ? pos.x : -pos.x;
+        return pos.z > 0 ? 4 : 5;
+    }
+
+    static __host__ __device__ float2 project(const MapGeometry &map, float3 pos)
+    {
+        float sc, tc, ma;
+        int f = face(pos, sc, tc, ma);
+        float half = 0.5f * map.face_size;
+        return make_float2((f % 3) * pitch(map) + half * (sc / ma + 1.f) + 0.5f,
+                           (f / 3) * pitch(map) + half * (tc / ma + 1.f) + 0.5f);
+    }
+
+    // ray through face-local coordinates (s,t), which may lie outside [-1,1]
+    static __host__ __device__ float3 faceRay(int f, float s, float t)
+    {
+        switch (f)
+        {
+        case 0: return make_float3(1.f, -s, -t);
+        case 1: return make_float3(-1.f, s, -t);
+        case 2: return make_float3(s, 1.f, -t);
+        case 3: return make_float3(-s, -1.f, -t);
+        case 4: return make_float3(t, s, 1.f);
+        default: return make_float3(-t, -s, -1.f);
+        }
+    }
+
+    // face of the atlas cell containing p and the face-local coordinates of p+(dx,dy)
+    static __host__ __device__ int faceCoordinates(const MapGeometry &map, float2 p, float dx, float dy, float &s, float &t)
+    {
+        int P = pitch(map);
+        int col = int(floorf((p.x + 0.5f) / P));
+        int row = int(floorf((p.y + 0.5f) / P));
+        col = col < 0 ? 0 : (col > 2 ? 2 : col);
+        row = row < 0 ? 0 : (row > 1 ? 1 : row);
+        s = (p.x + dx - col * P - 0.5f) / (0.5f * map.face_size) - 1.f;
+        t = (p.y + dy - row * P - 0.5f) / (0.5f * map.face_size) - 1.f;
+        return row * 3 + col;
+    }
+
+    static __host__ __device__ float3 unproject(const MapGeometry &map, float2 p)
+    {
+        float s, t;
+        int f = faceCoordinates(map, p, 0.f, 0.f, s, t);
+        return faceRay(f, s, t);
+    }
+
+    static __host__ __device__ float2 neighbour(const MapGeometry &map, float2 p, float dx, float dy)
+    {
+        float s, t;
+        int f = faceCoordinates(map, p, dx, dy, s, t);
+        if (s >= -1.f && s <= 1.f && t >= -1.f && t <= 1.f)
+            return make_float2(p.x + dx, p.y + dy);
+        return project(map, faceRay(f, s, t));
+    }
+
+    static __host__ __device__ void jacobian(const MapGeometry &map, float3 pos, float3 &du, float3 &dv)
+    {
+        float sc, tc, ma;
+        int f = face(pos, sc, tc, ma);
+        float h = 0.5f * map.face_size / ma;
+        // d(sc/ma) = (dsc - sc/ma*dma)/ma, signs follow face()
+        float3 dma, dsc, dtc;
+        switch (f)
+        {
+        case 0: dma = make_float3(1, 0, 0);  dsc = make_float3(0, -1, 0); dtc = make_float3(0, 0, -1); break;
+        case 1: dma = make_float3(-1, 0, 0); dsc = make_float3(0, 1, 0);  dtc = make_float3(0, 0, -1); break;
+        case 2: dma = make_float3(0, 1, 0);  dsc = make_float3(1, 0, 0);  dtc = make_float3(0, 0, -1); break;
+        case 3: dma = make_float3(0, -1, 0); dsc = make_float3(-1, 0, 0); dtc = make_float3(0, 0, -1); break;
+        case 4: dma = make_float3(0, 0, 1);  dsc = make_float3(0, 1, 0);  dtc = make_float3(1, 0, 0);  break;
+        default: dma = make_float3(0, 0, -1); dsc = make_float3(0, -1, 0); dtc = make_float3(-1, 0, 0); break;
+        }
+        float s = sc / ma, t = tc / ma;
+        du = make_float3(h * (dsc.x - s * dma.x), h * (dsc.y - s * dma.y), h * (dsc.z - s * dma.z));
+        dv = make_float3(h * (dtc.x - t * dma.x), h * (dtc.y - t * dma.y), h * (dtc.z - t * dma.z));
+    }
+};
+
+#endif // MAPPROJECTIONS_CUH
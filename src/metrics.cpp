@@ -0,0 +1,303 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "metrics.h"
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "scopedtimer.h"
+
+int metricShard()
+{
+    static std::atomic<int> next_shard(0);
+    static thread_local int shard = next_shard.fetch_add(1) % METRIC_SHARDS;
+    return shard;
+}
+
+MetricCounter::MetricCounter()
+{
+    for (int i = 0; i < METRIC_SHARDS; i++)
+        slots_[i].value = 0;
+}
+
+uint64_t MetricCounter::value() const
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < METRIC_SHARDS; i++)
+        sum += slots_[i].value.load(std::memory_order_relaxed);
+    return sum;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (int s = 0; s < METRIC_SHARDS; s++)
+    {
+        for (int i = 0; i < BUCKETS; i++)
+            shards_[s].counts[i] = 0;
+        shards_[s].sum_nanoseconds = 0;
+    }
+}
+
+int LatencyHistogram::bucket(uint64_t microseconds)
+{
+    if (microseconds < SUB_BUCKETS)
+        return microseconds;
+    int exponent = 63 - __builtin_clzll(microseconds);
+    int sub = (microseconds >> (exponent - 2)) & (SUB_BUCKETS - 1);
+    int index = SUB_BUCKETS * (exponent - 1) + sub;
+    return index < BUCKETS ? index : BUCKETS - 1;
+}
+
+double LatencyHistogram::upperBound(int bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket + 1;
+    int exponent = bucket / SUB_BUCKETS + 1;
+    int sub = bucket % SUB_BUCKETS;
+    return double(SUB_BUCKETS + sub + 1) * double(1ull << (exponent - 2));
+}
+
+void LatencyHistogram::record(double microseconds)
+{
+    if (!(microseconds >= 0))
+        microseconds = 0;
+    Shard &shard = shards_[metricShard()];
+    shard.counts[bucket((uint64_t)microseconds)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum_nanoseconds.fetch_add((uint64_t)(microseconds * 1e3), std::memory_order_relaxed);
+}
+
+void LatencyHistogram::collect(std::vector<uint64_t> &counts, double &sum_microseconds, uint64_t &count) const
+{
+    counts.assign(BUCKETS, 0);
+    uint64_t sum_nanoseconds = 0;
+    count = 0;
+    for (int s = 0; s < METRIC_SHARDS; s++)
+    {
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            uint64_t c = shards_[s].counts[i].load(std::memory_order_relaxed);
+            counts[i] += c;
+            count += c;
+        }
+        sum_nanoseconds += shards_[s].sum_nanoseconds.load(std::memory_order_relaxed);
+    }
+    sum_microseconds = sum_nanoseconds * 1e-3;
+}
+
+ScopedLatency::ScopedLatency(LatencyHistogram &histogram) : histogram_(histogram)
+{
+    start_ = ScopedTimer::getCurrentTime();
+}
+
+ScopedLatency::~ScopedLatency()
+{
+    histogram_.record(ScopedTimer::getCurrentTime() - start_);
+}
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+template <class T>
+static T &findOrAdd(std::deque<T> &entries, const std::string &name, const std::string &help)
+{
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].name == name)
+            return entries[i];
+    entries.emplace_back();
+    entries.back().name = name;
+    entries.back().help = help;
+    return entries.back();
+}
+
+MetricCounter &MetricsRegistry::counter(std::string name, std::string help)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return findOrAdd(counters_, name, help).metric;
+}
+
+MetricGauge &MetricsRegistry::gauge(std::string name, std::string help)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return findOrAdd(gauges_, name, help).metric;
+}
+
+LatencyHistogram &MetricsRegistry::histogram(std::string name, std::string help)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return findOrAdd(histograms_, name, help).metric;
+}
+
+std::string MetricsRegistry::prometheus() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::stringstream out;
+    out.precision(9);
+    for (size_t i = 0; i < counters_.size(); i++)
+    {
+        out << "# HELP " << counters_[i].name << " " << counters_[i].help << "\n"
+            << "# TYPE " << counters_[i].name << " counter\n"
+            << counters_[i].name << " " << counters_[i].metric.value() << "\n";
+    }
+    for (size_t i = 0; i < gauges_.size(); i++)
+    {
+        out << "# HELP " << gauges_[i].name << " " << gauges_[i].help << "\n"
+            << "# TYPE " << gauges_[i].name << " gauge\n"
+            << gauges_[i].name << " " << gauges_[i].metric.value() << "\n";
+    }
+    std::vector<uint64_t> counts;
+    for (size_t i = 0; i < histograms_.size(); i++)
+    {
+        const std::string &name = histograms_[i].name;
+        double sum;
+        uint64_t count;
+        histograms_[i].metric.collect(counts, sum, count);
+        out << "# HELP " << name << " " << histograms_[i].help << "\n"
+            << "# TYPE " << name << " histogram\n";
+        // a fixed set of boundaries up to 100s, larger values only show in +Inf
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LatencyHistogram::BUCKETS && LatencyHistogram::upperBound(b) <= 1e8; b++)
+        {
+            cumulative += counts[b];
+            out << name << "_bucket{le=\"" << LatencyHistogram::upperBound(b) * 1e-6 << "\"} " << cumulative << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << count << "\n"
+            << name << "_sum " << sum * 1e-6 << "\n"
+            << name << "_count " << count << "\n";
+    }
+    return out.str();
+}
+
+MetricsServer::MetricsServer() : socket_(-1), running_(false)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(std::string address)
+{
+    stop();
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (address.size() == 5 || address.size() - 5 >= sizeof(addr.sun_path))
+            return false;
+        unix_path_ = address.substr(5);
+        strcpy(addr.sun_path, unix_path_.c_str());
+        socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(unix_path_.c_str());
+        if (socket_ < 0 || bind(socket_, (sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            stop();
+            return false;
+        }
+    }
+    else
+    {
+        std::string host = "127.0.0.1";
+        size_t colon = address.rfind(':');
+        if (colon != std::string::npos)
+            host = address.substr(0, colon);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(address.c_str() + (colon == std::string::npos ? 0 : colon + 1)));
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+            return false;
+        socket_ = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (socket_ >= 0)
+            setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (socket_ < 0 || bind(socket_, (sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            stop();
+            return false;
+        }
+    }
+    if (listen(socket_, 4) < 0)
+    {
+        stop();
+        return false;
+    }
+    running_ = true;
+    thread_ = std::thread(&MetricsServer::serve, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+    if (socket_ >= 0)
+        close(socket_);
+    socket_ = -1;
+    if (!unix_path_.empty())
+        unlink(unix_path_.c_str());
+    unix_path_.clear();
+}
+
+void MetricsServer::serve()
+{
+    while (running_)
+    {
+        // wake up regularly to notice stop()
+        pollfd fd = {socket_, POLLIN, 0};
+        if (poll(&fd, 1, 200) <= 0)
+            continue;
+        int client = accept(socket_, NULL, NULL);
+        if (client < 0)
+            continue;
+        // the request itself is not interpreted, every GET gets the metrics
+        char request[1024];
+        pollfd client_fd = {client, POLLIN, 0};
+        if (poll(&client_fd, 1, 1000) > 0)
+            recv(client, request, sizeof(request), 0);
+
+        std::string body = MetricsRegistry::instance().prometheus();
+        std::stringstream response;
+        response << "HTTP/1.0 200 OK\r\n"
+                 << "Content-Type: text/plain; version=0.0.4\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+        std::string data = response.str();
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            sent += n;
+        }
+        close(client);
+    }
+}
@@ -0,0 +1,146 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+// Updates go to one of METRIC_SHARDS cache line sized slots picked per thread,
+// so that recording is a relaxed atomic add without contention. Reading sums
+// all shards.
+#define METRIC_SHARDS 8
+
+struct alignas(64) MetricSlot
+{
+    std::atomic<uint64_t> value;
+};
+
+int metricShard(void);
+
+class MetricCounter
+{
+public:
+    MetricCounter();
+    void add(uint64_t n = 1) { slots_[metricShard()].value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value(void) const;
+
+protected:
+    MetricSlot slots_[METRIC_SHARDS];
+};
+
+class MetricGauge
+{
+public:
+    MetricGauge() : value_(0) {}
+    void set(double value) { value_.store(value, std::memory_order_relaxed); }
+    double value(void) const { return value_.load(std::memory_order_relaxed); }
+
+protected:
+    std::atomic<double> value_;
+};
+
+// Log-linear buckets in microseconds as in HDR histograms: exact below 4us,
+// then 4 buckets per power of two (<= 25% relative error) up to ~2 hours.
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKETS = 4;
+    static const int BUCKETS = SUB_BUCKETS * 32;
+
+    LatencyHistogram();
+    void record(double microseconds);
+    static int bucket(uint64_t microseconds);
+    static double upperBound(int bucket); // microseconds, exclusive
+    void collect(std::vector<uint64_t> &counts, double &sum_microseconds, uint64_t &count) const;
+
+protected:
+    struct Shard
+    {
+        std::atomic<uint64_t> counts[BUCKETS];
+        alignas(64) std::atomic<uint64_t> sum_nanoseconds;
+    };
+    Shard shards_[METRIC_SHARDS];
+};
+
+// Measures the time until leaving the scope into a histogram
+class ScopedLatency
+{
+public:
+    ScopedLatency(LatencyHistogram &histogram);
+    ~ScopedLatency();
+
+protected:
+    LatencyHistogram &histogram_;
+    double start_;
+};
+
+// Named metrics of the process. Registration takes a lock, the returned
+// references stay valid and are meant to be looked up once.
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance(void);
+
+    MetricCounter &counter(std::string name, std::string help);
+    MetricGauge &gauge(std::string name, std::string help);
+    LatencyHistogram &histogram(std::string name, std::string help);
+
+    // Prometheus text exposition format, histograms in seconds
+    std::string prometheus(void) const;
+
+protected:
+    template <class T>
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        T metric;
+    };
+    mutable std::mutex mutex_;
+    std::deque<Entry<MetricCounter> > counters_;
+    std::deque<Entry<MetricGauge> > gauges_;
+    std::deque<Entry<LatencyHistogram> > histograms_;
+};
+
+// Serves MetricsRegistry::instance() on GET requests (any path) from a
+// background thread. The address is "<port>", "<host>:<port>" (default
+// host 127.0.0.1) or "unix:<path>".
+class MetricsServer
+{
+public:
+    MetricsServer();
+    ~MetricsServer();
+    bool start(std::string address);
+    void stop(void);
+
+protected:
+    void serve(void);
+
+    int socket_;
+    std::string unix_path_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,87 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MODELS_CUH
+#define MODELS_CUH
+
+#include "cameramodels.cuh"
+#include "mapprojections.cuh"
+
+// Camera and map parameters of one tracker, passed to every kernel launch
+struct TrackingGeometry
+{
+    CameraModel camera_model;
+    CameraGeometry camera;
+    MapProjection map_projection;
+    MapGeometry map;
+};
+
+// Turns the runtime model selection into a call of f(Camera(), Projection()).
+// This happens once per kernel launch / packet, never per event.
+template <class Camera, class F>
+inline void dispatchModelsForCamera(MapProjection projection, F &f)
+{
+    switch (projection)
+    {
+    case MAP_CYLINDRICAL:
+        f(Camera(), CylindricalProjection());
+        break;
+    case MAP_CUBEMAP:
+        f(Camera(), CubeMapProjection());
+        break;
+    default:
+        f(Camera(), EquirectangularProjection());
+        break;
+    }
+}
+
+// projection only, calls f(Projection())
+template <class F>
+inline void dispatchProjection(MapProjection projection, F &f)
+{
+    switch (projection)
+    {
+    case MAP_CYLINDRICAL:
+        f(CylindricalProjection());
+        break;
+    case MAP_CUBEMAP:
+        f(CubeMapProjection());
+        break;
+    default:
+        f(EquirectangularProjection());
+        break;
+    }
+}
+
+template <class F>
+inline void dispatchModels(CameraModel camera, MapProjection projection, F &f)
+{
+    switch (camera)
+    {
+    case CAMERA_PINHOLE:
+        dispatchModelsForCamera<PinholeCamera>(projection, f);
+        break;
+    case CAMERA_EQUIDISTANT:
+        dispatchModelsForCamera<EquidistantCamera>(projection, f);
+        break;
+    default:
+        dispatchModelsForCamera<RadTanCamera>(projection, f);
+        break;
+    }
+}
+
+#endif // MODELS_CUH
@@ -0,0 +1,115 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "packetizer.h"
+#include <cmath>
+#include <algorithm>
+
+Packetizer::Packetizer()
+{
+    policy_ = PACKET_COUNT;
+    count_ = 1500;
+    time_window_ = 0.01;
+    latency_budget_ = 0.02;
+    max_queue_ = 1000000;
+    resetStatistics();
+}
+
+void Packetizer::resetStatistics()
+{
+    lag_ = 0;
+    dropped_ = 0;
+}
+
+void Packetizer::take(std::deque<Event> &queue, std::vector<Event> &packet, size_t n)
+{
+    packet.assign(queue.begin(), queue.begin() + n);
+    queue.erase(queue.begin(), queue.begin() + n);
+}
+
+// Events older than the budget are decimated so that the queue catches up with
+// sensor time; the factor grows with the lag. The hard limit drops the oldest.
+void Packetizer::dropStale(std::deque<Event> &queue, double sensor_now)
+{
+    if (queue.size() > max_queue_)
+    {
+        size_t n = queue.size() - max_queue_;
+        queue.erase(queue.begin(), queue.begin() + n);
+        dropped_ += n;
+    }
+    if (queue.empty() || sensor_now - queue.front().t <= latency_budget_)
+        return;
+
+    size_t stale = 0;
+    while (stale < queue.size() && sensor_now - queue[stale].t > latency_budget_)
+        stale++;
+    int keep_every = (int)std::ceil((sensor_now - queue.front().t) / latency_budget_);
+    size_t kept = 0;
+    for (size_t i = 0; i < stale; i += keep_every)
+        queue[kept++] = queue[i];
+    queue.erase(queue.begin() + kept, queue.begin() + stale);
+    dropped_ += stale - kept;
+}
+
+bool Packetizer::next(std::deque<Event> &queue, std::vector<Event> &packet, double host_now, double clock_offset)
+{
+    if (queue.empty())
+    {
+        lag_ = 0;
+        return false;
+    }
+    double sensor_now = std::isinf(clock_offset) ? queue.back().t : host_now - clock_offset;
+    if (policy_ == PACKET_LATENCY_BUDGET)
+        dropStale(queue, sensor_now);
+    lag_ = std::max(0.0, sensor_now - queue.front().t);
+
+    switch (policy_)
+    {
+    case PACKET_TIME_WINDOW:
+    {
+        double end = queue.front().t + time_window_;
+        // the window is complete if a later event has arrived or sensor time has passed it
+        if (queue.back().t < end && sensor_now < end)
+            return false;
+        size_t n = 0;
+        while (n < queue.size() && queue[n].t < end)
+            n++;
+        take(queue, packet, std::max(n, (size_t)1));
+        return true;
+    }
+    case PACKET_LATENCY_BUDGET:
+        if (queue.size() > count_)
+        {
+            take(queue, packet, count_);
+            return true;
+        }
+        // at low event rates don't wait for a full packet longer than half the budget
+        if (lag_ > 0.5 * latency_budget_ && queue.size() >= std::max(count_ / 10, (size_t)1))
+        {
+            take(queue, packet, queue.size());
+            return true;
+        }
+        return false;
+    default:
+        if (queue.size() > count_)
+        {
+            take(queue, packet, count_);
+            return true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,71 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PACKETIZER_H
+#define PACKETIZER_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "event.h"
+
+enum PacketPolicy
+{
+    PACKET_COUNT,         // fixed number of events
+    PACKET_TIME_WINDOW,   // all events of a fixed sensor time window
+    PACKET_LATENCY_BUDGET // fixed count, but early packets and decimation of stale events to bound the lag
+};
+
+// Cuts the incoming event queue into packets. The caller holds the queue lock.
+class Packetizer
+{
+public:
+    Packetizer();
+
+    void setPolicy(int policy) { policy_ = policy; }
+    void setCount(int count) { count_ = count; }
+    void setTimeWindow(double seconds) { time_window_ = seconds; }
+    void setLatencyBudget(double seconds) { latency_budget_ = seconds; }
+    void setMaxQueue(size_t events) { max_queue_ = events; }
+    int policy(void) const { return policy_; }
+
+    // Moves the next packet from the queue into packet. host_now and
+    // clock_offset (host time - sensor time) are in seconds; an infinite offset
+    // means sensor time is unknown and the newest queued event is used instead.
+    bool next(std::deque<Event> &queue, std::vector<Event> &packet, double host_now, double clock_offset);
+
+    // lag of the oldest queued event behind sensor time, seconds
+    double lag(void) const { return lag_; }
+    long dropped(void) const { return dropped_; }
+    void resetStatistics(void);
+
+protected:
+    void take(std::deque<Event> &queue, std::vector<Event> &packet, size_t n);
+    void dropStale(std::deque<Event> &queue, double sensor_now);
+
+    int policy_;
+    size_t count_;
+    double time_window_;
+    double latency_budget_;
+    size_t max_queue_;
+
+    double lag_;
+    long dropped_;
+};
+
+#endif // PACKETIZER_H
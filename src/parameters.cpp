@@ -17,9 +17,13 @@
 
 #include "parameters.h"
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 
 Parameters::Parameters()
 {
+    camera_model = CAMERA_RADTAN;
+    map_projection = MAP_EQUIRECTANGULAR;
 }
 
 void Parameters::readFromfile(std::string filename)
@@ -40,7 +44,8 @@ void Parameters::readFromfile(std::string filename)
     std::getline(intrinsics_file, intrinsics_file_line);
     std::stringstream(intrinsics_file_line) >> output_size_y;
     std::getline(intrinsics_file, intrinsics_file_line);
-    std::stringstream(intrinsics_file_line) >> distort.k1 >> distort.k2 >> distort.p1 >> distort.p2;
+    distort.k3 = distort.k4 = 0.f;
+    std::stringstream(intrinsics_file_line) >> distort.k1 >> distort.k2 >> distort.p1 >> distort.p2 >> distort.k3 >> distort.k4;
 
     K_caminv = K_cam.inverse();
     // center points
@@ -54,5 +59,56 @@ void Parameters::readFromfile(std::string filename)
     std::stringstream(intrinsics_file_line) >> camera_height;
     std::getline(intrinsics_file, intrinsics_file_line);
     std::stringstream(intrinsics_file_line) >> pose_output_dir;
+
+    // optional: <camera model> <map projection>
+    std::string camera_model_name = "radtan", projection_name = "equirectangular";
+    if (std::getline(intrinsics_file, intrinsics_file_line))
+        std::stringstream(intrinsics_file_line) >> camera_model_name >> projection_name;
     intrinsics_file.close();
+
+    if (camera_model_name == "pinhole")
+        camera_model = CAMERA_PINHOLE;
+    else if (camera_model_name == "equidistant" || camera_model_name == "fisheye")
+        camera_model = CAMERA_EQUIDISTANT;
+    else
+        camera_model = CAMERA_RADTAN;
+
+    if (projection_name == "cylindrical")
+        map_projection = MAP_CYLINDRICAL;
+    else if (projection_name == "cubemap")
+        map_projection = MAP_CUBEMAP;
+    else
+        map_projection = MAP_EQUIRECTANGULAR;
+}
+
+CameraGeometry Parameters::cameraGeometry() const
+{
+    CameraGeometry cam;
+    cam.fx = K_cam(0, 0);
+    cam.fy = K_cam(1, 1);
+    cam.cx = K_cam(0, 2);
+    cam.cy = K_cam(1, 2);
+    cam.distort = distort;
+    return cam;
+}
+
+MapGeometry Parameters::mapGeometry(float scale) const
+{
+    MapGeometry map;
+    map.pp = make_float2(px, py);
+    map.scale = scale;
+    map.width = output_size_x;
+    map.height = output_size_y;
+    map.face_size = std::min(output_size_x / 3, output_size_y / 2) - 2; // minus gutters
+    return map;
+}
+
+TrackingGeometry Parameters::geometry(float scale) const
+{
+    TrackingGeometry geometry;
+    geometry.camera_model = camera_model;
+    geometry.camera = cameraGeometry();
+    geometry.map_projection = map_projection;
+    geometry.map = mapGeometry(scale);
+    return geometry;
 }
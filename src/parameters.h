@@ -22,6 +22,7 @@
 #include <Eigen/Dense>
 
 #include "common.h"
+#include "models.cuh"
 
 
 
@@ -45,6 +46,12 @@ public:
     int camera_height;
     std::string pose_output_dir;
     Distort distort;
+    CameraModel camera_model;
+    MapProjection map_projection;
+
+    CameraGeometry cameraGeometry() const;
+    MapGeometry mapGeometry(float scale) const;
+    TrackingGeometry geometry(float scale) const;
 };
 
 #endif // PARAMETERS_H
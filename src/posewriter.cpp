@@ -0,0 +1,134 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "posewriter.h"
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include "cnpy.h"
+
+PoseFormat poseFormat(const std::string &filename)
+{
+    if (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".npy") == 0)
+        return POSE_FORMAT_NPY;
+    return POSE_FORMAT_TEXT;
+}
+
+PoseWriter::PoseWriter() : format_(POSE_FORMAT_TEXT), closing_(false)
+{
+}
+
+PoseWriter::~PoseWriter()
+{
+    close();
+}
+
+bool PoseWriter::open(std::string filename, PoseFormat format)
+{
+    close();
+    filename_ = filename;
+    format_ = format;
+    npy_rows_.clear();
+    if (format_ == POSE_FORMAT_TEXT)
+    {
+        text_.open(filename_.c_str(), std::ios::trunc);
+        if (!text_.is_open())
+            return false;
+    }
+    else
+    { // fail now rather than when closing
+        std::ofstream test(filename_.c_str(), std::ios::trunc);
+        if (!test.is_open())
+            return false;
+    }
+    closing_ = false;
+    thread_ = std::thread(&PoseWriter::writeLoop, this);
+    return true;
+}
+
+void PoseWriter::close()
+{
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+
+    if (format_ == POSE_FORMAT_TEXT)
+        text_.close();
+    else
+    {
+        const unsigned int shape[] = {(unsigned int)(npy_rows_.size() / 8), 8};
+        cnpy::npy_save(filename_, npy_rows_.data(), shape, 2);
+        npy_rows_.clear();
+    }
+}
+
+void PoseWriter::write(double t, const Eigen::Quaterniond &q)
+{
+    Record record = {{t, 0, 0, 0, q.x(), q.y(), q.z(), q.w()}};
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(record);
+        full = queue_.size() >= BATCH;
+    }
+    if (full)
+        wakeup_.notify_one();
+}
+
+void PoseWriter::writeLoop()
+{
+    std::vector<Record> batch;
+    bool closing = false;
+    while (!closing)
+    {
+        {
+            // small batches are written at least every 100ms
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait_for(lock, std::chrono::milliseconds(100), [this] { return closing_ || queue_.size() >= BATCH; });
+            batch.swap(queue_);
+            closing = closing_;
+        }
+        writeBatch(batch);
+        batch.clear();
+    }
+}
+
+void PoseWriter::writeBatch(const std::vector<Record> &batch)
+{
+    if (batch.empty())
+        return;
+    if (format_ == POSE_FORMAT_NPY)
+    {
+        for (size_t i = 0; i < batch.size(); i++)
+            npy_rows_.insert(npy_rows_.end(), batch[i].values, batch[i].values + 8);
+        return;
+    }
+    std::stringstream lines;
+    lines << std::setprecision(9);
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        const double *v = batch[i].values;
+        lines << v[0] << " " << v[1] << " " << v[2] << " " << v[3] << " " << v[4] << " " << v[5] << " " << v[6] << " " << v[7] << "\n";
+    }
+    text_ << lines.str();
+    text_.flush();
+}
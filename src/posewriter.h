@@ -0,0 +1,86 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef POSEWRITER_H
+#define POSEWRITER_H
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Eigen/Geometry>
+
+enum PoseFormat
+{
+    POSE_FORMAT_TEXT, // "t tx ty tz qx qy qz qw" per line (rpg trajectory evaluation)
+    POSE_FORMAT_NPY   // float64 array of N x 8 with the same columns
+};
+
+// .npy selects POSE_FORMAT_NPY, anything else text
+PoseFormat poseFormat(const std::string &filename);
+
+// Receives one orientation per tracked packet
+class PoseSink
+{
+public:
+    virtual ~PoseSink() {}
+    virtual void write(double t, const Eigen::Quaterniond &q) = 0;
+};
+
+// Queues poses and writes them in batches from a background thread, so the
+// caller never waits for the disk. Text files are appended batch by batch,
+// npy files are written once on close (cnpy can only write whole arrays).
+class PoseWriter : public PoseSink
+{
+public:
+    PoseWriter();
+    ~PoseWriter();
+
+    // Truncates filename and starts the writer thread
+    bool open(std::string filename, PoseFormat format);
+    bool open(std::string filename) { return open(filename, poseFormat(filename)); }
+    // Writes all queued poses and stops the thread
+    void close(void);
+    bool isOpen(void) const { return thread_.joinable(); }
+
+    void write(double t, const Eigen::Quaterniond &q);
+
+protected:
+    struct Record
+    {
+        double values[8];
+    };
+    static const size_t BATCH = 256;
+
+    void writeLoop(void);
+    void writeBatch(const std::vector<Record> &batch);
+
+    std::string filename_;
+    PoseFormat format_;
+    std::ofstream text_;
+    std::vector<double> npy_rows_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::vector<Record> queue_;
+    bool closing_;
+    std::thread thread_;
+};
+
+#endif // POSEWRITER_H
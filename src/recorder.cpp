@@ -0,0 +1,321 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "recorder.h"
+#include "caerpacket.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const size_t page_size = 4096;
+static const int64_t index_interval = 100000; // us
+static const char aedat_header[] = "#!AER-DAT3.1\r\n#Format: RAW\r\n#Source 1: DVS128\r\n#!END-HEADER\r\n";
+
+EventRecorder::EventRecorder()
+    : current_(NULL), closing_(false), dropped_(0), written_(0), failed_(false), fd_(-1), fd_file_(-1), direct_(false), fd_size_(0), index_(NULL)
+{
+}
+
+EventRecorder::~EventRecorder()
+{
+    close();
+}
+
+bool EventRecorder::open(const std::string &prefix, size_t max_bytes, double max_seconds, size_t buffer_size, int buffers)
+{
+    close();
+    index_ = fopen((prefix + ".idx").c_str(), "w");
+    if (!index_)
+        return false;
+    fprintf(index_, "# file offset timestamp_us\n");
+    prefix_ = prefix;
+    max_bytes_ = max_bytes;
+    max_seconds_ = max_seconds;
+    // whole pages, as required by O_DIRECT
+    buffer_size_ = (buffer_size + page_size - 1) / page_size * page_size;
+    buffers_.resize(buffers);
+    for (int i = 0; i < buffers; i++)
+    {
+        void *data = NULL;
+        if (posix_memalign(&data, page_size, buffer_size_) != 0)
+        {
+            buffers_.resize(i);
+            close();
+            return false;
+        }
+        buffers_[i].data = static_cast<char *>(data);
+        free_.push_back(&buffers_[i]);
+    }
+
+    current_ = NULL;
+    file_ = 0;
+    file_started_ = false;
+    file_bytes_ = 0;
+    dropped_ = 0;
+    written_ = 0;
+    failed_ = false;
+    fd_file_ = -1;
+    closing_ = false;
+    thread_ = std::thread(&EventRecorder::writeLoop, this);
+    return true;
+}
+
+void EventRecorder::close()
+{
+    if (thread_.joinable())
+    {
+        if (current_)
+            submit(false);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closing_ = true;
+        }
+        wakeup_.notify_one();
+        thread_.join();
+    }
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+    if (index_)
+        fclose(index_);
+    index_ = NULL;
+    for (size_t i = 0; i < buffers_.size(); i++)
+        free(buffers_[i].data);
+    buffers_.clear();
+    free_.clear();
+    queue_.clear();
+}
+
+void EventRecorder::write(const void *packet)
+{
+    if (!isOpen())
+        return;
+    CaerPacketHeader header;
+    memcpy(&header, packet, sizeof(header));
+    size_t size = caerPacketSize(header);
+    if (size == 0)
+        return;
+    bool stamped = header.event_number > 0;
+    int64_t timestamp = 0;
+    if (stamped)
+    {
+        int32_t ts;
+        memcpy(&ts, static_cast<const char *>(packet) + sizeof(header) + header.event_ts_offset, 4);
+        timestamp = ((int64_t)header.event_ts_overflow << 31) + ts;
+    }
+
+    bool rotate = file_started_ && ((max_bytes_ > 0 && file_bytes_ + size > max_bytes_) ||
+                                    (max_seconds_ > 0 && stamped && timestamp - file_start_ >= max_seconds_ * 1e6));
+    bool new_file = rotate || !file_started_;
+    // the whole packet or nothing, a partial packet would corrupt the file.
+    // A rotation submits the current buffer, its free space does not count.
+    if (!reserve(size + (new_file ? sizeof(aedat_header) - 1 : 0), rotate))
+    {
+        dropped_++;
+        return;
+    }
+    if (rotate)
+    {
+        if (current_)
+            submit(true);
+        file_++;
+        file_started_ = false;
+    }
+    if (!file_started_)
+    {
+        file_bytes_ = 0;
+        append(aedat_header, sizeof(aedat_header) - 1);
+        file_started_ = true;
+        file_start_ = timestamp;
+        last_index_ = std::numeric_limits<int64_t>::min();
+    }
+    if (stamped && (last_index_ == std::numeric_limits<int64_t>::min() || timestamp - last_index_ >= index_interval))
+    {
+        append(NULL, 0); // the entry belongs to the buffer holding the first byte
+        IndexEntry entry = {file_bytes_, timestamp};
+        current_->index.push_back(entry);
+        last_index_ = timestamp;
+    }
+    append(packet, size);
+}
+
+bool EventRecorder::reserve(size_t size, bool new_buffer)
+{
+    size_t available = current_ && !new_buffer ? buffer_size_ - current_->used : 0;
+    if (size <= available)
+        return true;
+    size_t needed = (size - available + buffer_size_ - 1) / buffer_size_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_.size() >= needed;
+}
+
+void EventRecorder::append(const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    do
+    {
+        if (!current_)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            current_ = free_.front(); // checked by reserve
+            free_.pop_front();
+            current_->used = 0;
+            current_->file = file_;
+            current_->last = false;
+            current_->index.clear();
+        }
+        size_t n = std::min(size, buffer_size_ - current_->used);
+        if (n > 0)
+            memcpy(current_->data + current_->used, bytes, n);
+        current_->used += n;
+        bytes += n;
+        size -= n;
+        file_bytes_ += n;
+        if (current_->used == buffer_size_)
+            submit(false);
+    } while (size > 0);
+}
+
+void EventRecorder::submit(bool last)
+{
+    current_->last = last;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(current_);
+    }
+    current_ = NULL;
+    wakeup_.notify_one();
+}
+
+void EventRecorder::writeLoop()
+{
+    while (true)
+    {
+        Buffer *buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait(lock, [this]() { return closing_ || !queue_.empty(); });
+            if (queue_.empty())
+                break;
+            buffer = queue_.front();
+            queue_.pop_front();
+        }
+        writeBuffer(*buffer);
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(buffer);
+    }
+}
+
+void EventRecorder::writeBuffer(Buffer &buffer)
+{
+    if (fd_ < 0 || buffer.file != fd_file_)
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+        std::string filename = recordingFile(prefix_, buffer.file);
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        direct_ = false;
+#ifdef O_DIRECT
+        fd_ = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+        direct_ = fd_ >= 0;
+        if (fd_ < 0 && errno == EINVAL) // e.g. tmpfs
+#endif
+            fd_ = ::open(filename.c_str(), flags, 0644);
+        fd_file_ = buffer.file;
+        fd_size_ = 0;
+        if (fd_ < 0)
+        {
+            failed_ = true;
+            return;
+        }
+    }
+#ifdef O_DIRECT
+    if (direct_ && fd_size_ % page_size != 0)
+    { // only after a partial buffer, which normally ends a file
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+        direct_ = false;
+    }
+#endif
+    // direct writes are whole pages, the padding is cut off again
+    size_t size = direct_ ? (buffer.used + page_size - 1) / page_size * page_size : buffer.used;
+    if (pwrite(fd_, buffer.data, size, fd_size_) != (ssize_t)size || (size != buffer.used && ftruncate(fd_, fd_size_ + buffer.used) != 0))
+        failed_ = true;
+    fd_size_ += buffer.used;
+    written_ += buffer.used;
+
+    for (size_t i = 0; i < buffer.index.size(); i++)
+        fprintf(index_, "%d %zu %lld\n", buffer.file, buffer.index[i].offset, (long long)buffer.index[i].timestamp);
+    fflush(index_);
+    if (buffer.last)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+std::string recordingFile(const std::string &prefix, int file)
+{
+    char number[16];
+    snprintf(number, sizeof(number), "_%04d", file);
+    return prefix + number + ".aedat";
+}
+
+bool loadRecordingIndex(const std::string &prefix, std::vector<RecordingIndexEntry> &entries)
+{
+    std::ifstream file((prefix + ".idx").c_str());
+    if (!file.is_open())
+        return false;
+    entries.clear();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        RecordingIndexEntry entry;
+        long long timestamp;
+        if (fields >> entry.file >> entry.offset >> timestamp)
+        {
+            entry.t = timestamp * 1e-6;
+            entries.push_back(entry);
+        }
+    }
+    return true;
+}
+
+bool findRecordingPosition(const std::vector<RecordingIndexEntry> &entries, double t, RecordingIndexEntry &entry)
+{
+    size_t low = 0, high = entries.size();
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (entries[middle].t <= t)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == 0)
+        return false;
+    entry = entries[low - 1];
+    return true;
+}
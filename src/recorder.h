@@ -0,0 +1,125 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+
+// Appends raw libcaer packets to AEDAT 3 files (<prefix>_0000.aedat, ...)
+// from a writer thread. Packets are copied once into a pool of page aligned
+// buffers that are written whole with O_DIRECT where the file system allows
+// it. Files are rotated at packet boundaries after max_bytes or max_seconds
+// of sensor time; <prefix>.idx maps sensor time to file and offset. If the
+// disk falls behind until the pool is exhausted, packets are dropped (and
+// counted) instead of blocking the camera.
+class EventRecorder
+{
+public:
+    EventRecorder();
+    ~EventRecorder();
+
+    // max_bytes / max_seconds 0: no rotation
+    bool open(const std::string &prefix, size_t max_bytes = (size_t)1 << 30, double max_seconds = 0,
+              size_t buffer_size = 4 << 20, int buffers = 32);
+    void close(void);
+    bool isOpen(void) const { return thread_.joinable(); }
+
+    // Header and events of one packet. Single producer.
+    void write(const void *packet);
+
+    long droppedPackets(void) const { return dropped_; }
+    size_t bytesWritten(void) const { return written_; }
+    bool failed(void) const { return failed_; } // a write failed
+
+protected:
+    struct IndexEntry
+    {
+        size_t offset; // in the file
+        int64_t timestamp; // us
+    };
+    struct Buffer
+    {
+        char *data;
+        size_t used;
+        int file;
+        bool last; // of its file
+        std::vector<IndexEntry> index;
+    };
+
+    // free space for size bytes, in new buffers only if new_buffer
+    bool reserve(size_t size, bool new_buffer);
+    void append(const void *data, size_t size);
+    void submit(bool last);
+    void writeLoop(void);
+    void writeBuffer(Buffer &buffer);
+
+    std::string prefix_;
+    size_t max_bytes_;
+    double max_seconds_;
+    size_t buffer_size_;
+    std::vector<Buffer> buffers_;
+
+    // producer
+    Buffer *current_;
+    int file_;
+    bool file_started_;
+    size_t file_bytes_;
+    int64_t file_start_;
+    int64_t last_index_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<Buffer *> free_;
+    std::deque<Buffer *> queue_;
+    bool closing_;
+    std::thread thread_;
+    std::atomic<long> dropped_;
+    std::atomic<size_t> written_;
+    std::atomic<bool> failed_;
+
+    // writer
+    int fd_;
+    int fd_file_;
+    bool direct_;
+    size_t fd_size_;
+    FILE *index_;
+};
+
+// Entry of <prefix>.idx
+struct RecordingIndexEntry
+{
+    int file;
+    size_t offset;
+    double t; // seconds
+};
+
+std::string recordingFile(const std::string &prefix, int file);
+bool loadRecordingIndex(const std::string &prefix, std::vector<RecordingIndexEntry> &entries);
+// Last entry at or before t, false if t is before the recording
+bool findRecordingPosition(const std::vector<RecordingIndexEntry> &entries, double t, RecordingIndexEntry &entry);
+
+#endif // RECORDER_H
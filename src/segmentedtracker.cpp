@@ -0,0 +1,197 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "segmentedtracker.h"
+#include "common.h"
+#include "direct.cuh"
+#include "evaluation.h"
+#include "tracker.h"
+#include "trackerpool.h"
+#include "iu/iumath.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <cuda_runtime.h>
+
+SegmentedTrackingSettings defaultSegmentedTrackingSettings()
+{
+    SegmentedTrackingSettings settings;
+    settings.segment_length = 0;
+    settings.overlap = 1.0;
+    settings.threads = 0;
+    settings.events_per_image = 1500;
+    settings.iterations = 10;
+    settings.upscale = 1.f;
+    return settings;
+}
+
+// A segment being tracked; the local poses are written by the pool thread
+struct SegmentedTracker::Run
+{
+    std::unique_ptr<Tracker> tracker;
+    int stream;
+    SampledTrajectory estimate;
+    std::vector<float> quality; // per pose of estimate
+};
+
+SegmentedTracker::SegmentedTracker(const Parameters &parameters, const SegmentedTrackingSettings &settings, int device_number)
+{
+    parameters_ = parameters;
+    settings_ = settings;
+    device_number_ = device_number;
+    CudaSafeCall(cudaSetDevice(device_number_));
+    panorama_ = new iu::ImageGpu_32f_C1(parameters.output_size_x, parameters.output_size_y);
+    peak_device_memory_ = 0;
+}
+
+SegmentedTracker::~SegmentedTracker()
+{
+    delete panorama_;
+}
+
+static bool earlierThan(const Event &event, double t)
+{
+    return event.t < t;
+}
+
+void SegmentedTracker::run(const Event *events, size_t count)
+{
+    segments_.clear();
+    trajectory_ = SampledTrajectory();
+    previous_ = SampledTrajectory();
+    iu::math::fill(*panorama_, 0.f);
+    peak_device_memory_ = 0;
+    if (count == 0)
+        return;
+
+    TrackerPool pool(settings_.threads, device_number_);
+    size_t free_start, free_now, total;
+    CudaSafeCall(cudaMemGetInfo(&free_start, &total));
+    double begin = events[0].t;
+    double end = events[count - 1].t;
+    double length = settings_.segment_length > 0 ? settings_.segment_length : (end - begin) / pool.threads();
+    int n = settings_.segment_length > 0 ? std::max(1, (int)std::ceil((end - begin) / length)) : pool.threads();
+    for (int k = 0; k < n; k++)
+    {
+        TrackingSegment segment;
+        segment.part_start = begin + k * length;
+        segment.start = k > 0 ? std::max(begin, segment.part_start - settings_.overlap) : begin;
+        segment.end = k + 1 < n ? begin + (k + 1) * length : end;
+        segment.events = 0;
+        segment.poses = 0;
+        segment.quality = 0;
+        segment.alignment = Eigen::Quaterniond::Identity();
+        segment.overlap_poses = 0;
+        segment.residual = -1;
+        segments_.push_back(segment);
+    }
+
+    for (int wave = 0; wave < n; wave += pool.threads())
+    {
+        std::vector<std::unique_ptr<Run> > runs;
+        for (int k = wave; k < n && k < wave + pool.threads(); k++)
+        {
+            TrackingSegment &segment = segments_[k];
+            const Event *first = std::lower_bound(events, events + count, segment.start, earlierThan);
+            const Event *last = k + 1 < n ? std::lower_bound(first, events + count, segment.end, earlierThan) : events + count;
+            segment.events = last - first;
+
+            runs.push_back(std::unique_ptr<Run>(new Run));
+            Run *run = runs.back().get();
+            run->tracker.reset(new Tracker(parameters_, device_number_, settings_.upscale));
+            run->tracker->setEventsPerImage(settings_.events_per_image);
+            run->tracker->setIterations(settings_.iterations);
+            run->stream = pool.addStream(run->tracker.get(), [run](int, const TrackingResult &result) {
+                if (result.pose_updated)
+                {
+                    run->estimate.add(result.t, poseToQuaternion(result.pose));
+                    run->quality.push_back(result.quality);
+                }
+            });
+            pool.addEventsInPlace(run->stream, first, last - first);
+            pool.flush(run->stream);
+        }
+        pool.waitAll();
+        // the last map updates ran on the streams of the pool threads
+        CudaSafeCall(cudaDeviceSynchronize());
+        CudaSafeCall(cudaMemGetInfo(&free_now, &total));
+        peak_device_memory_ = std::max(peak_device_memory_, free_start > free_now ? free_start - free_now : 0);
+        // in order, every segment is aligned to the one before
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            finishSegment(wave + i, *runs[i]);
+            pool.removeStream(runs[i]->stream);
+        }
+        runs.clear(); // frees the trackers and maps of the wave
+    }
+}
+
+void SegmentedTracker::finishSegment(size_t index, Run &run)
+{
+    TrackingSegment &segment = segments_[index];
+    const SampledTrajectory &local = run.estimate;
+    if (index > 0)
+    {
+        // pose pairs of the overlap, the previous segment already in the global frame
+        const TrackingSegment &before = segments_[index - 1];
+        std::vector<Eigen::Quaterniond> global, overlap;
+        for (size_t i = 0; i < local.size() && local.time(i) < segment.part_start; i++)
+        {
+            if (previous_.empty() || local.time(i) < previous_.time(0) || local.time(i) > previous_.time(previous_.size() - 1))
+                continue;
+            global.push_back(before.alignment * previous_.rotation(local.time(i)));
+            overlap.push_back(local.rotation(i));
+        }
+        segment.overlap_poses = global.size();
+        if (!global.empty())
+        {
+            segment.alignment = alignRotations(global, overlap);
+            segment.residual = 0;
+            for (size_t i = 0; i < global.size(); i++)
+                segment.residual += rotationAngle(global[i], segment.alignment * overlap[i]) / global.size();
+        }
+        else if (!previous_.empty() && !local.empty())
+        { // no overlap: assume the camera did not move between the last and the first pose
+            segment.alignment = before.alignment * previous_.rotation(previous_.size() - 1) * local.rotation((size_t)0).conjugate();
+        }
+        else
+            segment.alignment = before.alignment;
+    }
+
+    bool last = index + 1 == segments_.size();
+    for (size_t i = 0; i < local.size(); i++)
+    {
+        double t = local.time(i);
+        if (t < segment.part_start || (t >= segment.end && !last))
+            continue;
+        trajectory_.add(t, segment.alignment * local.rotation(i));
+        segment.quality += run.quality[i];
+        segment.poses++;
+    }
+    if (segment.poses > 0)
+        segment.quality /= segment.poses;
+
+    Eigen::Vector3f rotation = quaternionToPose(segment.alignment);
+    cuda::fuseEquirectangular(run.tracker->geometry(), panorama_, run.tracker->map(), make_float3(rotation(0), rotation(1), rotation(2)));
+    previous_ = local;
+}
+
+void SegmentedTracker::savePanorama(std::string filename)
+{
+    saveState(filename, panorama_, true, true, false);
+}
@@ -0,0 +1,102 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SEGMENTEDTRACKER_H
+#define SEGMENTEDTRACKER_H
+
+#include <string>
+#include <vector>
+#include <Eigen/Geometry>
+
+#include "iu/iucore.h"
+#include "event.h"
+#include "parameters.h"
+#include "eventsimulator.h"
+
+// How SegmentedTracker splits a recording
+struct SegmentedTrackingSettings
+{
+    double segment_length; // sensor time per segment in seconds, <= 0: one segment per thread
+    double overlap;        // seconds a segment is tracked before its part of the trajectory
+    int threads;           // <= 0: one per core
+    int events_per_image;
+    int iterations;
+    float upscale;
+};
+
+SegmentedTrackingSettings defaultSegmentedTrackingSettings(void);
+
+// One segment of the recording and how it was joined to the previous one
+struct TrackingSegment
+{
+    double start;      // first tracked event, overlap included
+    double part_start; // its poses are used from here on
+    double end;
+    size_t events;
+    int poses;         // in the trajectory
+    float quality;     // mean over these poses
+    Eigen::Quaterniond alignment; // local frame -> frame of the first segment
+    int overlap_poses; // pose pairs the alignment is estimated from
+    double residual;   // mean angle between the aligned poses of the overlap, degrees; < 0 without overlap
+};
+
+// Offline tracking of a long recording on all cores. The recording is cut
+// into segments of sensor time which are tracked concurrently in a
+// TrackerPool, each from an empty map and the zero pose. A segment starts
+// overlap seconds before its part of the trajectory; its rotation to the
+// previous segment is the chordal mean over the pose pairs of the overlap,
+// which chains all segments into the frame of the first one. The maps are
+// rotated into one equirectangular panorama, keeping the maximum. Segments
+// are tracked in waves of one per thread; the trackers of a wave are freed
+// before the next one starts, so only that many maps are held.
+class SegmentedTracker
+{
+public:
+    SegmentedTracker(const Parameters &parameters, const SegmentedTrackingSettings &settings, int device_number = 0);
+    ~SegmentedTracker();
+
+    // The events must be sorted by time and are read in place
+    void run(const Event *events, size_t count);
+    void run(const std::vector<Event> &events) { run(events.data(), events.size()); }
+
+    // poses in the frame of the first segment, as written by the tracker
+    const SampledTrajectory &trajectory(void) const { return trajectory_; }
+    const std::vector<TrackingSegment> &segments(void) const { return segments_; }
+    // equirectangular map in the frame of the first segment
+    iu::ImageGpu_32f_C1 *panorama(void) { return panorama_; }
+    // device memory in use by the last run at the end of its busiest wave, bytes
+    size_t peakDeviceMemory(void) const { return peak_device_memory_; }
+    // <filename>.png and <filename>.npy
+    void savePanorama(std::string filename);
+
+protected:
+    struct Run;
+
+    void finishSegment(size_t index, Run &run);
+
+    Parameters parameters_;
+    SegmentedTrackingSettings settings_;
+    int device_number_;
+    SampledTrajectory trajectory_;
+    SampledTrajectory previous_; // local poses of the previous segment
+    std::vector<TrackingSegment> segments_;
+    iu::ImageGpu_32f_C1 *panorama_;
+    size_t peak_device_memory_;
+};
+
+#endif // SEGMENTEDTRACKER_H
@@ -0,0 +1,140 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+/* Follows the poses published by live_tracking_gui --shm and reports the
+ * latency from publication to reading. Example consumer of dvsshm.h. */
+
+#include "dvsshm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double monotonicTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [name] [--count <n>] [--quiet] [--map <file.pgm>]\n", name);
+    printf("  name          shared memory object (default %s)\n", DVS_SHM_DEFAULT_NAME);
+    printf("  --count <n>   stop after n poses (default: until the writer stops)\n");
+    printf("  --quiet       print only the summary\n");
+    printf("  --map <file>  write the newest map snapshot at the end\n");
+}
+
+static int writeMap(dvs_shm_reader *reader, const char *filename)
+{
+    const struct dvs_shm_header *header = dvs_shm_get_header(reader);
+    struct dvs_shm_map map;
+    uint8_t *pixels = (uint8_t *)malloc((size_t)header->map_width * header->map_height);
+    int ok = dvs_shm_latest_map(reader, &map, pixels) == 1;
+    if (ok)
+    {
+        FILE *file = fopen(filename, "wb");
+        ok = file != NULL;
+        if (file)
+        {
+            fprintf(file, "P5\n%u %u\n255\n", map.width, map.height);
+            ok = fwrite(pixels, 1, (size_t)map.width * map.height, file) == (size_t)map.width * map.height;
+            fclose(file);
+        }
+        if (ok)
+            printf("map %llu at t %.3fs written to %s\n", (unsigned long long)map.sequence, map.t, filename);
+    }
+    free(pixels);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = DVS_SHM_DEFAULT_NAME;
+    const char *map_file = NULL;
+    long count = -1;
+    int quiet = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            count = atol(argv[++i]);
+        else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+            map_file = argv[++i];
+        else if (strcmp(argv[i], "--quiet") == 0)
+            quiet = 1;
+        else if (argv[i][0] != '-')
+            name = argv[i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    dvs_shm_reader *reader = dvs_shm_open(name);
+    if (!reader)
+    {
+        fprintf(stderr, "could not open %s, is the tracker publishing?\n", name);
+        return 1;
+    }
+
+    /* from the newest pose on, every pose in order */
+    uint64_t next = dvs_shm_poses_written(reader);
+    long received = 0, missed = 0;
+    double latency_sum = 0, latency_max = 0, latency_min = 1e9;
+    struct dvs_shm_pose pose;
+    struct timespec pause = {0, 20000};
+    while (count < 0 || received < count)
+    {
+        int result = dvs_shm_read_pose(reader, next, &pose);
+        if (result == 1)
+        {
+            double latency = monotonicTime() - pose.published;
+            latency_sum += latency;
+            latency_min = latency < latency_min ? latency : latency_min;
+            latency_max = latency > latency_max ? latency : latency_max;
+            if (!quiet)
+                printf("%llu %.6f %f %f %f %f quality %.3f%s%s latency %.1fus\n", (unsigned long long)pose.sequence, pose.t,
+                       pose.quaternion[0], pose.quaternion[1], pose.quaternion[2], pose.quaternion[3], pose.quality,
+                       pose.flags & DVS_SHM_POSE_LOST ? " lost" : "", pose.flags & DVS_SHM_POSE_RELOCALIZED ? " relocalized" : "",
+                       latency * 1e6);
+            received++;
+            next++;
+        }
+        else if (result < 0)
+        { /* too slow, the ring wrapped: continue with the newest pose */
+            uint64_t newest = dvs_shm_poses_written(reader) - 1;
+            missed += newest - next;
+            next = newest;
+        }
+        else if (dvs_shm_writer_closed(reader))
+            break;
+        else
+            nanosleep(&pause, NULL);
+    }
+
+    printf("%ld poses", received);
+    if (received > 0)
+        printf(", latency mean %.1fus min %.1fus max %.1fus", latency_sum / received * 1e6, latency_min * 1e6, latency_max * 1e6);
+    printf(", %ld missed\n", missed);
+    if (map_file && !writeMap(reader, map_file))
+        fprintf(stderr, "no map snapshot to write to %s\n", map_file);
+    dvs_shm_close(reader);
+    return 0;
+}
@@ -0,0 +1,178 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "shmpublisher.h"
+#include "direct.cuh"
+#include "eventsimulator.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static double monotonicTime()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static size_t alignTo(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+ShmPublisher::ShmPublisher()
+{
+    base_ = NULL;
+    size_ = 0;
+    header_ = NULL;
+    poses_ = 0;
+    maps_ = 0;
+    map_gpu_ = NULL;
+}
+
+ShmPublisher::~ShmPublisher()
+{
+    close();
+}
+
+bool ShmPublisher::open(const std::string &name, int pose_capacity, int map_width, int map_slots)
+{
+    close();
+    // readers of an earlier object keep their mapping
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        return false;
+
+    int map_height = map_width / 2;
+    if (map_width <= 0)
+        map_slots = 0;
+    size_t pose_offset = alignTo(sizeof(dvs_shm_header), 128);
+    size_t map_offset = pose_offset + (size_t)pose_capacity * sizeof(dvs_shm_pose);
+    size_t map_slot_size = map_slots > 0 ? alignTo(sizeof(dvs_shm_map) + (size_t)map_width * map_height, 64) : 0;
+    size_t size = map_offset + map_slots * map_slot_size;
+
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    name_ = name;
+    base_ = (uint8_t *)base;
+    size_ = size;
+    header_ = (dvs_shm_header *)base_;
+    header_->version = DVS_SHM_VERSION;
+    header_->pose_capacity = pose_capacity;
+    header_->map_slots = map_slots;
+    header_->map_width = map_slots > 0 ? map_width : 0;
+    header_->map_height = map_slots > 0 ? map_height : 0;
+    header_->pose_offset = pose_offset;
+    header_->map_offset = map_offset;
+    header_->map_slot_size = map_slot_size;
+    header_->size = size;
+    header_->writer_pid = getpid();
+    // the object is valid for readers once the magic is set
+    __atomic_store_n(&header_->magic, DVS_SHM_MAGIC, __ATOMIC_RELEASE);
+    poses_ = 0;
+    maps_ = 0;
+    if (map_slots > 0)
+    {
+        map_gpu_ = new iu::ImageGpu_32f_C1(map_width, map_height);
+        map_cpu_.resize((size_t)map_width * map_height);
+    }
+    return true;
+}
+
+void ShmPublisher::close()
+{
+    if (!header_)
+        return;
+    __atomic_store_n(&header_->closed, 1u, __ATOMIC_RELEASE);
+    munmap(base_, size_);
+    shm_unlink(name_.c_str());
+    base_ = NULL;
+    header_ = NULL;
+    delete map_gpu_;
+    map_gpu_ = NULL;
+}
+
+void ShmPublisher::publishPose(const TrackingResult &result)
+{
+    if (!header_)
+        return;
+    uint64_t n = poses_++;
+    dvs_shm_pose *slot = (dvs_shm_pose *)(base_ + header_->pose_offset) + n % header_->pose_capacity;
+    __atomic_store_n(&slot->seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    Eigen::Quaterniond q = poseToQuaternion(result.pose);
+    slot->sequence = n;
+    slot->t = result.t;
+    for (int i = 0; i < 3; i++)
+        slot->rotation[i] = result.pose(i);
+    slot->quaternion[0] = q.x();
+    slot->quaternion[1] = q.y();
+    slot->quaternion[2] = q.z();
+    slot->quaternion[3] = q.w();
+    slot->quality = result.quality;
+    slot->flags = (result.lost ? DVS_SHM_POSE_LOST : 0) | (result.relocalized ? DVS_SHM_POSE_RELOCALIZED : 0);
+    slot->published = monotonicTime();
+
+    __atomic_store_n(&slot->seq, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&header_->poses_written, n + 1, __ATOMIC_RELEASE);
+}
+
+void ShmPublisher::publishMap(Tracker &tracker, double t)
+{
+    if (!publishesMaps())
+        return;
+    // downsampled on the GPU, only the small copy is transferred
+    int width = header_->map_width;
+    int height = header_->map_height;
+    cuda::exportEquirectangular(tracker.geometry(), map_gpu_, tracker.map());
+    iu::ImageCpu_32f_C1 map(map_cpu_.data(), width, height, width * sizeof(float), true);
+    iu::copy(map_gpu_, &map);
+
+    uint64_t n = maps_++;
+    uint8_t *slot = base_ + header_->map_offset + (n % header_->map_slots) * header_->map_slot_size;
+    dvs_shm_map *info = (dvs_shm_map *)slot;
+    __atomic_store_n(&info->seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    info->sequence = n;
+    info->t = t;
+    for (int i = 0; i < 3; i++)
+        info->rotation[i] = tracker.pose()(i);
+    info->width = width;
+    info->height = height;
+    uint8_t *pixels = slot + sizeof(dvs_shm_map);
+    for (size_t i = 0; i < map_cpu_.size(); i++)
+        pixels[i] = (uint8_t)(std::min(std::max(map_cpu_[i], 0.f), 1.f) * 255.f + 0.5f);
+    info->published = monotonicTime();
+
+    __atomic_store_n(&info->seq, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&header_->maps_written, n + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,65 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SHMPUBLISHER_H
+#define SHMPUBLISHER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "iu/iucore.h"
+#include "dvsshm.h"
+#include "tracker.h"
+
+// Publishes poses and downsampled map snapshots to processes on the same
+// host through the POSIX shared memory object described in dvsshm.h (read
+// with the C library of dvsshm.c). Publishing never waits for readers; a
+// reader detects a slot being written by its sequence lock and a slot that
+// was reused by the ring position. Times are CLOCK_MONOTONIC.
+class ShmPublisher
+{
+public:
+    ShmPublisher();
+    ~ShmPublisher();
+
+    // Replaces the object name (e.g. "/dvs-tracking"). map_width 0: poses
+    // only, otherwise equirectangular snapshots of map_width x map_width/2
+    bool open(const std::string &name, int pose_capacity = 4096, int map_width = 0, int map_slots = 3);
+    // Marks the object as closed and unlinks it; mapped readers keep it
+    void close(void);
+    bool isOpen(void) const { return header_ != NULL; }
+    bool publishesMaps(void) const { return header_ && header_->map_slots > 0; }
+
+    void publishPose(const TrackingResult &result);
+    // Copy of the map and pose of the tracker at sensor time t, on the thread tracking it
+    void publishMap(Tracker &tracker, double t);
+    uint64_t posesPublished(void) const { return poses_; }
+
+protected:
+    std::string name_;
+    uint8_t *base_;
+    size_t size_;
+    dvs_shm_header *header_;
+    uint64_t poses_;
+    uint64_t maps_;
+    iu::ImageGpu_32f_C1 *map_gpu_;
+    std::vector<float> map_cpu_;
+};
+
+#endif // SHMPUBLISHER_H
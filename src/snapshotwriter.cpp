@@ -0,0 +1,218 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "snapshotwriter.h"
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include "cnpy.h"
+#include "iu/iuio.h"
+
+SnapshotWriter::SnapshotWriter() : y4m_(false), fps_(0), autosave_interval_(0), buffers_(4), threads_(2), width_(0), height_(0),
+                                   next_frame_t_(0), next_autosave_t_(0), frames_(0), dropped_(0), next_write_(0), stopping_(false), video_(NULL)
+{
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    stop();
+}
+
+void SnapshotWriter::setVideo(std::string filename, double fps)
+{
+    video_file_ = filename;
+    fps_ = filename.empty() ? 0 : fps;
+    y4m_ = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".y4m") == 0;
+}
+
+void SnapshotWriter::setAutosave(std::string prefix, double interval)
+{
+    autosave_prefix_ = prefix;
+    autosave_interval_ = prefix.empty() ? 0 : interval;
+}
+
+bool SnapshotWriter::start(int width, int height)
+{
+    stop();
+    if (fps_ <= 0 && autosave_interval_ <= 0)
+        return true;
+    width_ = width;
+    height_ = height;
+    if (fps_ > 0 && y4m_)
+    {
+        video_ = fopen(video_file_.c_str(), "wb");
+        if (!video_)
+            return false;
+        // frame rate as a fraction with millisecond resolution
+        fprintf(video_, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C444\n", width_, height_, (int)std::round(fps_ * 1000));
+    }
+    pool_.clear();
+    free_.clear();
+    for (int i = 0; i < std::max(buffers_, 1); i++)
+    {
+        pool_.push_back(std::unique_ptr<Buffer>(new Buffer));
+        pool_.back()->color.reset(new iu::ImageCpu_8u_C4(width_, height_));
+        free_.push_back(pool_.back().get());
+    }
+    next_frame_t_ = next_autosave_t_ = -INFINITY;
+    frames_ = dropped_ = 0;
+    next_write_ = 0;
+    stopping_ = false;
+    for (int i = 0; i < std::max(threads_, 1); i++)
+        workers_.push_back(std::thread(&SnapshotWriter::encodeLoop, this));
+    return true;
+}
+
+void SnapshotWriter::stop()
+{
+    if (workers_.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++)
+        workers_[i].join();
+    workers_.clear();
+    if (video_)
+        fclose(video_);
+    video_ = NULL;
+}
+
+SnapshotWriter::Buffer *SnapshotWriter::acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.empty())
+    {
+        dropped_++;
+        return NULL;
+    }
+    Buffer *buffer = free_.back();
+    free_.pop_back();
+    return buffer;
+}
+
+void SnapshotWriter::submit(Buffer *buffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(buffer);
+    }
+    work_.notify_one();
+}
+
+void SnapshotWriter::addFrame(double t, const iu::ImageGpu_8u_C4 *color)
+{
+    // a late frame moves the schedule instead of being followed by a burst
+    double period = 1. / fps_;
+    next_frame_t_ = std::isinf(next_frame_t_) || next_frame_t_ + period < t ? t + period : next_frame_t_ + period;
+    Buffer *buffer = acquire();
+    if (!buffer)
+        return;
+    iu::copy(color, buffer->color.get());
+    buffer->autosave = false;
+    buffer->index = frames_++;
+    submit(buffer);
+}
+
+void SnapshotWriter::addAutosave(double t, const iu::ImageGpu_8u_C4 *color, const iu::ImageGpu_32f_C1 *map)
+{
+    next_autosave_t_ = t + autosave_interval_;
+    Buffer *buffer = acquire();
+    if (!buffer)
+        return;
+    if (!buffer->map)
+        buffer->map.reset(new iu::ImageCpu_32f_C1(width_, height_));
+    iu::copy(color, buffer->color.get());
+    iu::copy(map, buffer->map.get());
+    buffer->autosave = true;
+    submit(buffer);
+}
+
+void SnapshotWriter::encodeLoop()
+{
+    std::vector<unsigned char> yuv;
+    while (true)
+    {
+        Buffer *buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            buffer = queue_.front();
+            queue_.pop_front();
+        }
+        if (buffer->autosave)
+            writeAutosave(*buffer);
+        else
+            writeFrame(*buffer, yuv);
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(buffer);
+    }
+}
+
+void SnapshotWriter::writeFrame(Buffer &buffer, std::vector<unsigned char> &yuv)
+{
+    if (!y4m_)
+    {
+        std::stringstream name;
+        name << video_file_ << "_" << std::setfill('0') << std::setw(6) << buffer.index << ".png";
+        iu::imsave(buffer.color.get(), name.str(), true);
+        return;
+    }
+    // full range BT.601, planar Y, U, V
+    size_t plane = (size_t)width_ * height_;
+    yuv.resize(3 * plane);
+    for (int y = 0; y < height_; y++)
+    {
+        const uchar4 *row = buffer.color->data(0, y);
+        for (int x = 0; x < width_; x++)
+        {
+            float r = row[x].x, g = row[x].y, b = row[x].z;
+            size_t i = (size_t)y * width_ + x;
+            yuv[i] = (unsigned char)std::min(0.299f * r + 0.587f * g + 0.114f * b + 0.5f, 255.f);
+            yuv[plane + i] = (unsigned char)std::min(128.f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f, 255.f);
+            yuv[2 * plane + i] = (unsigned char)std::min(128.f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f, 255.f);
+        }
+    }
+    std::unique_lock<std::mutex> lock(write_mutex_);
+    written_.wait(lock, [this, &buffer] { return next_write_ == buffer.index; });
+    fputs("FRAME\n", video_);
+    fwrite(yuv.data(), 1, yuv.size(), video_);
+    next_write_++;
+    written_.notify_all();
+}
+
+void SnapshotWriter::writeAutosave(Buffer &buffer)
+{
+    // written next to the previous autosave and renamed, so a crash never leaves a partial file
+    std::lock_guard<std::mutex> lock(autosave_mutex_);
+    std::vector<float> map((size_t)width_ * height_);
+    for (int y = 0; y < height_; y++)
+        std::copy(buffer.map->data(0, y), buffer.map->data(0, y) + width_, map.begin() + (size_t)y * width_);
+    const unsigned int shape[] = {(unsigned int)height_, (unsigned int)width_};
+    std::string tmp_map = autosave_prefix_ + "_map.tmp.npy", tmp_color = autosave_prefix_ + ".tmp.png";
+    cnpy::npy_save(tmp_map, map.data(), shape, 2);
+    iu::imsave(buffer.color.get(), tmp_color, true);
+    if (rename(tmp_map.c_str(), (autosave_prefix_ + "_map.npy").c_str()) != 0 ||
+        rename(tmp_color.c_str(), (autosave_prefix_ + ".png").c_str()) != 0)
+        std::cerr << "autosave to " << autosave_prefix_ << " failed" << std::endl;
+}
@@ -0,0 +1,108 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNAPSHOTWRITER_H
+#define SNAPSHOTWRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "iu/iucore.h"
+
+// Records the panorama while tracking: a video of the rendered mosaic at a
+// fixed rate of sensor time, and a periodic autosave of mosaic and map.
+// Snapshots are copied into a fixed pool of host buffers and encoded by
+// worker threads. When all buffers are waiting for the encoder the snapshot
+// is dropped, the tracking thread never waits for the disk.
+class SnapshotWriter
+{
+public:
+    SnapshotWriter();
+    ~SnapshotWriter();
+
+    // .y4m: one raw YUV 4:4:4 stream, otherwise <filename>_<frame>.png
+    // files. An empty filename or fps <= 0 disables the video.
+    void setVideo(std::string filename, double fps);
+    // Overwrites <prefix>.png and <prefix>_map.npy every interval seconds
+    void setAutosave(std::string prefix, double interval);
+    void setBuffers(int buffers) { buffers_ = buffers; }
+    void setThreads(int threads) { threads_ = threads; }
+
+    bool start(int width, int height);
+    // Encodes everything queued
+    void stop(void);
+    bool active(void) const { return !workers_.empty(); }
+
+    // t is sensor time in seconds
+    bool frameDue(double t) const { return active() && fps_ > 0 && t >= next_frame_t_; }
+    bool autosaveDue(double t) const { return active() && autosave_interval_ > 0 && t >= next_autosave_t_; }
+    void addFrame(double t, const iu::ImageGpu_8u_C4 *color);
+    void addAutosave(double t, const iu::ImageGpu_8u_C4 *color, const iu::ImageGpu_32f_C1 *map);
+
+    long frames(void) const { return frames_; }
+    long dropped(void) const { return dropped_; }
+
+protected:
+    struct Buffer
+    {
+        bool autosave;
+        long index; // frame number of the video
+        std::unique_ptr<iu::ImageCpu_8u_C4> color;
+        std::unique_ptr<iu::ImageCpu_32f_C1> map;
+    };
+
+    Buffer *acquire(void);
+    void submit(Buffer *buffer);
+    void encodeLoop(void);
+    void writeFrame(Buffer &buffer, std::vector<unsigned char> &yuv);
+    void writeAutosave(Buffer &buffer);
+
+    std::string video_file_;
+    bool y4m_;
+    double fps_;
+    std::string autosave_prefix_;
+    double autosave_interval_;
+    int buffers_;
+    int threads_;
+    int width_, height_;
+
+    double next_frame_t_;
+    double next_autosave_t_;
+    long frames_;
+    long dropped_;
+
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::mutex write_mutex_;
+    std::mutex autosave_mutex_; // one autosave at a time
+    std::condition_variable written_; // video frames are written in order
+    std::vector<std::unique_ptr<Buffer> > pool_;
+    std::vector<Buffer *> free_;
+    std::deque<Buffer *> queue_;
+    long next_write_;
+    bool stopping_;
+    FILE *video_;
+    std::vector<std::thread> workers_;
+};
+
+#endif // SNAPSHOTWRITER_H
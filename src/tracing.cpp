@@ -0,0 +1,191 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tracing.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+struct TraceEvent
+{
+    const char *name;
+    char phase; // 'X' complete, 'i' instant, 's'/'f' flow
+    double ts;
+    double duration;
+    int64_t arg;
+};
+
+// One buffer per thread. The lock is only contended while stop() writes.
+struct ThreadBuffer
+{
+    int tid;
+    std::string name;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    size_t dropped;
+};
+
+struct TraceState
+{
+    std::mutex mutex;
+    std::string filename;
+    size_t max_events;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<std::unique_ptr<ThreadBuffer> > buffers;
+};
+
+static TraceState &state()
+{
+    static TraceState s;
+    return s;
+}
+
+static ThreadBuffer &threadBuffer()
+{
+    static thread_local ThreadBuffer *buffer = NULL;
+    if (!buffer)
+    {
+        TraceState &s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer));
+        buffer = s.buffers.back().get();
+        buffer->tid = s.buffers.size();
+        buffer->dropped = 0;
+    }
+    return *buffer;
+}
+
+static void record(const char *name, char phase, double ts, double duration, int64_t arg)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() >= state().max_events)
+    {
+        buffer.dropped++;
+        return;
+    }
+    TraceEvent event = {name, phase, ts, duration, arg};
+    buffer.events.push_back(event);
+}
+
+std::atomic<bool> Tracer::enabled_(false);
+
+void Tracer::start(std::string filename, size_t max_events_per_thread)
+{
+    TraceState &s = state();
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.filename = filename;
+        s.max_events = max_events_per_thread;
+        s.origin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < s.buffers.size(); i++)
+        {
+            std::lock_guard<std::mutex> buffer_lock(s.buffers[i]->mutex);
+            s.buffers[i]->events.clear();
+            s.buffers[i]->dropped = 0;
+        }
+    }
+    enabled_ = true;
+}
+
+double Tracer::now()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - state().origin).count();
+}
+
+void Tracer::setThreadName(const char *name)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void Tracer::complete(const char *name, double start, double duration, int64_t arg)
+{
+    record(name, 'X', start, duration, arg);
+}
+
+void Tracer::instant(const char *name, int64_t arg)
+{
+    if (enabled())
+        record(name, 'i', now(), 0, arg);
+}
+
+void Tracer::flowBegin(const char *name, int64_t id)
+{
+    if (enabled())
+        record(name, 's', now(), 0, id);
+}
+
+void Tracer::flowEnd(const char *name, int64_t id)
+{
+    if (enabled())
+        record(name, 'f', now(), 0, id);
+}
+
+bool Tracer::stop()
+{
+    if (!enabled_.exchange(false))
+        return false;
+    TraceState &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    std::ofstream file(s.filename.c_str());
+    int pid = getpid();
+    file.precision(3);
+    file << std::fixed << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (size_t b = 0; b < s.buffers.size(); b++)
+    {
+        ThreadBuffer &buffer = *s.buffers[b];
+        std::lock_guard<std::mutex> buffer_lock(buffer.mutex);
+        if (!buffer.name.empty())
+        {
+            file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << buffer.tid
+                 << ", \"args\": {\"name\": \"" << buffer.name << "\"}}";
+            first = false;
+        }
+        for (size_t i = 0; i < buffer.events.size(); i++)
+        {
+            const TraceEvent &e = buffer.events[i];
+            file << (first ? "" : ",\n") << "{\"name\": \"" << e.name << "\", \"ph\": \"" << e.phase << "\", \"pid\": " << pid
+                 << ", \"tid\": " << buffer.tid << ", \"ts\": " << e.ts;
+            if (e.phase == 'X')
+                file << ", \"dur\": " << e.duration;
+            if (e.phase == 'i')
+                file << ", \"s\": \"t\"";
+            if (e.phase == 's' || e.phase == 'f')
+                file << ", \"cat\": \"flow\", \"id\": " << e.arg << (e.phase == 'f' ? ", \"bp\": \"e\"" : "");
+            else if (e.arg >= 0)
+                file << ", \"args\": {\"n\": " << e.arg << "}";
+            file << "}";
+            first = false;
+        }
+        if (buffer.dropped > 0)
+        {
+            file << (first ? "" : ",\n") << "{\"name\": \"trace buffer full\", \"ph\": \"i\", \"s\": \"t\", \"pid\": " << pid
+                 << ", \"tid\": " << buffer.tid << ", \"ts\": " << (buffer.events.empty() ? 0. : buffer.events.back().ts)
+                 << ", \"args\": {\"dropped\": " << buffer.dropped << "}}";
+            first = false;
+        }
+        buffer.events.clear();
+    }
+    file << "\n]}\n";
+    return file.good();
+}
@@ -0,0 +1,74 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+// Timeline of scoped spans per thread, written as Chrome trace-event JSON
+// (chrome://tracing, ui.perfetto.dev). While disabled every span costs one
+// relaxed load; names must be string literals.
+class Tracer
+{
+public:
+    static bool enabled(void) { return enabled_.load(std::memory_order_relaxed); }
+
+    // Starts recording; stop writes everything recorded to filename
+    static void start(std::string filename, size_t max_events_per_thread = 1 << 20);
+    static bool stop(void);
+
+    static void setThreadName(const char *name);
+    static double now(void); // microseconds since start
+
+    static void complete(const char *name, double start, double duration, int64_t arg = -1);
+    static void instant(const char *name, int64_t arg = -1);
+    // arrows between threads, e.g. from a Qt emit to the slot
+    static void flowBegin(const char *name, int64_t id);
+    static void flowEnd(const char *name, int64_t id);
+
+protected:
+    static std::atomic<bool> enabled_;
+};
+
+class TraceSpan
+{
+public:
+    TraceSpan(const char *name, int64_t arg = -1) : name_(name), arg_(arg)
+    {
+        start_ = Tracer::enabled() ? Tracer::now() : -1;
+    }
+    ~TraceSpan()
+    {
+        if (start_ >= 0 && Tracer::enabled())
+            Tracer::complete(name_, start_, Tracer::now() - start_, arg_);
+    }
+    void setArg(int64_t arg) { arg_ = arg; }
+
+protected:
+    const char *name_;
+    int64_t arg_;
+    double start_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+#endif // TRACING_H
@@ -0,0 +1,144 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// system includes
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+#include "event.h"
+#include "parameters.h"
+#include "scopedtimer.h"
+#include "eventsource.h"
+#include "evaluation.h"
+#include "posewriter.h"
+#include "segmentedtracker.h"
+
+static void usage(const char *name)
+{
+    std::cout << "usage: " << name << " <calibration file> <events> [options]" << std::endl
+              << "  tracks overlapping time segments of the recording in parallel and joins them" << std::endl
+              << "  --segment <s>           sensor time per segment (default: one segment per thread)" << std::endl
+              << "  --overlap <s>           time a segment starts before its part, to align it (default 1)" << std::endl
+              << "  --jobs <n>              threads (default: one per core)" << std::endl
+              << "  --packets <n>           events per packet (default 1500)" << std::endl
+              << "  --iterations <n>        optimizer iterations (default 10)" << std::endl
+              << "  --upscale <s>           map upscale (default 1)" << std::endl
+              << "  --poses <file>          global trajectory (default <pose output directory>/output_pose/estimated_pose_rpg.txt)" << std::endl
+              << "  --panorama <prefix>     fused map as <prefix>.png and <prefix>.npy" << std::endl
+              << "  --groundtruth <file>    print the errors of the trajectory" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SegmentedTrackingSettings settings = defaultSegmentedTrackingSettings();
+    std::string pose_file, panorama_file, groundtruth_file;
+    for (int i = 3; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--segment" && has_value)
+            settings.segment_length = atof(argv[++i]);
+        else if (arg == "--overlap" && has_value)
+            settings.overlap = atof(argv[++i]);
+        else if (arg == "--jobs" && has_value)
+            settings.threads = atoi(argv[++i]);
+        else if (arg == "--packets" && has_value)
+            settings.events_per_image = atoi(argv[++i]);
+        else if (arg == "--iterations" && has_value)
+            settings.iterations = atoi(argv[++i]);
+        else if (arg == "--upscale" && has_value)
+            settings.upscale = atof(argv[++i]);
+        else if (arg == "--poses" && has_value)
+            pose_file = argv[++i];
+        else if (arg == "--panorama" && has_value)
+            panorama_file = argv[++i];
+        else if (arg == "--groundtruth" && has_value)
+            groundtruth_file = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Parameters parameters;
+    parameters.readFromfile(argv[1]);
+    if (pose_file.empty() && !parameters.pose_output_dir.empty())
+        pose_file = parameters.pose_output_dir + "/output_pose/estimated_pose_rpg.txt";
+    SampledTrajectory groundtruth;
+    if (!groundtruth_file.empty() && !groundtruth.load(groundtruth_file))
+    {
+        std::cerr << "could not read " << groundtruth_file << std::endl;
+        return 1;
+    }
+
+    std::vector<Event> events;
+    if (!loadRecording(events, argv[2]))
+    {
+        std::cerr << "could not read recording " << argv[2] << std::endl;
+        return 1;
+    }
+
+    SegmentedTracker tracker(parameters, settings);
+    double start = ScopedTimer::getCurrentTime();
+    tracker.run(events);
+    double seconds = (ScopedTimer::getCurrentTime() - start) * 1e-6;
+
+    const std::vector<TrackingSegment> &segments = tracker.segments();
+    std::cout << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        const TrackingSegment &s = segments[i];
+        std::cout << "segment " << i << ": " << s.part_start << "s - " << s.end << "s, " << s.events << " events, " << s.poses
+                  << " poses, quality " << s.quality;
+        if (i > 0 && s.residual >= 0)
+            std::cout << ", aligned on " << s.overlap_poses << " poses, residual " << s.residual << " deg";
+        else if (i > 0)
+            std::cout << ", no overlap, joined at the last pose";
+        std::cout << std::endl;
+    }
+    double duration = events.empty() ? 0 : events.back().t - events.front().t;
+    std::cout << "tracked " << duration << "s of events in " << seconds << "s (" << events.size() / seconds * 1e-6 << " Mev/s)" << std::endl;
+    std::cout << "peak device memory: " << tracker.peakDeviceMemory() / (1 << 20) << " MiB" << std::endl;
+
+    const SampledTrajectory &trajectory = tracker.trajectory();
+    if (!pose_file.empty())
+    {
+        PoseWriter writer;
+        if (!writer.open(pose_file))
+            std::cerr << "could not write " << pose_file << std::endl;
+        for (size_t i = 0; i < trajectory.size() && writer.isOpen(); i++)
+            writer.write(trajectory.time(i), trajectory.rotation(i));
+        writer.close();
+    }
+    if (!panorama_file.empty())
+        tracker.savePanorama(panorama_file);
+    if (!groundtruth.empty())
+    {
+        TrajectoryError e = evaluateTrajectory(trajectory, groundtruth);
+        std::cout << "poses " << e.poses << ", ATE " << e.ate_rmse << " deg (rmse), RPE " << e.rpe_rmse << " deg (rmse)" << std::endl;
+    }
+    return 0;
+}
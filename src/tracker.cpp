@@ -0,0 +1,975 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tracker.h"
+#include "common.cuh"
+#include "common.h"
+#include "direct.cuh"
+#include "iu/iumath.h"
+#include "eigenhelpers.h"
+#include "scopedtimer.h"
+#include "metrics.h"
+#include "tracing.h"
+#include "checkpoint.h"
+#include <algorithm>
+#include <cmath>
+
+// Stage latencies of the tracker, served by MetricsServer
+struct TrackerMetrics
+{
+    MetricCounter &events_out;
+    MetricCounter &events_out_of_map;
+    LatencyHistogram &undistortion;
+    LatencyHistogram &iteration;
+    LatencyHistogram &map_fusion;
+    MetricCounter &relocalizations;
+    LatencyHistogram &relocalization;
+};
+
+static TrackerMetrics &trackerMetrics()
+{
+    MetricsRegistry &r = MetricsRegistry::instance();
+    static TrackerMetrics metrics = {
+        r.counter("dvs_events_out_total", "Events processed by the tracker"),
+        r.counter("dvs_events_out_of_map_total", "Events without an undistorted pixel"),
+        r.histogram("dvs_undistortion_seconds", "Undistortion of a packet"),
+        r.histogram("dvs_optimizer_iteration_seconds", "One optimizer iteration including gradient sampling"),
+        r.histogram("dvs_map_fusion_seconds", "Map update of a packet"),
+        r.counter("dvs_relocalizations_total", "Poses reinitialized by the rotation search after tracking loss"),
+        r.histogram("dvs_relocalization_seconds", "Rotation search of one packet while tracking is lost")};
+    return metrics;
+}
+
+Tracker::Tracker(const Parameters &cam_parameters, int device_number, float upscale)
+{
+    device_number_ = device_number;
+    CudaSafeCall(cudaSetDevice(device_number_));
+    width_ = cam_parameters.camera_width;
+    height_ = cam_parameters.camera_height;
+    output_ = new iu::ImageGpu_32f_C1(cam_parameters.output_size_x, cam_parameters.output_size_y);
+    occurences_ = new iu::ImageGpu_32f_C1(cam_parameters.output_size_x, cam_parameters.output_size_y);
+    normalization_ = new iu::ImageGpu_32f_C1(cam_parameters.output_size_x, cam_parameters.output_size_y);
+
+    iu::math::fill(*occurences_, 0.f);
+    iu::math::fill(*normalization_, 1.f);
+    iu::math::fill(*output_, 0.f);
+
+    events_per_image_ = 1500;
+    iterations_ = 10;
+
+    camera_parameters_ = cam_parameters;
+    upscale_ = upscale;
+    tracking_quality_ = 1;
+
+    pending_scale_ = upscale_;
+    geometry_ = camera_parameters_.geometry(upscale_);
+
+    events_cpu_ = NULL;
+    events_gpu_ = NULL;
+    image_gradients_cpu_ = NULL;
+    image_gradients_gpu_ = NULL;
+
+    pose_.setZero();
+    old_pose_ = pose_;
+
+    tracking_mode_ = TRACKING_PACKET;
+    active_mode_ = tracking_mode_;
+    window_step_ = 100;
+    map_events_gpu_ = NULL;
+    resetIncrementalState();
+    events_tracked_ = 0;
+    last_time_ = 0;
+    map_loaded_ = false;
+
+    relocalization_ = false;
+    lost_quality_ = 0.1f;
+    lost_packets_ = 3;
+    low_quality_packets_ = 0;
+    lost_ = false;
+    relocalizations_ = 0;
+    relocalizer_ = NULL;
+
+    lambda_ = 100.f;
+    lambda_a_ = 2.f;
+    lambda_b_ = 10.f;
+    alpha_ = 0.4f;
+
+    // yunfan
+    getUndistortMap();
+    trackerMetrics();
+}
+
+void Tracker::reset(bool clear_map)
+{
+    if (clear_map)
+    {
+        iu::math::fill(*occurences_, 0);
+        iu::math::fill(*normalization_, 1.f);
+        pose_.setZero();
+        old_pose_.setZero();
+        map_loaded_ = false;
+    }
+    resetIncrementalState();
+    tracking_quality_ = 1;
+    events_tracked_ = 0;
+    low_quality_packets_ = 0;
+    lost_ = false;
+}
+
+void Tracker::setScale(float value)
+{
+    pending_scale_ = value;
+}
+
+void Tracker::setRelocalization(bool enabled, float lost_quality, int lost_packets)
+{
+    relocalization_ = enabled;
+    lost_quality_ = lost_quality;
+    lost_packets_ = lost_packets;
+    if (!enabled)
+    {
+        low_quality_packets_ = 0;
+        lost_ = false;
+    }
+}
+
+void Tracker::applyScale()
+{
+    float scale = pending_scale_;
+    if (scale == upscale_)
+        return;
+    upscale_ = scale;
+    geometry_.map = camera_parameters_.mapGeometry(upscale_);
+}
+
+// Undistorts the events into events_cpu_/events_gpu_, compacted to the
+// events inside the sensor with an undistorted pixel. Returns their number.
+size_t Tracker::uploadEvents(const Event *events, size_t count)
+{
+    TRACE_SCOPE("upload");
+    {
+        ScopedLatency latency(trackerMetrics().undistortion);
+        TRACE_SCOPE("undistort");
+        // same lookup as ::undistortPoint, without writing back into the event
+        valid_events_.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            if (events[i].x < 0 || events[i].x >= width_ || events[i].y < 0 || events[i].y >= height_)
+                continue;
+            int idx = undistorted[events[i].y * width_ + events[i].x];
+            if (idx >= 0)
+                valid_events_.push_back(make_float2(idx % width_, idx / width_));
+        }
+        trackerMetrics().events_out_of_map.add(count - valid_events_.size());
+    }
+    int n = valid_events_.size();
+    if (n == 0)
+        return 0;
+
+    // Keep CPU<->GPU interface memory up-to-date
+    if (!events_cpu_ || events_cpu_->numel() != n)
+    {
+        delete events_cpu_;
+        events_cpu_ = new iu::LinearHostMemory_32f_C2(n);
+    }
+    if (!events_gpu_ || events_gpu_->numel() != n)
+    {
+        delete events_gpu_;
+        events_gpu_ = new iu::LinearDeviceMemory_32f_C2(n);
+    }
+    if (!image_gradients_cpu_ || image_gradients_cpu_->numel() != n)
+    {
+        delete image_gradients_cpu_;
+        image_gradients_cpu_ = new iu::LinearHostMemory_32f_C4(n);
+    }
+    if (!image_gradients_gpu_ || image_gradients_gpu_->numel() != n)
+    {
+        delete image_gradients_gpu_;
+        image_gradients_gpu_ = new iu::LinearDeviceMemory_32f_C4(n);
+    }
+    std::copy(valid_events_.begin(), valid_events_.end(), events_cpu_->data());
+    iu::copy(events_cpu_, events_gpu_);
+    return n;
+}
+
+TrackingResult Tracker::track(const Event *events, size_t count)
+{
+    TrackingResult result;
+    result.started = ScopedTimer::getCurrentTime() * 1e-6;
+    applyScale();
+    result.t = count > 0 ? events[0].t + 0.5 * (events[count - 1].t - events[0].t) : 0;
+    result.pose_updated = false;
+    result.map_updated = false;
+    result.events_out_of_map = 0;
+    result.lost = false;
+    result.relocalized = false;
+    result.time_pose = 0;
+    result.time_map = 0;
+    if (count == 0)
+    {
+        result.pose = pose_;
+        result.quality = tracking_quality_;
+        result.pose_ready = ScopedTimer::getCurrentTime() * 1e-6;
+        return result;
+    }
+    if (tracking_mode_ != active_mode_)
+    { // window linearizations / filter state are only valid within one run of a mode
+        resetIncrementalState();
+        active_mode_ = tracking_mode_;
+    }
+
+    timer_.start();
+
+    size_t valid = uploadEvents(events, count);
+    result.events_out_of_map = count - valid;
+    if (valid == 0)
+    { // nothing to track, e.g. only events outside the sensor
+        result.pose = pose_;
+        result.quality = tracking_quality_;
+        result.lost = lost_;
+        result.pose_ready = ScopedTimer::getCurrentTime() * 1e-6;
+        return result;
+    }
+
+    bool async = tracking_mode_ == TRACKING_ASYNC;
+    if (mapInitialized())
+    {
+        bool successfull;
+        if (lost_)
+            result.relocalized = relocalize();
+        {
+            TRACE_SCOPE("update_pose");
+            if (tracking_mode_ == TRACKING_SLIDING_WINDOW)
+                successfull = updatePoseWindow();
+            else if (async)
+                successfull = updatePoseAsync();
+            else
+                successfull = updatePose();
+        }
+        result.time_pose = timer_.elapsed();
+        result.pose_updated = true;
+        result.pose_ready = ScopedTimer::getCurrentTime() * 1e-6;
+        updateLost();
+
+        if (successfull && !lost_ && tracking_quality_ > 0.25f)
+        { // first few events often contain only noise. Update map only when tracking is good (arbitrary th).
+            TRACE_SCOPE("map_fusion");
+            timer_.start();
+            if (async)
+                result.map_updated = updateMapAsync();
+            else
+            {
+                cuda::updateMap(geometry_, output_, occurences_, normalization_, events_gpu_, make_float3(pose_(0), pose_(1), pose_(2)), make_float3(old_pose_(0), old_pose_(1), old_pose_(2)), width_, height_);
+                result.map_updated = true;
+            }
+            result.time_map = timer_.elapsed();
+            trackerMetrics().map_fusion.record(result.time_map * 1e3);
+        }
+    }
+    else if (async)
+    {
+        TRACE_SCOPE("map_fusion");
+        result.map_updated = updateMapAsync();
+    }
+    else
+    {
+        TRACE_SCOPE("map_fusion");
+        cuda::updateMap(geometry_, output_, occurences_, normalization_, events_gpu_, make_float3(pose_(0), pose_(1), pose_(2)), make_float3(old_pose_(0), old_pose_(1), old_pose_(2)), width_, height_);
+        result.map_updated = true;
+    }
+    events_tracked_ += count;
+    last_time_ = events[count - 1].t;
+    trackerMetrics().events_out.add(count);
+
+    result.pose = pose_;
+    result.quality = tracking_quality_;
+    result.lost = lost_;
+    if (!result.pose_updated)
+        result.pose_ready = ScopedTimer::getCurrentTime() * 1e-6;
+    return result;
+}
+
+bool Tracker::mapInitialized() const
+{
+    // First few poses are crap anyhow, since there is no map.
+    return map_loaded_ || events_tracked_ > 10L * events_per_image_;
+}
+
+void Tracker::render(iu::ImageGpu_8u_C4 *output, bool show_events, bool show_pose)
+{
+    cuda::createOutput(geometry_, output, output_, show_events ? events_gpu_ : NULL, make_float3(pose_(0), pose_(1), pose_(2)), width_, height_, show_pose ? tracking_quality_ : -1.f);
+}
+
+void Tracker::snapshot(iu::ImageGpu_8u_C4 *color, iu::ImageGpu_32f_C1 *map, bool show_events, bool show_pose)
+{
+    if (camera_parameters_.map_projection == MAP_EQUIRECTANGULAR)
+    {
+        render(color, show_events, show_pose);
+        iu::copy(output_, map);
+        return;
+    }
+    // other map representations are converted to the usual equirectangular panorama
+    iu::ImageGpu_8u_C4 rendered(output_->size());
+    render(&rendered, show_events, show_pose);
+    cuda::exportEquirectangular(geometry_, color, &rendered);
+    cuda::exportEquirectangular(geometry_, map, output_);
+}
+
+void Tracker::saveState(std::string filename)
+{
+    iu::ImageGpu_8u_C4 color(output_->size());
+    iu::ImageGpu_32f_C1 map(output_->size());
+    snapshot(&color, &map, false, false);
+    ::saveState(filename, &color);
+    if (camera_parameters_.map_projection != MAP_EQUIRECTANGULAR)
+        ::saveState(filename + "_map", &map, false, true, false);
+}
+
+bool Tracker::saveCheckpoint(const std::string &filename)
+{
+    CheckpointHeader header;
+    initCheckpointHeader(header);
+    header.width = output_->width();
+    header.height = output_->height();
+    header.camera_model = camera_parameters_.camera_model;
+    header.map_projection = camera_parameters_.map_projection;
+    header.upscale = upscale_;
+    for (int i = 0; i < 3; i++)
+    {
+        header.pose[i] = pose_(i);
+        header.old_pose[i] = old_pose_(i);
+    }
+    header.quality = tracking_quality_;
+    Eigen::Map<Eigen::Matrix3f>(header.async_information) = async_information_;
+    header.events_tracked = events_tracked_;
+    header.last_time = last_time_;
+
+    // the planes are stored without row padding
+    size_t plane_size = (size_t)header.width * header.height;
+    std::vector<float> data(CHECKPOINT_PLANES * plane_size);
+    iu::ImageGpu_32f_C1 *images[CHECKPOINT_PLANES] = {output_, occurences_, normalization_};
+    std::vector<const float *> planes;
+    for (int i = 0; i < CHECKPOINT_PLANES; i++)
+    {
+        iu::ImageCpu_32f_C1 plane(&data[i * plane_size], header.width, header.height, header.width * sizeof(float), true);
+        iu::copy(images[i], &plane);
+        planes.push_back(&data[i * plane_size]);
+    }
+    return writeCheckpoint(filename, header, planes);
+}
+
+bool Tracker::loadCheckpoint(const std::string &filename, bool restore_pose)
+{
+    CheckpointFile file;
+    if (!file.open(filename))
+        return false;
+    applyScale();
+    const CheckpointHeader &header = file.header();
+    if (header.width != (int)output_->width() || header.height != (int)output_->height() ||
+        header.camera_model != camera_parameters_.camera_model || header.map_projection != camera_parameters_.map_projection ||
+        header.upscale != upscale_)
+        return false;
+
+    // uploaded straight from the mapped file
+    iu::ImageGpu_32f_C1 *images[CHECKPOINT_PLANES] = {output_, occurences_, normalization_};
+    for (int i = 0; i < CHECKPOINT_PLANES; i++)
+    {
+        iu::ImageCpu_32f_C1 plane(const_cast<float *>(file.plane(i)), header.width, header.height, header.width * sizeof(float), true);
+        iu::copy(&plane, images[i]);
+    }
+
+    map_loaded_ = true;
+    if (restore_pose)
+    {
+        pose_ = Eigen::Vector3f(header.pose[0], header.pose[1], header.pose[2]);
+        old_pose_ = Eigen::Vector3f(header.old_pose[0], header.old_pose[1], header.old_pose[2]);
+        tracking_quality_ = header.quality;
+        events_tracked_ = header.events_tracked;
+        last_time_ = header.last_time;
+    }
+    else
+    {
+        pose_.setZero();
+        old_pose_.setZero();
+        tracking_quality_ = 1;
+        events_tracked_ = 0;
+        last_time_ = 0;
+    }
+    // the sliding window is rebuilt within a few steps, the filter keeps its information
+    resetIncrementalState();
+    low_quality_packets_ = 0;
+    lost_ = false;
+    if (restore_pose)
+        async_information_ = Eigen::Map<const Eigen::Matrix3f>(header.async_information);
+    return true;
+}
+
+Matrix3fr Tracker::rodrigues(Eigen::Vector3f in)
+{
+    float theta = in.norm();
+    if (theta < 1e-8f)
+    {
+        return Matrix3fr::Identity();
+    }
+    Eigen::Vector3f omega = in / theta;
+    float alpha = cos(theta);
+    float beta = sin(theta);
+    float gamma = 1 - alpha;
+
+    // R = eye(3)*alpha + crossmat(omega)*beta + omega*omega'*gamma
+    return Matrix3fr::Identity() * alpha + crossmat(omega) * beta + omega * omega.transpose() * gamma;
+}
+
+Matrix3fr Tracker::crossmat(Eigen::Vector3f t)
+{
+    Matrix3fr t_hat;
+    t_hat << 0, -t(2), t(1),
+        t(2), 0, -t(0),
+        -t(1), t(0), 0;
+    return t_hat;
+}
+
+struct Tracker::PoseUpdater
+{
+    Tracker *worker;
+    bool result;
+
+    template <class Camera, class Projection>
+    void operator()(Camera camera, Projection projection)
+    {
+        result = worker->updatePose(camera, projection);
+    }
+};
+
+bool Tracker::updatePose()
+{
+    PoseUpdater updater = {this, false};
+    dispatchModels(camera_parameters_.camera_model, camera_parameters_.map_projection, updater);
+    return updater.result;
+}
+
+template <class Camera>
+void Tracker::computeBearings(Eigen::Matrix3Xf &points)
+{
+    Eigen::Map<Eigen::Matrix2Xf> events((float *)events_cpu_->data(), 2, events_cpu_->numel());
+    points.resize(3, events.cols());
+    for (int id = 0; id < events.cols(); id++)
+    {
+        float3 ray = Camera::bearing(geometry_.camera, make_float2(events(0, id), events(1, id)));
+        points.col(id) << ray.x, ray.y, ray.z;
+    }
+}
+
+template <class Projection>
+float Tracker::linearize(const Eigen::Matrix3Xf &points, const Eigen::Vector3f &pose, Eigen::Matrix3f &JtJ, Eigen::Vector3f &JtM)
+{
+    Eigen::Matrix3Xf X_hat(3, points.cols());
+    Eigen::RowVector3f J;
+    Eigen::MatrixX3f dG_dgsi(9, 3);
+    Eigen::Matrix3Xf dg_dG(3, 9);
+    Eigen::Matrix2Xf dPI_dg(2, 3);
+    Eigen::Map<Eigen::Matrix4Xf> dM_dx((float *)image_gradients_cpu_->data(), 4, events_cpu_->numel());
+    Eigen::Map<Eigen::VectorXf, 0, Eigen::Stride<0, 4> > M(&image_gradients_cpu_->data(0)->z, events_cpu_->numel());
+
+    Eigen::Matrix3f R = rodrigues(pose);
+    X_hat = R * points;
+    // get image gradients from GPU -> move to CPU
+    cuda::getGradients(geometry_, image_gradients_gpu_, output_, events_gpu_, make_float3(pose(0), pose(1), pose(2)));
+    iu::copy(image_gradients_gpu_, image_gradients_cpu_);
+    dG_dgsi << crossmat(-R.row(0)), crossmat(-R.row(1)), crossmat(-R.row(2));
+    JtJ.setZero();
+    JtM.setZero();
+    for (int id = 0; id < points.cols(); id++)
+    {
+        dg_dG << X_hat(0, id) * Eigen::Matrix3f::Identity(),
+            X_hat(1, id) * Eigen::Matrix3f::Identity(),
+            X_hat(2, id) * Eigen::Matrix3f::Identity();
+        float3 du, dv;
+        Projection::jacobian(geometry_.map, make_float3(X_hat(0, id), X_hat(1, id), X_hat(2, id)), du, dv);
+        dPI_dg << du.x, du.y, du.z,
+            dv.x, dv.y, dv.z;
+        J = dM_dx.block<2, 1>(0, id).transpose() * dPI_dg * dg_dG * dG_dgsi;
+        JtJ += J.transpose() * J;
+        JtM += J.transpose() * M(id);
+    }
+    return M.sum();
+}
+
+template <class Camera, class Projection>
+bool Tracker::updatePose(Camera, Projection)
+{
+    // Pre-calculate stuff which doesn't change between iterations
+    Eigen::Matrix3Xf points;
+    computeBearings<Camera>(points);
+
+    Eigen::Matrix3f JtJ;
+    Eigen::Vector3f JtM;
+    float M_sum = 0.f;
+
+    old_pose_ = pose_;
+    Eigen::Vector3f old_pose = pose_;
+    Eigen::Vector3f init_pose = pose_;
+    Eigen::Vector3f accel_pose = pose_;
+    for (int iteration = 0; iteration < iterations_; iteration++)
+    {
+        ScopedLatency latency(trackerMetrics().iteration);
+        TRACE_SCOPE("iteration");
+        M_sum = linearize<Projection>(points, accel_pose, JtJ, JtM);
+        // Gauss-Newton with prox
+        float alpha = 1.f;
+        old_pose = pose_;
+        pose_ = accel_pose - (JtJ + alpha * JtJ.diagonal().asDiagonal().toDenseMatrix()).inverse() * (-JtM - alpha * (accel_pose - init_pose));
+        accel_pose = pose_ + alpha_ * (pose_ - old_pose);
+    }
+    tracking_quality_ = std::min(M_sum / points.cols() * upscale_, 1.f);
+    return true;
+}
+
+struct Tracker::WindowPoseUpdater
+{
+    Tracker *worker;
+    bool result;
+
+    template <class Camera, class Projection>
+    void operator()(Camera camera, Projection projection)
+    {
+        result = worker->updatePoseWindow(camera, projection);
+    }
+};
+
+bool Tracker::updatePoseWindow()
+{
+    WindowPoseUpdater updater = {this, false};
+    dispatchModels(camera_parameters_.camera_model, camera_parameters_.map_projection, updater);
+    return updater.result;
+}
+
+// Only the newest window_step_ events are linearized (at the warm-started pose).
+// Older steps keep their linearization; their residuals are carried to the
+// current pose to first order, M_i(p) ~ M_i + J_i (p - p_i), which only needs
+// the running sums of JtJ, JtM and JtJ*p_i over the window.
+template <class Camera, class Projection>
+bool Tracker::updatePoseWindow(Camera, Projection)
+{
+    Eigen::Matrix3Xf points;
+    computeBearings<Camera>(points);
+
+    WindowStep step;
+    step.events = points.cols();
+    step.M_sum = 0.f;
+
+    old_pose_ = pose_;
+    Eigen::Vector3f init_pose = pose_;
+    for (int iteration = 0; iteration < iterations_; iteration++)
+    {
+        ScopedLatency latency(trackerMetrics().iteration);
+        TRACE_SCOPE("iteration");
+        step.M_sum = linearize<Projection>(points, pose_, step.JtJ, step.JtM);
+        step.JtJp = step.JtJ * pose_;
+
+        Eigen::Matrix3f JtJ = window_sum_.JtJ + step.JtJ;
+        Eigen::Vector3f JtM = window_sum_.JtM + step.JtM + window_sum_.JtJ * pose_ - window_sum_.JtJp;
+        // Gauss-Newton with prox
+        float alpha = 1.f;
+        pose_ = pose_ - (JtJ + alpha * JtJ.diagonal().asDiagonal().toDenseMatrix()).inverse() * (-JtM - alpha * (pose_ - init_pose));
+    }
+
+    // add the new step, drop steps which are no longer needed to cover events_per_image_ events
+    window_.push_back(step);
+    window_events_ += step.events;
+    window_sum_.JtJ += step.JtJ;
+    window_sum_.JtM += step.JtM;
+    window_sum_.JtJp += step.JtJp;
+    window_sum_.M_sum += step.M_sum;
+    while (window_.size() > 1 && window_events_ - window_.front().events >= events_per_image_)
+    {
+        const WindowStep &expired = window_.front();
+        window_events_ -= expired.events;
+        window_sum_.JtJ -= expired.JtJ;
+        window_sum_.JtM -= expired.JtM;
+        window_sum_.JtJp -= expired.JtJp;
+        window_sum_.M_sum -= expired.M_sum;
+        window_.pop_front();
+    }
+    tracking_quality_ = std::min(window_sum_.M_sum / window_events_ * upscale_, 1.f);
+    return true;
+}
+
+void Tracker::resetIncrementalState()
+{
+    async_information_.setZero();
+    map_events_.clear();
+    map_pose_ = pose_;
+    window_.clear();
+    window_events_ = 0;
+    window_sum_.events = 0;
+    window_sum_.JtJ.setZero();
+    window_sum_.JtM.setZero();
+    window_sum_.JtJp.setZero();
+    window_sum_.M_sum = 0.f;
+}
+
+struct Tracker::AsyncPoseUpdater
+{
+    Tracker *worker;
+    bool result;
+
+    template <class Camera, class Projection>
+    void operator()(Camera camera, Projection projection)
+    {
+        result = worker->updatePoseAsync(camera, projection);
+    }
+};
+
+bool Tracker::updatePoseAsync()
+{
+    AsyncPoseUpdater updater = {this, false};
+    dispatchModels(camera_parameters_.camera_model, camera_parameters_.map_projection, updater);
+    return updater.result;
+}
+
+// Information filter on the rotation: every micro-batch adds its JtJ to an
+// information matrix which forgets at a rate that keeps about events_per_image_
+// events of history, and takes a single damped Gauss-Newton step.
+template <class Camera, class Projection>
+bool Tracker::updatePoseAsync(Camera, Projection)
+{
+    Eigen::Matrix3Xf points;
+    computeBearings<Camera>(points);
+
+    Eigen::Matrix3f JtJ;
+    Eigen::Vector3f JtM;
+    ScopedLatency latency(trackerMetrics().iteration);
+    TRACE_SCOPE("iteration");
+    float M_sum = linearize<Projection>(points, pose_, JtJ, JtM);
+
+    float forgetting = std::max(0.f, 1.f - float(points.cols()) / events_per_image_);
+    async_information_ = forgetting * async_information_ + JtJ;
+    Eigen::Matrix3f H = async_information_ + async_information_.diagonal().asDiagonal().toDenseMatrix() + 1e-6f * Eigen::Matrix3f::Identity();
+
+    old_pose_ = pose_;
+    pose_ = pose_ + H.inverse() * JtM;
+    tracking_quality_ = forgetting * tracking_quality_ + (1.f - forgetting) * std::min(M_sum / points.cols() * upscale_, 1.f);
+    return true;
+}
+
+// The map is fused in packets of events_per_image_ events, the normalization
+// uses the motion since the previous fusion. Returns whether it was fused.
+bool Tracker::updateMapAsync()
+{
+    for (int i = 0; i < events_cpu_->numel(); i++)
+        map_events_.push_back(*events_cpu_->data(i));
+    if (map_events_.size() < (size_t)events_per_image_)
+        return false;
+
+    // the device buffer only grows, the kernels see a view of the filled part
+    if (!map_events_gpu_ || map_events_gpu_->numel() < int(map_events_.size()))
+    {
+        delete map_events_gpu_;
+        map_events_gpu_ = new iu::LinearDeviceMemory_32f_C2(std::max<int>(map_events_.size(), 2 * events_per_image_));
+    }
+    iu::LinearDeviceMemory_32f_C2 map_events_gpu(map_events_gpu_->data(), map_events_.size(), true);
+    iu::LinearHostMemory_32f_C2 map_events_cpu(map_events_.data(), map_events_.size(), true);
+    iu::copy(&map_events_cpu, &map_events_gpu);
+    cuda::updateMap(geometry_, output_, occurences_, normalization_, &map_events_gpu, make_float3(pose_(0), pose_(1), pose_(2)), make_float3(map_pose_(0), map_pose_(1), map_pose_(2)), width_, height_);
+    map_pose_ = pose_;
+    map_events_.clear();
+    return true;
+}
+
+static const int RELOCALIZATION_LEVELS = 3;
+static const int RELOCALIZATION_CANDIDATES = 8; // refined per level
+static const int RELOCALIZATION_STEPS = 2;      // local grid of (2*2+1)^3 rotations around each
+static const int RELOCALIZATION_MAX_RADIUS = 64;
+
+static Eigen::Matrix3f rotationMatrix(const Eigen::Vector3f &r)
+{
+    float theta = r.norm();
+    return theta < 1e-8f ? Eigen::Matrix3f::Identity() : Eigen::AngleAxisf(theta, r / theta).toRotationMatrix();
+}
+
+static Eigen::Vector3f rotationVector(const Eigen::Matrix3f &R)
+{
+    Eigen::AngleAxisf aa(R);
+    return aa.angle() * aa.axis();
+}
+
+// Coarse-to-fine search over all rotations: a grid over the ball of rotation
+// vectors, then finer local grids around the best candidates of the previous
+// level. Every level scores on a copy of the map dilated by about half its
+// spacing, so the true pose still scores high at the nearest candidate.
+struct Tracker::Relocalizer
+{
+    struct Level
+    {
+        float spacing;     // radians between candidates
+        int radius;        // dilation in map pixels, 0: the map itself
+        iu::ImageGpu_32f_C1 *map;
+        iu::LinearHostMemory_32f_C4 *candidates_cpu;
+        iu::LinearDeviceMemory_32f_C4 *candidates;
+        iu::LinearDeviceMemory_32f_C1 *scores;
+        iu::LinearHostMemory_32f_C1 *scores_cpu;
+    };
+
+    std::vector<Eigen::Vector3f> grid;
+    Level levels[RELOCALIZATION_LEVELS + 1]; // the last one compares the result with the last pose
+    iu::ImageGpu_32f_C1 *tmp;
+    bool maps_valid;
+
+    Relocalizer(int width, int height)
+    {
+        float spacing = M_PI / 8;
+        int n = std::ceil(M_PI / spacing);
+        for (int i = -n; i <= n; i++)
+            for (int j = -n; j <= n; j++)
+                for (int k = -n; k <= n; k++)
+                {
+                    Eigen::Vector3f r(i * spacing, j * spacing, k * spacing);
+                    if (r.norm() <= M_PI + 1e-4f)
+                        grid.push_back(r);
+                }
+        for (int l = 0; l <= RELOCALIZATION_LEVELS; l++)
+        {
+            Level &level = levels[l];
+            level.spacing = spacing;
+            level.radius = 0;
+            level.map = l < RELOCALIZATION_LEVELS ? new iu::ImageGpu_32f_C1(width, height) : NULL;
+            level.candidates_cpu = NULL;
+            level.candidates = NULL;
+            level.scores = NULL;
+            level.scores_cpu = NULL;
+            spacing /= 2 * RELOCALIZATION_STEPS;
+        }
+        tmp = new iu::ImageGpu_32f_C1(width, height);
+        maps_valid = false;
+    }
+
+    ~Relocalizer()
+    {
+        for (int l = 0; l <= RELOCALIZATION_LEVELS; l++)
+        {
+            Level &level = levels[l];
+            delete level.map;
+            delete level.candidates_cpu;
+            delete level.candidates;
+            delete level.scores;
+            delete level.scores_cpu;
+        }
+        delete tmp;
+    }
+
+    // dilations for the given map pixels per radian of rotation
+    void prepareMaps(iu::ImageGpu_32f_C1 *map, float pixels_per_radian)
+    {
+        for (int l = 0; l < RELOCALIZATION_LEVELS; l++)
+        {
+            Level &level = levels[l];
+            // half the diagonal of a grid cell
+            level.radius = std::min((int)std::ceil(0.5f * std::sqrt(3.f) * level.spacing * pixels_per_radian), RELOCALIZATION_MAX_RADIUS);
+            if (level.radius > 0)
+                cuda::dilateMap(level.map, map, tmp, level.radius);
+        }
+        maps_valid = true;
+    }
+
+    void score(int l, iu::ImageGpu_32f_C1 *map, const TrackingGeometry &geometry, iu::LinearDeviceMemory_32f_C2 *events,
+               const std::vector<Eigen::Vector3f> &rotations, std::vector<float> &scores)
+    {
+        Level &level = levels[l];
+        if (!level.candidates || level.candidates->numel() != (int)rotations.size())
+        {
+            delete level.candidates_cpu;
+            delete level.candidates;
+            delete level.scores;
+            delete level.scores_cpu;
+            level.candidates_cpu = new iu::LinearHostMemory_32f_C4(rotations.size());
+            level.candidates = new iu::LinearDeviceMemory_32f_C4(rotations.size());
+            level.scores = new iu::LinearDeviceMemory_32f_C1(rotations.size());
+            level.scores_cpu = new iu::LinearHostMemory_32f_C1(rotations.size());
+        }
+        for (size_t i = 0; i < rotations.size(); i++)
+            *level.candidates_cpu->data(i) = make_float4(rotations[i](0), rotations[i](1), rotations[i](2), 0.f);
+        iu::copy(level.candidates_cpu, level.candidates);
+        cuda::scoreRotations(geometry, level.scores, level.radius > 0 ? level.map : map, events, level.candidates);
+        iu::copy(level.scores, level.scores_cpu);
+        scores.assign(level.scores_cpu->data(), level.scores_cpu->data() + rotations.size());
+    }
+};
+
+// after Relocalizer, which must be complete here
+Tracker::~Tracker()
+{
+    CudaSafeCall(cudaSetDevice(device_number_));
+    delete relocalizer_;
+    delete map_events_gpu_;
+    delete image_gradients_gpu_;
+    delete image_gradients_cpu_;
+    delete events_gpu_;
+    delete events_cpu_;
+    delete normalization_;
+    delete occurences_;
+    delete output_;
+}
+
+// Tracking counts as lost after lost_packets_ packets below lost_quality_,
+// and as recovered once the quality allows map updates again
+void Tracker::updateLost()
+{
+    if (!relocalization_)
+        return;
+    if (tracking_quality_ < lost_quality_)
+        low_quality_packets_++;
+    else
+        low_quality_packets_ = 0;
+    if (lost_ && tracking_quality_ > 0.25f)
+        lost_ = false;
+    else if (!lost_ && low_quality_packets_ >= lost_packets_)
+    {
+        lost_ = true;
+        if (relocalizer_) // the map is frozen from now on
+            relocalizer_->maps_valid = false;
+    }
+}
+
+struct Tracker::RelocalizationSearch
+{
+    Tracker *worker;
+    bool result;
+
+    template <class Camera, class Projection>
+    void operator()(Camera camera, Projection projection)
+    {
+        result = worker->relocalize(camera, projection);
+    }
+};
+
+// Searches the rotation which explains the current packet best and restarts
+// the optimizer from it. The normal pose update refines it.
+bool Tracker::relocalize()
+{
+    TRACE_SCOPE("relocalize");
+    ScopedLatency latency(trackerMetrics().relocalization);
+    if (!relocalizer_)
+        relocalizer_ = new Relocalizer(output_->width(), output_->height());
+    RelocalizationSearch search = {this, false};
+    dispatchModels(camera_parameters_.camera_model, camera_parameters_.map_projection, search);
+    if (search.result)
+    {
+        relocalizations_++;
+        trackerMetrics().relocalizations.add(1);
+    }
+    return search.result;
+}
+
+template <class Camera, class Projection>
+bool Tracker::relocalize(Camera, Projection)
+{
+    Relocalizer &search = *relocalizer_;
+    if (!search.maps_valid)
+    {
+        // map pixels per radian of rotation around the last view direction
+        const CameraGeometry &cam = geometry_.camera;
+        float3 ray = Camera::bearing(cam, make_float2(cam.cx, cam.cy));
+        Eigen::Vector3f view = rotationMatrix(pose_) * Eigen::Vector3f(ray.x, ray.y, ray.z).normalized();
+        float3 du, dv;
+        Projection::jacobian(geometry_.map, make_float3(view(0), view(1), view(2)), du, dv);
+        float norm2 = du.x * du.x + du.y * du.y + du.z * du.z + dv.x * dv.x + dv.y * dv.y + dv.z * dv.z;
+        search.prepareMaps(output_, std::sqrt(0.5f * norm2));
+    }
+
+    // the global grid and the last pose, then local grids around the best candidates
+    std::vector<Eigen::Vector3f> candidates = search.grid;
+    candidates.push_back(pose_);
+    std::vector<float> scores;
+    std::vector<int> order;
+    for (int l = 0; l < RELOCALIZATION_LEVELS; l++)
+    {
+        if (l > 0)
+        {
+            std::vector<Eigen::Vector3f> refined;
+            float spacing = search.levels[l].spacing;
+            for (int c = 0; c < RELOCALIZATION_CANDIDATES && c < (int)order.size(); c++)
+            {
+                Eigen::Matrix3f R = rotationMatrix(candidates[order[c]]);
+                for (int i = -RELOCALIZATION_STEPS; i <= RELOCALIZATION_STEPS; i++)
+                    for (int j = -RELOCALIZATION_STEPS; j <= RELOCALIZATION_STEPS; j++)
+                        for (int k = -RELOCALIZATION_STEPS; k <= RELOCALIZATION_STEPS; k++)
+                            refined.push_back(rotationVector(R * rotationMatrix(Eigen::Vector3f(i, j, k) * spacing)));
+            }
+            candidates.swap(refined);
+        }
+        search.score(l, output_, geometry_, events_gpu_, candidates, scores);
+        order.resize(candidates.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        int best = std::min<int>(RELOCALIZATION_CANDIDATES, order.size());
+        std::partial_sort(order.begin(), order.begin() + best, order.end(), [&scores](int a, int b) { return scores[a] > scores[b]; });
+    }
+
+    // only a pose that explains the events better than the last one is taken
+    std::vector<Eigen::Vector3f> result(1, candidates[order[0]]);
+    result.push_back(pose_);
+    search.score(RELOCALIZATION_LEVELS, output_, geometry_, events_gpu_, result, scores);
+    if (scores[0] <= scores[1])
+        return false;
+    pose_ = result[0];
+    old_pose_ = pose_;
+    tracking_quality_ = std::min(scores[0] * upscale_, 1.f);
+    resetIncrementalState();
+    return true;
+}
+
+struct Tracker::UndistortMapBuilder
+{
+    Tracker *worker;
+
+    template <class Camera, class Projection>
+    void operator()(Camera camera, Projection)
+    {
+        worker->getUndistortMap(camera);
+    }
+};
+
+void Tracker::getUndistortMap()
+{
+    UndistortMapBuilder builder = {this};
+    dispatchModels(camera_parameters_.camera_model, camera_parameters_.map_projection, builder);
+}
+
+template <class Camera>
+void Tracker::getUndistortMap(Camera)
+{
+    undistorted = std::vector<int>(width_ * height_, -1);
+
+    const CameraGeometry &cam = geometry_.camera;
+    for (int v = 0; v < height_; v++)
+    {
+        for (int u = 0; u < width_; u++)
+        {
+            float2 distorted = Camera::distort(cam, make_float2((u - cam.cx) / cam.fx, (v - cam.cy) / cam.fy));
+            float u_distorted = cam.fx * distorted.x + cam.cx;
+            float v_distorted = cam.fy * distorted.y + cam.cy;
+
+            int idx_distort = (int)v_distorted * width_ + (int)u_distorted;
+            int idx_undistort = (int)v * width_ + (int)u;
+            if (u_distorted >= 0 && v_distorted >= 0 && u_distorted < width_ && v_distorted < height_)
+            {
+                undistorted[idx_distort] = idx_undistort;
+            }
+        }
+    }
+}
@@ -0,0 +1,230 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <string>
+#include <Eigen/Dense>
+
+#include "iu/iucore.h"
+#include "event.h"
+#include "parameters.h"
+
+enum TrackingMode
+{
+    TRACKING_PACKET,        // one pose per events_per_image_ events
+    TRACKING_SLIDING_WINDOW, // one pose per window_step_ events, optimized over the last events_per_image_ events
+    TRACKING_ASYNC           // one filter step per micro-batch of window_step_ events
+};
+
+// Outcome of Tracker::track for one packet
+struct TrackingResult
+{
+    double t;             // sensor time of the pose (middle of the packet), seconds
+    Eigen::Vector3f pose; // rotation vector
+    float quality;
+    bool pose_updated;    // false while the map is being initialized
+    bool map_updated;
+    int events_out_of_map;
+    bool lost;            // map updates paused until the quality recovers
+    bool relocalized;     // pose reinitialized by the rotation search
+    double started;       // host time track() was called, seconds (ScopedTimer clock)
+    double pose_ready;    // host time the pose was available, seconds (ScopedTimer clock)
+    double time_pose;     // upload and pose update, milliseconds
+    double time_map;      // milliseconds
+};
+
+// Panorama tracking and mapping without threads, queues or Qt. The caller
+// feeds packets of events and gets a pose for every packet; everything runs
+// synchronously on the calling thread. All camera and map parameters belong
+// to the instance, so trackers with different calibrations can run side by
+// side and a tracker may move between threads (one at a time, on its device).
+class Tracker
+{
+public:
+    Tracker(const Parameters &parameters, int device_number = 0, float upscale = 1.f);
+    ~Tracker();
+
+    // The events are read in place, not copied or modified
+    TrackingResult track(const Event *events, size_t count);
+    TrackingResult track(const std::vector<Event> &events) { return track(events.data(), events.size()); }
+
+    // Drops the window and filter state; clear_map also empties the map and
+    // resets the pose
+    void reset(bool clear_map);
+
+    void setEventsPerImage(int value) { events_per_image_ = value; }
+    void setIterations(int value) { iterations_ = value; }
+    void setAcceleration(float value) { alpha_ = value; }
+    void setTrackingMode(int value) { tracking_mode_ = value; }
+    void setWindowStep(int value) { window_step_ = value; }
+    void setScale(float value); // any thread, takes effect with the next packet
+    // After lost_packets packets with a quality below lost_quality the map
+    // updates pause and every packet first searches all rotations for the
+    // pose, until the quality recovers. Off by default.
+    void setRelocalization(bool enabled, float lost_quality = 0.1f, int lost_packets = 3);
+    int eventsPerImage(void) const { return events_per_image_; }
+    int iterations(void) const { return iterations_; }
+    int windowStep(void) const { return window_step_; }
+    int trackingMode(void) const { return tracking_mode_; }
+    // events per packet track() expects in the current mode
+    int packetSize(void) const { return tracking_mode_ == TRACKING_PACKET ? events_per_image_ : window_step_; }
+
+    const Eigen::Vector3f &pose(void) const { return pose_; }
+    float quality(void) const { return tracking_quality_; }
+    long eventsTracked(void) const { return events_tracked_; }
+    double lastTime(void) const { return last_time_; } // sensor time of the last tracked event
+    bool mapInitialized(void) const;
+    bool lost(void) const { return lost_; }
+    long relocalizations(void) const { return relocalizations_; }
+    const Parameters &parameters(void) const { return camera_parameters_; }
+    const TrackingGeometry &geometry(void) const { return geometry_; }
+    int deviceNumber(void) const { return device_number_; }
+
+    // Map access. The map is in the configured projection; the events are
+    // the undistorted pixels of the last packet.
+    iu::ImageGpu_32f_C1 *map(void) { return output_; }
+    iu::LinearDeviceMemory_32f_C2 *packetEvents(void) { return events_gpu_; }
+    // Draws the map into output, optionally with the last packet and the
+    // camera outline coloured by the tracking quality
+    void render(iu::ImageGpu_8u_C4 *output, bool show_events, bool show_pose);
+    // Equirectangular copy of the map and its rendering (sizes as map())
+    void snapshot(iu::ImageGpu_8u_C4 *color, iu::ImageGpu_32f_C1 *map, bool show_events, bool show_pose);
+    // <filename>.png and, for non equirectangular maps, <filename>_map.npy
+    void saveState(std::string filename);
+
+    // Map, pose and filter state in the format of checkpoint.h
+    bool saveCheckpoint(const std::string &filename);
+    // Fails if map size, camera model, projection or scale differ. The map
+    // counts as initialized, so tracking starts with the first packet.
+    // Without restore_pose it is used as a prebuilt map of the environment
+    // and tracking starts at the zero pose.
+    bool loadCheckpoint(const std::string &filename, bool restore_pose = true);
+
+protected:
+    // owns its buffers, not copyable
+    Tracker(const Tracker &);
+    Tracker &operator=(const Tracker &);
+
+    struct PoseUpdater;
+    struct WindowPoseUpdater;
+    struct AsyncPoseUpdater;
+    struct UndistortMapBuilder;
+    struct Relocalizer;
+    struct RelocalizationSearch;
+
+    // linearization of one step of the sliding window
+    struct WindowStep
+    {
+        int events;
+        Eigen::Matrix3f JtJ;
+        Eigen::Vector3f JtM;
+        Eigen::Vector3f JtJp; // JtJ * linearization point
+        float M_sum;
+    };
+
+    void applyScale(void);
+    size_t uploadEvents(const Event *events, size_t count);
+    bool updatePose(void);
+    template <class Camera, class Projection>
+    bool updatePose(Camera, Projection);
+    bool updatePoseWindow(void);
+    template <class Camera, class Projection>
+    bool updatePoseWindow(Camera, Projection);
+    bool updatePoseAsync(void);
+    template <class Camera, class Projection>
+    bool updatePoseAsync(Camera, Projection);
+    bool updateMapAsync(void);
+    void updateLost(void);
+    bool relocalize(void);
+    template <class Camera, class Projection>
+    bool relocalize(Camera, Projection);
+    template <class Camera>
+    void computeBearings(Eigen::Matrix3Xf &points);
+    template <class Projection>
+    float linearize(const Eigen::Matrix3Xf &points, const Eigen::Vector3f &pose, Eigen::Matrix3f &JtJ, Eigen::Vector3f &JtM);
+    void resetIncrementalState(void);
+    Matrix3fr rodrigues(Eigen::Vector3f in);
+    Matrix3fr crossmat(Eigen::Vector3f t);
+
+    int events_per_image_;
+    int iterations_;
+    int width_;
+    int height_;
+    Parameters camera_parameters_;
+    int device_number_;
+    long events_tracked_;
+    double last_time_;
+    bool map_loaded_; // from a checkpoint
+    float upscale_;
+    std::atomic<float> pending_scale_; // set by setScale, applied by the tracking thread
+
+    iu::ImageGpu_32f_C1 *output_;
+    iu::ImageGpu_32f_C1 *occurences_;
+    iu::ImageGpu_32f_C1 *normalization_;
+
+    std::vector<float2> valid_events_; // undistorted events of the packet
+    iu::LinearHostMemory_32f_C2 *events_cpu_;
+    iu::LinearDeviceMemory_32f_C2 *events_gpu_;
+    iu::LinearHostMemory_32f_C4 *image_gradients_cpu_;
+    iu::LinearDeviceMemory_32f_C4 *image_gradients_gpu_;
+
+    Eigen::Vector3f pose_;
+    Eigen::Vector3f old_pose_;
+    float tracking_quality_;
+    TrackingGeometry geometry_;
+    iu::IuCudaTimer timer_;
+
+    // sliding window / asynchronous mode
+    int tracking_mode_;
+    int active_mode_; // mode the incremental state belongs to
+    int window_step_; // events per pose
+    int window_events_;
+    std::deque<WindowStep> window_;
+    WindowStep window_sum_;
+    Eigen::Matrix3f async_information_;
+    std::vector<float2> map_events_;
+    Eigen::Vector3f map_pose_;
+    iu::LinearDeviceMemory_32f_C2 *map_events_gpu_; // capacity, grown on demand
+
+    // relocalization after tracking loss
+    bool relocalization_;
+    float lost_quality_;
+    int lost_packets_;
+    int low_quality_packets_;
+    bool lost_;
+    long relocalizations_;
+    Relocalizer *relocalizer_; // search grid and buffers, created when first lost
+
+    // optimizer
+    float lambda_;
+    float lambda_a_;
+    float lambda_b_;
+    float alpha_;
+
+    //yunfan
+    std::vector<int> undistorted;
+    void getUndistortMap();
+    template <class Camera>
+    void getUndistortMap(Camera);
+};
+
+#endif // TRACKER_H
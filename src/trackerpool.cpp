@@ -0,0 +1,234 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "trackerpool.h"
+#include "common.h"
+#include "tracing.h"
+#include <cuda_runtime.h>
+
+TrackerPool::TrackerPool(int threads, int device_number)
+{
+    device_number_ = device_number;
+    next_stream_ = 0;
+    stopping_ = false;
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < threads; i++)
+        workers_.push_back(std::thread(&TrackerPool::workerLoop, this));
+}
+
+TrackerPool::~TrackerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++)
+        workers_[i].join();
+}
+
+int TrackerPool::addStream(Tracker *tracker, ResultCallback callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<Stream> stream(new Stream);
+    stream->tracker = tracker;
+    stream->callback = callback;
+    stream->queued = 0;
+    stream->flush = false;
+    stream->busy = false;
+    stream->packets = 0;
+    streams_.push_back(std::move(stream));
+    return (int)streams_.size() - 1;
+}
+
+void TrackerPool::addEvents(int stream, const Event *events, size_t count)
+{
+    Batch batch;
+    batch.owned = std::make_shared<std::vector<Event> >(events, events + count);
+    batch.events = batch.owned->data();
+    batch.count = count;
+    queue(stream, batch);
+}
+
+void TrackerPool::addEventsInPlace(int stream, const Event *events, size_t count)
+{
+    Batch batch;
+    batch.events = events;
+    batch.count = count;
+    queue(stream, batch);
+}
+
+void TrackerPool::queue(int stream, const Batch &batch)
+{
+    if (batch.count == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stream &s = *streams_[stream];
+        s.batches.push_back(batch);
+        s.queued += batch.count;
+    }
+    work_.notify_all();
+}
+
+void TrackerPool::flush(int stream)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        streams_[stream]->flush = true;
+    }
+    work_.notify_all();
+}
+
+bool TrackerPool::ready(const Stream &stream) const
+{
+    if (stream.busy || stream.queued == 0 || !stream.tracker)
+        return false;
+    return stream.flush || stream.queued >= (size_t)std::max(1, stream.tracker->packetSize());
+}
+
+const Event *TrackerPool::takePacket(Stream &stream, size_t n, std::vector<Event> &buffer, std::shared_ptr<std::vector<Event> > &holder)
+{
+    stream.queued -= n;
+    Batch &front = stream.batches.front();
+    if (front.count >= n)
+    {
+        const Event *packet = front.events;
+        holder = front.owned;
+        front.events += n;
+        front.count -= n;
+        if (front.count == 0)
+            stream.batches.pop_front();
+        return packet;
+    }
+    buffer.clear();
+    while (buffer.size() < n)
+    {
+        Batch &b = stream.batches.front();
+        size_t take = std::min(n - buffer.size(), b.count);
+        buffer.insert(buffer.end(), b.events, b.events + take);
+        b.events += take;
+        b.count -= take;
+        if (b.count == 0)
+            stream.batches.pop_front();
+    }
+    holder.reset();
+    return buffer.data();
+}
+
+void TrackerPool::wait(int stream)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Stream &s = *streams_[stream];
+    done_.wait(lock, [&]() { return idle(s); });
+}
+
+void TrackerPool::removeStream(int stream)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Stream &s = *streams_[stream];
+    done_.wait(lock, [&]() { return idle(s); });
+    s.tracker = NULL;
+    s.batches.clear();
+    s.queued = 0;
+}
+
+void TrackerPool::waitAll()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&]() {
+        for (size_t i = 0; i < streams_.size(); i++)
+            if (!idle(*streams_[i]))
+                return false;
+        return true;
+    });
+}
+
+int TrackerPool::streams()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (int)streams_.size();
+}
+
+size_t TrackerPool::queuedEvents(int stream)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return streams_[stream]->queued;
+}
+
+long TrackerPool::packets(int stream)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return streams_[stream]->packets;
+}
+
+void TrackerPool::workerLoop()
+{
+    CudaSafeCall(cudaSetDevice(device_number_));
+    Tracer::setThreadName("tracker pool");
+    std::vector<Event> buffer;
+    std::shared_ptr<std::vector<Event> > holder;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        Stream *stream = NULL;
+        int id = -1;
+        for (size_t i = 0; i < streams_.size() && !stream; i++)
+        {
+            size_t s = (next_stream_ + i) % streams_.size();
+            if (ready(*streams_[s]))
+            {
+                stream = streams_[s].get();
+                id = (int)s;
+                next_stream_ = s + 1;
+            }
+        }
+        if (!stream)
+        {
+            if (stopping_)
+                return;
+            work_.wait(lock);
+            continue;
+        }
+
+        // the packet size is read once per packet, the tracker may change it
+        size_t n = std::min(stream->queued, (size_t)std::max(1, stream->tracker->packetSize()));
+        const Event *packet = takePacket(*stream, n, buffer, holder);
+        if (stream->queued == 0)
+            stream->flush = false;
+        stream->busy = true;
+        lock.unlock();
+
+        TrackingResult result;
+        {
+            TraceSpan span("pool_packet", id);
+            result = stream->tracker->track(packet, n);
+        }
+        if (stream->callback)
+            stream->callback(id, result);
+
+        holder.reset();
+        lock.lock();
+        stream->busy = false;
+        stream->packets++;
+        // the stream may have another packet for the next free thread
+        work_.notify_one();
+        done_.notify_all();
+    }
+}
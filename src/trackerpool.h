@@ -0,0 +1,113 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef TRACKERPOOL_H
+#define TRACKERPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "event.h"
+#include "tracker.h"
+
+// Tracks several event streams (cameras of a rig, recordings of a batch) on
+// one set of threads. Every stream has its own Tracker with its calibration,
+// map and pose. The packets of a stream are tracked in order by one thread at
+// a time; streams with a complete packet are served round robin, so a busy
+// stream cannot starve the others.
+class TrackerPool
+{
+public:
+    // called on a pool thread after every packet
+    typedef std::function<void(int stream, const TrackingResult &result)> ResultCallback;
+
+    // threads <= 0: one per core. All trackers must live on device_number.
+    TrackerPool(int threads = 0, int device_number = 0);
+    ~TrackerPool();
+
+    // The tracker is not owned and must not be used by the caller while the
+    // stream has queued events. Returns the stream id.
+    int addStream(Tracker *tracker, ResultCallback callback = ResultCallback());
+    // Queues a copy of the events, they are tracked in packets of
+    // tracker->packetSize()
+    void addEvents(int stream, const Event *events, size_t count);
+    void addEvents(int stream, const std::vector<Event> &events) { addEvents(stream, events.data(), events.size()); }
+    // Queues the events without a copy, packets are tracked straight from
+    // them. They must stay valid until the stream is idle; many streams can
+    // share one read-only recording this way.
+    void addEventsInPlace(int stream, const Event *events, size_t count);
+    // Tracks the remaining events although they are less than a packet
+    void flush(int stream);
+    // Blocks until everything queued for the stream (all streams) is tracked;
+    // a remaining partial packet is kept unless flushed
+    void wait(int stream);
+    void waitAll(void);
+    // Waits until the stream is idle, drops a remaining partial packet and
+    // releases the tracker
+    void removeStream(int stream);
+
+    int threads(void) const { return (int)workers_.size(); }
+    int streams(void);
+    size_t queuedEvents(int stream);
+    long packets(int stream); // tracked so far
+
+protected:
+    // queued events, either copied (owned) or referenced
+    struct Batch
+    {
+        const Event *events;
+        size_t count;
+        std::shared_ptr<std::vector<Event> > owned;
+    };
+
+    struct Stream
+    {
+        Tracker *tracker; // NULL once removed
+        ResultCallback callback;
+        std::deque<Batch> batches;
+        size_t queued; // events in batches
+        bool flush;
+        bool busy; // a thread is tracking a packet of this stream
+        long packets;
+    };
+
+    void queue(int stream, const Batch &batch);
+    bool ready(const Stream &stream) const;
+    // Takes the next packet of at most n events off the queue. A packet within
+    // one batch is returned in place (kept alive by holder), otherwise it is
+    // gathered into buffer.
+    const Event *takePacket(Stream &stream, size_t n, std::vector<Event> &buffer, std::shared_ptr<std::vector<Event> > &holder);
+    bool idle(const Stream &stream) const { return !stream.busy && !ready(stream); }
+    void workerLoop(void);
+
+    int device_number_;
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable done_;
+    std::vector<std::unique_ptr<Stream> > streams_;
+    size_t next_stream_; // round robin position
+    bool stopping_;
+    std::vector<std::thread> workers_;
+};
+
+#endif // TRACKERPOOL_H
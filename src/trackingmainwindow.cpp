@@ -30,6 +30,7 @@
 #include <QToolBar>
 #include <fstream>
 #include "common.h"
+#include "tracing.h"
 //#define DAVIS
 #include <fstream>
 
@@ -51,7 +52,13 @@ TrackingMainWindow::TrackingMainWindow(char *camera_configuration_file, int devi
     int height = parameters_.camera_height;
 
     tracking_worker_ = new TrackingWorker(parameters_, device_number, 1.0f);
-    camera_worker_ = new DVSCameraWorker(tracking_worker_);
+    source_worker_ = new EventSourceWorker(tracking_worker_);
+    input_ = NULL;
+    replay_ = NULL;
+    replay_speed_ = 0;
+    replay_loop_ = false;
+    replay_seek_ = 0;
+    outputs_received_ = 0;
 
     std::cout << parameters_.K_cam << std::endl;
     std::cout << "camera size: " << width << "*" << height << std::endl;
@@ -122,6 +129,31 @@ TrackingMainWindow::TrackingMainWindow(char *camera_configuration_file, int devi
     upscale_->setMaximum(2);
     upscale_->setValue(1);
     upscale_->setSingleStep(0.1);
+    // Tracking mode
+    combo_tracking_mode_ = new QComboBox;
+    combo_tracking_mode_->addItem("Packets", TRACKING_PACKET);
+    combo_tracking_mode_->addItem("Sliding window", TRACKING_SLIDING_WINDOW);
+    combo_tracking_mode_->addItem("Asynchronous", TRACKING_ASYNC);
+    spin_window_step_ = new QSpinBox;
+    spin_window_step_->setMinimum(1);
+    spin_window_step_->setMaximum(10000);
+    spin_window_step_->setValue(100);
+    spin_window_step_->setSingleStep(10);
+    // Packetization
+    combo_packet_policy_ = new QComboBox;
+    combo_packet_policy_->addItem("Event count", PACKET_COUNT);
+    combo_packet_policy_->addItem("Time window", PACKET_TIME_WINDOW);
+    combo_packet_policy_->addItem("Latency budget", PACKET_LATENCY_BUDGET);
+    spin_packet_time_ = new QDoubleSpinBox;
+    spin_packet_time_->setMinimum(0.1);
+    spin_packet_time_->setMaximum(1000);
+    spin_packet_time_->setValue(20);
+    spin_packet_time_->setSingleStep(1);
+    spin_display_rate_ = new QDoubleSpinBox;
+    spin_display_rate_->setMinimum(1);
+    spin_display_rate_->setMaximum(240);
+    spin_display_rate_->setValue(30);
+    spin_display_rate_->setSingleStep(5);
 
     // operation bar at the very left side
     action_start_ = new QAction(QIcon(":play.png"), tr("&Start algorithm"), this);
@@ -140,6 +172,16 @@ TrackingMainWindow::TrackingMainWindow(char *camera_configuration_file, int devi
     QSpacerItem *space = new QSpacerItem(1, 1, QSizePolicy::Minimum, QSizePolicy::MinimumExpanding);
     QLabel *label_upscale = new QLabel("Upscale:");
     upscale_->setToolTip("setting upscale factor; default 1");
+    QLabel *label_tracking_mode = new QLabel("Tracking mode:");
+    combo_tracking_mode_->setToolTip("Packets: one pose per Events/image events\nSliding window: one pose per Events/pose, optimized over the last Events/image events\nAsynchronous: one filter update per Events/pose (micro-batch)");
+    QLabel *label_window_step = new QLabel("Events/pose:");
+    spin_window_step_->setToolTip("New events per pose in sliding window and asynchronous mode");
+    QLabel *label_packet_policy = new QLabel("Packets:");
+    combo_packet_policy_->setToolTip("Event count: fixed number of events\nTime window: all events of a fixed time window\nLatency budget: fixed number of events, drops stale events when falling behind");
+    QLabel *label_packet_time = new QLabel("Window/budget [ms]:");
+    spin_packet_time_->setToolTip("Time window or latency budget in milliseconds");
+    QLabel *label_display_rate = new QLabel("Display rate [fps]:");
+    spin_display_rate_->setToolTip("Maximum rate at which the panorama is rendered for display");
 
     layout->addWidget(label_events_per_image, 0, 0, 1, 1);
     layout->addWidget(spin_events_per_image_, 0, 1, 1, 1);
@@ -151,10 +193,20 @@ TrackingMainWindow::TrackingMainWindow(char *camera_configuration_file, int devi
     layout->addWidget(spin_acceleration_, 3, 1, 1, 1);
     layout->addWidget(label_upscale, 4, 0, 1, 1);
     layout->addWidget(upscale_, 4, 1, 1, 1);
-    layout->addWidget(check_show_camera_pose_, 5, 0, 1, 2);
-    layout->addWidget(check_show_input_events_, 6, 0, 1, 2);
-    layout->addWidget(check_continus_tracking_, 7, 0, 1, 2);
-    layout->addItem(space, 8, 0, -1, -1);
+    layout->addWidget(label_tracking_mode, 5, 0, 1, 1);
+    layout->addWidget(combo_tracking_mode_, 5, 1, 1, 1);
+    layout->addWidget(label_window_step, 6, 0, 1, 1);
+    layout->addWidget(spin_window_step_, 6, 1, 1, 1);
+    layout->addWidget(label_packet_policy, 7, 0, 1, 1);
+    layout->addWidget(combo_packet_policy_, 7, 1, 1, 1);
+    layout->addWidget(label_packet_time, 8, 0, 1, 1);
+    layout->addWidget(spin_packet_time_, 8, 1, 1, 1);
+    layout->addWidget(label_display_rate, 9, 0, 1, 1);
+    layout->addWidget(spin_display_rate_, 9, 1, 1, 1);
+    layout->addWidget(check_show_camera_pose_, 10, 0, 1, 2);
+    layout->addWidget(check_show_input_events_, 11, 0, 1, 2);
+    layout->addWidget(check_continus_tracking_, 12, 0, 1, 2);
+    layout->addItem(space, 13, 0, -1, -1);
 
     parameters->setLayout(layout);
     dock_->setWidget(parameters);
@@ -168,8 +220,16 @@ TrackingMainWindow::TrackingMainWindow(char *camera_configuration_file, int devi
     connect(spin_iterations_, SIGNAL(valueChanged(int)), tracking_worker_, SLOT(updateIterations(int)));
     connect(spin_acceleration_, SIGNAL(valueChanged(double)), tracking_worker_, SLOT(updateAcceleration(double)));
     connect(upscale_, SIGNAL(valueChanged(double)), tracking_worker_, SLOT(updateScale(double)));
+    connect(combo_tracking_mode_, SIGNAL(currentIndexChanged(int)), tracking_worker_, SLOT(updateTrackingMode(int)));
+    connect(spin_window_step_, SIGNAL(valueChanged(int)), tracking_worker_, SLOT(updateWindowStep(int)));
+    connect(combo_packet_policy_, SIGNAL(currentIndexChanged(int)), tracking_worker_, SLOT(updatePacketPolicy(int)));
+    connect(spin_packet_time_, SIGNAL(valueChanged(double)), tracking_worker_, SLOT(updatePacketTime(double)));
+    connect(spin_display_rate_, SIGNAL(valueChanged(double)), tracking_worker_, SLOT(updateDisplayRate(double)));
     connect(tracking_worker_, SIGNAL(update_output(iu::ImageGpu_8u_C4 *)), output_win_, SLOT(update_image(iu::ImageGpu_8u_C4 *)));
+    // connected after the widget, so it runs once the image has been copied
+    connect(tracking_worker_, SIGNAL(update_output(iu::ImageGpu_8u_C4 *)), this, SLOT(outputShown(iu::ImageGpu_8u_C4 *)));
     connect(tracking_worker_, SIGNAL(update_info(const QString &, int)), status_bar_, SLOT(showMessage(const QString &, int)));
+    connect(tracking_worker_, SIGNAL(update_tuning(int, int)), this, SLOT(showTuning(int, int)));
     connect(action_start_, SIGNAL(triggered(bool)), this, SLOT(startTracking()));
     connect(action_stop_, SIGNAL(triggered(bool)), this, SLOT(stopTracking()));
     connect(action_camera_, SIGNAL(triggered(bool)), this, SLOT(startCamera()));
@@ -216,43 +276,61 @@ TrackingMainWindow::~TrackingMainWindow()
 {
     stopTracking();
     tracking_worker_->wait();
-    camera_worker_->wait();
+    delete replay_;
 }
 
 void TrackingMainWindow::startTracking()
 {
     // yunfan
     tracking_worker_->start_t = clock();
-    std::ofstream reset_file("/home/yunfan/work_spaces/master_thesis/dvs-panotracking/data/cmp_datasets/shapes_rotation/output_poseestimated_pose_rpg.txt", std::ios::trunc);
 
     tracking_worker_->stop();
-    if (events_.empty())
-    { // start camera thread
-        camera_worker_->start();
+    source_worker_->stop();
+    source_worker_->wait();
+    delete replay_;
+    replay_ = NULL;
+    EventSource *recording = file_.isOpen() ? &file_ : input_;
+    if (recording)
+    { // from the start of the file each time play is pressed
+        if (recording->seekable())
+            recording->seek(recording->startTime() + replay_seek_);
+        replay_ = new ReplayEventSource(*recording, replay_speed_, replay_loop_);
+        source_worker_->setSource(replay_);
+        tracking_worker_->updateRealTimeInput(replay_->realTime());
     }
     else
-    {
-        tracking_worker_->addEvents(events_);
+    { // camera
+        if (!camera_.isOpen() && !camera_.open())
+        {
+            status_bar_->showMessage("No camera found", 0);
+            return;
+        }
+        source_worker_->setSource(&camera_);
+        tracking_worker_->updateRealTimeInput(camera_.realTime());
     }
     tracking_worker_->start();
+    source_worker_->start();
 }
 
 void TrackingMainWindow::stopTracking()
 {
     tracking_worker_->stop();
-    camera_worker_->stop();
+    source_worker_->stop();
+    source_worker_->wait();
+    camera_.close();
 }
 
 void TrackingMainWindow::startCamera()
 {
-    events_.clear();
+    file_.close();
+    input_ = NULL;
     startTracking();
 }
 
 void TrackingMainWindow::loadEvents()
 {
     QString fileName = QFileDialog::getOpenFileName(this,
-                                                    tr("Open Event File"), "", tr("Event Files (*.aer2 *.dat *.txt)"));
+                                                    tr("Open Event File"), "", tr("Event Files (*.aer2 *.dat *.txt *.aedat *.idx)"));
     status_bar_->showMessage("Loading...", 0);
     readevents(fileName.toStdString());
 }
@@ -272,6 +350,28 @@ void TrackingMainWindow::saveState()
     tracking_worker_->saveCurrentState(fileName.toStdString());
 }
 
+void TrackingMainWindow::outputShown(iu::ImageGpu_8u_C4 *image)
+{
+    // queued signals arrive in order, so the n-th image received is the n-th one emitted
+    Tracer::flowEnd("output", outputs_received_++);
+    Tracer::instant("display");
+    // the widget copies on this thread's default stream
+    CudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
+    tracking_worker_->releaseOutput();
+}
+
+void TrackingMainWindow::showTuning(int packet, int iterations)
+{
+    // the worker already uses the values, do not send them back
+    QSpinBox *spin_packet = combo_tracking_mode_->currentIndex() == TRACKING_PACKET ? spin_events_per_image_ : spin_window_step_;
+    spin_packet->blockSignals(true);
+    spin_packet->setValue(packet);
+    spin_packet->blockSignals(false);
+    spin_iterations_->blockSignals(true);
+    spin_iterations_->setValue(iterations);
+    spin_iterations_->blockSignals(false);
+}
+
 void TrackingMainWindow::showAbout()
 {
     QMessageBox::about(this, "About", "Demo application for our publication\n"
@@ -282,47 +382,20 @@ void TrackingMainWindow::showAbout()
 
 void TrackingMainWindow::readevents(std::string filename)
 {
-    QFileInfo info(filename.c_str());
-    events_.clear();
-    if (info.suffix() == "aer2" || info.suffix() == "txt")
+    // mapped and parsed while tracking
+    if (!file_.open(filename))
     {
-        ::loadEvents(events_, filename);
-    }
-    else if (info.suffix() == "dat")
-    { // read Bardow files
-        Event temp_event;
-        float first_timestamp = 0;
-        float time;
-        float last_timestamp = 0;
-        bool normalize_time = true;
-        std::ifstream ifs;
-        ifs.open(filename.c_str(), std::ios::in | std::ios::binary);
-        if (ifs.good())
-        {
-            unsigned int data;
-
-            while (!ifs.eof())
-            {
-                ifs.read((char *)&data, 4);
-                time = data;
-                //                if(first_timestamp==0) {
-                //                    first_timestamp=time;
-                //                }
-                time -= first_timestamp;
-                ifs.read((char *)&data, 4);
-                temp_event.x = (data & 0x000001FF);
-                temp_event.y = (data & 0x0001FE00) >> 9;
-                temp_event.polarity = (data & 0x00020000) >> 17;
-                //                if(flip_ud)
-                //                    temp_event.y = 127-temp_event.y;
-                temp_event.t = time * TIME_CONSTANT;
-                temp_event.polarity = temp_event.polarity > 0 ? 1 : -1;
-                events_.push_back(temp_event);
-            }
-            ifs.close();
-        }
+        status_bar_->showMessage(tr("Could not open %1").arg(filename.c_str()), 0);
+        return;
     }
-    status_bar_->showMessage(tr("Loaded a file with %1 events").arg(events_.size()), 0);
+    status_bar_->showMessage(tr("Opened a file with %1 s of events").arg(file_.endTime() - file_.startTime()), 0);
+}
+
+void TrackingMainWindow::setReplay(double speed, bool loop, double seek)
+{
+    replay_speed_ = speed;
+    replay_loop_ = loop;
+    replay_seek_ = seek;
 }
 
 TrackingMainWindow::TrackingMainWindow()
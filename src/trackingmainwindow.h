@@ -35,7 +35,9 @@
 #include "event.h"
 #include "iu/iugui.h"
 #include "trackingworker.h"
-#include "dvscameraworker.h"
+#include "eventsourceworker.h"
+#include "eventsource.h"
+#include "caereventsource.h"
 
 
 class TrackingMainWindow : public QMainWindow
@@ -45,6 +47,21 @@ class TrackingMainWindow : public QMainWindow
     TrackingMainWindow();
     TrackingMainWindow(char* camera_configuration_file, int device_number);
     ~TrackingMainWindow();
+    void setPoseOutput(std::string filename) { tracking_worker_->setPoseOutput(filename); }
+    void setVideoOutput(std::string filename, double fps) { tracking_worker_->setVideoOutput(filename, fps); }
+    void setAutosave(std::string prefix, double interval) { tracking_worker_->setAutosave(prefix, interval); }
+    void setResume(std::string filename, bool restore_pose) { tracking_worker_->setResume(filename, restore_pose); }
+    void setCheckpointOutput(std::string filename) { tracking_worker_->setCheckpointOutput(filename); }
+    void setAutoTuning(const AutoTunerSettings &settings, std::string log_file) { tracking_worker_->setAutoTuning(settings, log_file); }
+    void setRelocalization(bool enabled, float lost_quality) { tracking_worker_->setRelocalization(enabled, lost_quality); }
+    bool setSharedMemoryOutput(std::string name, int map_width, double map_interval) { return tracking_worker_->setSharedMemoryOutput(name, map_width, map_interval); }
+    // Recordings are replayed at speed times real time (<= 0: as fast as
+    // possible) from seek seconds after their start
+    void setReplay(double speed, bool loop, double seek);
+    // Used instead of the camera when no file is loaded, not owned
+    void setEventSource(EventSource *source) { input_ = source; }
+    // Raw camera packets are recorded while the camera runs, not owned
+    void setRecorder(EventRecorder *recorder) { camera_.setRecorder(recorder); }
 
   protected slots:
     void startTracking();
@@ -54,14 +71,22 @@ class TrackingMainWindow : public QMainWindow
     void saveEvents();
     void showAbout();
     void saveState();
+    void outputShown(iu::ImageGpu_8u_C4 *image);
+    void showTuning(int packet, int iterations);
 
   protected:
     void readevents(std::string filename);
 
     iu::Qt5ImageGpuWidget *output_win_;
-    std::vector<Event> events_;
     TrackingWorker *tracking_worker_;
-    DVSCameraWorker *camera_worker_;
+    EventSourceWorker *source_worker_;
+    CaerEventSource camera_;
+    FileEventSource file_;
+    EventSource *input_;
+    ReplayEventSource *replay_;
+    double replay_speed_;
+    bool replay_loop_;
+    double replay_seek_;
     Parameters parameters_;
 
     QMdiArea *mdi_area_;
@@ -77,6 +102,11 @@ class TrackingMainWindow : public QMainWindow
     QCheckBox *check_show_input_events_;
     QCheckBox *check_continus_tracking_;
     QDoubleSpinBox *upscale_;
+    QComboBox *combo_tracking_mode_;
+    QSpinBox *spin_window_step_;
+    QComboBox *combo_packet_policy_;
+    QDoubleSpinBox *spin_packet_time_;
+    QDoubleSpinBox *spin_display_rate_;
 
     QAction *action_start_;
     QAction *action_stop_;
@@ -90,6 +120,7 @@ class TrackingMainWindow : public QMainWindow
     QAction *action_view_about_;
 
     bool simple_mode_;
+    long outputs_received_;
 };
 
 #endif // DENOISINGMAINWINDOW_H
@@ -21,337 +21,421 @@
 #include "common.cuh"
 #include "common.h"
 #include "direct.cuh"
-#include "cnpy.h"
-#include "iu/iuio.h"
 #include "iu/iumath.h"
-#include "eigenhelpers.h"
+#include "scopedtimer.h"
+#include "metrics.h"
+#include "tracing.h"
+#include "eventsimulator.h"
+#include <limits>
+#include <cmath>
+#include <chrono>
+
+// Queue and output side of the pipeline, served by MetricsServer (the
+// stages of the tracker itself are recorded by Tracker)
+struct TrackingMetrics
+{
+    MetricCounter &events_in;
+    MetricCounter &events_dropped;
+    LatencyHistogram &queue_wait;
+    LatencyHistogram &rendering;
+    LatencyHistogram &pose_latency;
+    MetricGauge &queue_depth;
+    MetricGauge &lag;
+};
+
+static TrackingMetrics &trackingMetrics()
+{
+    MetricsRegistry &r = MetricsRegistry::instance();
+    static TrackingMetrics metrics = {
+        r.counter("dvs_events_in_total", "Events handed to the tracker"),
+        r.counter("dvs_events_dropped_total", "Events dropped by the packetizer"),
+        r.histogram("dvs_queue_wait_seconds", "Time the newest event of a packet waited in the queue"),
+        r.histogram("dvs_rendering_seconds", "Rendering of the output image"),
+        r.histogram("dvs_pose_latency_seconds", "Event timestamp to pose output"),
+        r.gauge("dvs_queue_depth_events", "Events waiting in the queue"),
+        r.gauge("dvs_lag_seconds", "Lag of the oldest queued event behind sensor time")};
+    return metrics;
+}
 
 TrackingWorker::TrackingWorker(const Parameters &cam_parameters, int device_number, float upscale)
+    : tracker_(cam_parameters, device_number, upscale)
 {
     device_number_ = device_number;
-    CudaSafeCall(cudaSetDevice(device_number_));
     width_ = cam_parameters.camera_width;
     height_ = cam_parameters.camera_height;
-    output_ = new iu::ImageGpu_32f_C1(cam_parameters.output_size_x, cam_parameters.output_size_y);
     output_color_ = new iu::ImageGpu_8u_C4(cam_parameters.output_size_x, cam_parameters.output_size_y);
-    occurences_ = new iu::ImageGpu_32f_C1(cam_parameters.output_size_x, cam_parameters.output_size_y);
-    normalization_ = new iu::ImageGpu_32f_C1(cam_parameters.output_size_x, cam_parameters.output_size_y);
+    autosave_map_ = NULL;
 
-    iu::math::fill(*occurences_, 0.f);
-    iu::math::fill(*normalization_, 1.f);
-    iu::math::fill(*output_, 0.f);
-
-    events_per_image_ = 1500;
-    iterations_ = 10;
     image_skip_ = 5;
-
-    camera_parameters_ = cam_parameters;
-    upscale_ = upscale;
-    tracking_quality_ = 1;
     image_id_ = 0;
-
-    cuda::setCameraMatrices(camera_parameters_.K_cam, camera_parameters_.K_caminv, camera_parameters_.px, camera_parameters_.py, upscale_);
-
-    events_cpu_ = NULL;
-    events_gpu_ = NULL;
-    image_gradients_cpu_ = NULL;
-    image_gradients_gpu_ = NULL;
-
-    pose_.setZero();
-    old_pose_ = pose_;
-
-    R_sphere_ << 0, 0, 1,
-        1, 0, 0,
-        0, 1, 0;
-
-    lambda_ = 100.f;
-    lambda_a_ = 2.f;
-    lambda_b_ = 10.f;
-    alpha_ = 0.4f;
+    next_output_ = 0;
+    outputs_ = 0;
+    display_rate_ = 30;
+    rendering_ = false;
+    display_image_ = new iu::ImageGpu_8u_C4(output_color_->size());
+    display_pending_ = false;
+    for (int i = 0; i < 3; i++)
+    {
+        RenderFrame &frame = frames_.slot(i);
+        frame.map = new iu::ImageGpu_32f_C1(output_color_->size());
+        frame.events = NULL;
+        frame.show_events = false;
+        frame.pose.setZero();
+        frame.quality = -1.f;
+        frame.geometry = tracker_.geometry();
+    }
+    video_fps_ = 0;
+    autosave_interval_ = 0;
+    resume_pose_ = true;
+    autotune_ = false;
+    tracking_active_ = false;
+    shm_map_interval_ = 1;
+    next_shm_map_ = 0;
+    if (!cam_parameters.pose_output_dir.empty())
+        pose_file_ = cam_parameters.pose_output_dir + "/output_pose/estimated_pose_rpg.txt";
+    clock_offset_ = std::numeric_limits<double>::infinity();
+    latency_ = 0;
+    packet_policy_ = PACKET_COUNT;
+    real_time_input_ = false;
+    packet_time_ = 0.02;
+    queue_depth_ = 0;
+    lag_ = 0;
+    dropped_events_ = 0;
 
     show_camera_pose_ = true;
     show_events_ = true;
-
-    // yunfan
-    getUndistortMap();
+    trackingMetrics();
 }
 
 void TrackingWorker::addEvents(std::vector<Event> &events)
 {
-    if (all_events_.size() > 0)
-    {
-        all_events_.clear();
-    }
+    trackingMetrics().events_in.add(events.size());
     QMutexLocker lock(&mutex_events_);
-    for (int i = 0; i < events.size(); i++)
-    {
-        events_.push(events[i]);
-        all_events_.push_back(events[i]);
-    }
+    events_.insert(events_.end(), events.begin(), events.end());
+    // every event of the run, for saveEvents
+    all_events_.insert(all_events_.end(), events.begin(), events.end());
+    // smallest transport delay seen so far maps sensor time to host time
+    if (!events.empty())
+        clock_offset_ = std::min(clock_offset_, ScopedTimer::getCurrentTime() * 1e-6 - events.back().t);
+    events_added_.wakeOne();
 }
 
 void TrackingWorker::saveEvents(std::string filename)
 {
-    ::saveEvents(filename, all_events_);
+    QMutexLocker lock(&mutex_events_);
+    EventWriter writer(filename);
+    writer.write(all_events_);
 }
 
 void TrackingWorker::run()
 {
     CudaSafeCall(cudaSetDevice(device_number_));
-    if(reset_pose_)
-    {
-        iu::math::fill(*occurences_, 0);
-        iu::math::fill(*normalization_, 1.f);
-        pose_.setZero();
-        old_pose_.setZero();
-    }
-    all_events_.clear();
+    tracker_.reset(reset_pose_);
     running_ = true;
-    tracking_quality_ = 1;
     image_id_ = 0;
-    //int event_id = 0;
+    next_output_ = 0;
+    next_shm_map_ = 0;
+    packetizer_.resetStatistics();
+    autotuner_.reset();
+    Tracer::setThreadName("tracking");
+    mutex_events_.lock();
+    all_events_.clear();
+    std::string pose_file = pose_file_;
+    std::string resume_file = resume_file_, checkpoint_file = checkpoint_file_;
+    resume_file_.clear(); // only the first run resumes
+    snapshots_.setVideo(video_file_, video_fps_);
+    snapshots_.setAutosave(autosave_prefix_, autosave_interval_);
+    tracking_active_ = true;
+    mutex_events_.unlock();
+    if (!resume_file.empty())
+    {
+        if (tracker_.loadCheckpoint(resume_file, resume_pose_))
+            std::cout << "resumed from " << resume_file << std::endl;
+        else
+            std::cerr << "could not resume from " << resume_file << ", checkpoint missing or made with other parameters" << std::endl;
+    }
+    if (!pose_file.empty() && !pose_writer_.open(pose_file))
+        std::cerr << "could not write poses to " << pose_file << std::endl;
+    if (!snapshots_.start(output_color_->width(), output_color_->height()))
+        std::cerr << "could not write video to " << video_file_ << std::endl;
+    rendering_ = true;
+    std::thread render_thread(&TrackingWorker::renderLoop, this);
     while (running_)
     {
-        mutex_events_.lock();
-        bool image_available = events_.size() > events_per_image_;
+        {
+            TRACE_SCOPE("lock_wait");
+            mutex_events_.lock();
+        }
+        // a recording read as fast as possible is queued far ahead of the host
+        // clock, its events must not count as stale
+        packetizer_.setPolicy(packet_policy_ == PACKET_LATENCY_BUDGET && !real_time_input_ ? PACKET_COUNT : packet_policy_);
+        packetizer_.setCount(tracker_.packetSize());
+        packetizer_.setTimeWindow(packet_time_);
+        packetizer_.setLatencyBudget(packet_time_);
+        TraceSpan packetize("packetize");
+        std::vector<Event> temp_events;
+        double host_now = ScopedTimer::getCurrentTime() * 1e-6;
+        bool image_available = packetizer_.next(events_, temp_events, host_now, clock_offset_);
+        queue_depth_ = events_.size();
+        lag_ = packetizer_.lag();
+        trackingMetrics().events_dropped.add(packetizer_.dropped() - dropped_events_);
+        dropped_events_ = packetizer_.dropped();
+        if (image_available && !std::isinf(clock_offset_))
+            trackingMetrics().queue_wait.record((host_now - (temp_events.back().t + clock_offset_)) * 1e6);
+        packetize.setArg(temp_events.size());
+        std::string state_file;
+        state_file.swap(state_file_);
+        if (!image_available && state_file.empty() && running_)
+        {
+            // woken by addEvents, stop and saveCurrentState. Packets of the time
+            // based policies also complete as sensor time passes.
+            TRACE_SCOPE("wait_events");
+            if (packetizer_.policy() == PACKET_COUNT)
+                events_added_.wait(&mutex_events_);
+            else
+                events_added_.wait(&mutex_events_, 1);
+        }
         mutex_events_.unlock();
+        trackingMetrics().queue_depth.set(queue_depth_);
+        trackingMetrics().lag.set(lag_);
         if (image_available)
         {
-            mutex_events_.lock();
-            std::vector<Event> temp_events;
-            for (int i = 0; i < events_per_image_; i++)
-            {
-                temp_events.push_back(events_.front());
-                events_.pop();
-            }
-            mutex_events_.unlock();
-
-            //yunfan
-            float t_packet_begin = temp_events.front().t;
-            float t_packet_end = temp_events.back().t;
-            packet_t_ = t_packet_begin + 0.5 * (t_packet_end - t_packet_begin);
-
+            TraceSpan span("track", temp_events.size());
             track(temp_events);
         }
-        else
-            msleep(1);
+        if (!state_file.empty())
+            tracker_.saveState(state_file);
     }
+    mutex_events_.lock();
+    tracking_active_ = false;
+    std::string state_file;
+    state_file.swap(state_file_);
+    mutex_events_.unlock();
+    if (!state_file.empty())
+        tracker_.saveState(state_file);
+    rendering_ = false;
+    render_thread.join();
+    pose_writer_.close();
+    snapshots_.stop();
+    if (!checkpoint_file.empty() && !tracker_.saveCheckpoint(checkpoint_file))
+        std::cerr << "could not write checkpoint " << checkpoint_file << std::endl;
+    if (snapshots_.dropped() > 0)
+        std::cerr << "dropped " << snapshots_.dropped() << " snapshots, encoding was too slow" << std::endl;
 }
 
-void TrackingWorker::stop()
+void TrackingWorker::setAutoTuning(const AutoTunerSettings &settings, std::string log_file)
 {
-    running_ = false;
-    clearEvents();
-    if(reset_pose_)
-    {
-        iu::math::fill(*occurences_, 0);
-        iu::math::fill(*normalization_, 1.f);
-        pose_.setZero();
-        old_pose_.setZero();
-    }
-    all_events_.clear();
-    tracking_quality_ = 1;
-    image_id_ = 0;
+    QMutexLocker lock(&mutex_events_);
+    autotuner_.setSettings(settings);
+    if (!autotuner_.openLog(log_file))
+        std::cerr << "could not write auto-tuning log " << log_file << std::endl;
+    autotune_ = true;
 }
 
-void TrackingWorker::updateScale(double value)
+void TrackingWorker::setRelocalization(bool enabled, float lost_quality)
 {
-    upscale_ = value;
-    cuda::setCameraMatrices(camera_parameters_.K_cam, camera_parameters_.K_caminv, camera_parameters_.px, camera_parameters_.py, upscale_);
+    QMutexLocker lock(&mutex_events_);
+    tracker_.setRelocalization(enabled, lost_quality);
 }
 
-void TrackingWorker::track(std::vector<Event> &events)
+bool TrackingWorker::setSharedMemoryOutput(std::string name, int map_width, double map_interval)
 {
-    static iu::IuCudaTimer timer;
-    timer.start();
+    QMutexLocker lock(&mutex_events_);
+    shm_map_interval_ = map_interval;
+    return shm_.open(name, 4096, map_width);
+}
 
-    double time_map;
-    double time_track;
+void TrackingWorker::setPoseOutput(std::string filename)
+{
+    QMutexLocker lock(&mutex_events_);
+    pose_file_ = filename;
+}
 
-    // Keep CPU<->GPU interface memory up-to-date
-    if (!events_cpu_ || events_cpu_->numel() != events.size())
-        events_cpu_ = new iu::LinearHostMemory_32f_C2(events.size());
-    if (!events_gpu_ || events_gpu_->numel() != events.size())
-        events_gpu_ = new iu::LinearDeviceMemory_32f_C2(events.size());
-    if (!image_gradients_cpu_ || image_gradients_cpu_->numel() != events.size())
-        image_gradients_cpu_ = new iu::LinearHostMemory_32f_C4(events.size());
-    if (!image_gradients_gpu_ || image_gradients_gpu_->numel() != events.size())
-        image_gradients_gpu_ = new iu::LinearDeviceMemory_32f_C4(events.size());
+void TrackingWorker::stop()
+{
+    running_ = false;
+    {
+        QMutexLocker lock(&mutex_events_);
+        events_added_.wakeOne();
+    }
+    clearEvents();
+    // the tracker is reset by the next run, after the checkpoint is written;
+    // all_events_ stays for saveEvents until then
+    image_id_ = 0;
+    next_output_ = 0;
+    clock_offset_ = std::numeric_limits<double>::infinity();
+}
 
-    for (int i = 0; i < events.size(); i++)
+void TrackingWorker::track(std::vector<Event> &events)
+{
+    TrackingResult result = tracker_.track(events);
+    if (autotune_)
     {
-        // yunfan
-        if (::undistortPoint(events[i], undistorted, camera_parameters_.camera_width, camera_parameters_.camera_height))
-            *events_cpu_->data(i) = make_float2(events[i].x_undist, events[i].y_undist);
+        double solve = ScopedTimer::getCurrentTime() * 1e-6 - result.started;
+        if (autotuner_.update(tracker_, result, events.size(), events.back().t - events.front().t, solve, lag_))
+            emit update_tuning(tracker_.packetSize(), tracker_.iterations());
     }
-    iu::copy(events_cpu_, events_gpu_);
 
-    if (image_id_ > 10)
-    { // First few poses are crap anyhow, since there is no map.
-        //timer.start();
-        bool successfull = updatePose();
-        time_track = timer.elapsed();
+    if (result.pose_updated)
+    {
+        shm_.publishPose(result);
+        if (shm_.publishesMaps() && result.t >= next_shm_map_)
+        {
+            TRACE_SCOPE("shm_map");
+            shm_.publishMap(tracker_, result.t);
+            next_shm_map_ = result.t + shm_map_interval_;
+        }
 
         // yunfan
-        static std::ofstream pose_output_(camera_parameters_.pose_output_dir + "/output_pose/estimated_pose_rpg.txt",std::ios::trunc);
-        double rad = pose_.norm();
-        Eigen::AngleAxisd aa(rad, Eigen::Vector3d(pose_[1], pose_[2], pose_[0]) / rad);
-        Eigen::Quaterniond q_eigen(aa);
-        pose_output_ << packet_t_ << " 0 0 0 " << q_eigen.x() << " " << q_eigen.y() << " " << q_eigen.z() << " " << q_eigen.w() << std::endl;
+        if (pose_writer_.isOpen())
+            pose_writer_.write(result.t, poseToQuaternion(result.pose));
 
-        if (successfull && tracking_quality_ > 0.25f)
-        { // first few events often contain only noise. Update map only when tracking is good (arbitrary th).
-            timer.start();
-            cuda::updateMap(output_, occurences_, normalization_, events_gpu_, make_float3(pose_(0), pose_(1), pose_(2)), make_float3(old_pose_(0), old_pose_(1), old_pose_(2)), width_, height_);
-            time_map = timer.elapsed();
+        // end-to-end latency of the newest event in this packet
+        mutex_events_.lock();
+        double clock_offset = clock_offset_;
+        mutex_events_.unlock();
+        if (!std::isinf(clock_offset))
+        {
+            double latency = result.pose_ready - (events.back().t + clock_offset);
+            latency_ = 0.9 * latency_ + 0.1 * latency;
+            trackingMetrics().pose_latency.record(latency * 1e6);
         }
     }
-    else
-    {
-        cuda::updateMap(output_, occurences_, normalization_, events_gpu_, make_float3(pose_(0), pose_(1), pose_(2)), make_float3(old_pose_(0), old_pose_(1), old_pose_(2)), width_, height_);
-    }
     image_id_++;
-    if (image_skip_ > 0 && (image_id_ % image_skip_) == 0)
-    {
+    bool show = image_skip_ > 0 && tracker_.eventsTracked() >= next_output_;
+    bool frame = snapshots_.frameDue(result.t);
+    bool autosave = snapshots_.autosaveDue(result.t);
+    if (show)
+    { // every image_skip_ * events_per_image_ events, independent of the tracking mode
+        next_output_ = tracker_.eventsTracked() + (long)image_skip_ * tracker_.eventsPerImage();
         // yunfan
         end_t = clock();
 
-        emit update_info(tr("Track: %1s Map: %2ms. Quality: %3").arg(double(end_t - start_t) / CLOCKS_PER_SEC).arg(time_map).arg(tracking_quality_), 0);
-        cuda::createOutput(output_color_, output_, show_events_ ? events_gpu_ : NULL, make_float3(pose_(0), pose_(1), pose_(2)), width_, height_, show_camera_pose_ ? tracking_quality_ : -1.f);
-        emit update_output(output_color_);
+        emit update_info(tr("Track: %1s Map: %2ms. Quality: %3%8 Latency: %4ms Queue: %5 Lag: %6ms Dropped: %7").arg(double(end_t - start_t) / CLOCKS_PER_SEC).arg(result.time_map).arg(result.quality).arg(latency_ * 1e3).arg(queue_depth_).arg(lag_ * 1e3).arg(dropped_events_).arg(result.lost ? tr(" (lost, relocalizing)") : QString()), 0);
+        publishFrame();
     }
-}
-
-Matrix3fr TrackingWorker::rodrigues(Eigen::Vector3f in)
-{
-    float theta = in.norm();
-    if (theta < 1e-8f)
+    if (frame || autosave)
     {
-        return Matrix3fr::Identity();
+        TRACE_SCOPE("snapshot");
+        if (frame)
+        {
+            tracker_.render(output_color_, show_events_, show_camera_pose_);
+            snapshots_.addFrame(result.t, output_color_);
+        }
+        if (autosave)
+            addAutosave(result.t);
     }
-    Eigen::Vector3f omega = in / theta;
-    float alpha = cos(theta);
-    float beta = sin(theta);
-    float gamma = 1 - alpha;
-
-    // R = eye(3)*alpha + crossmat(omega)*beta + omega*omega'*gamma
-    return Matrix3fr::Identity() * alpha + crossmat(omega) * beta + omega * omega.transpose() * gamma;
 }
 
-Matrix3fr TrackingWorker::crossmat(Eigen::Vector3f t)
+void TrackingWorker::publishFrame()
 {
-    Matrix3fr t_hat;
-    t_hat << 0, -t(2), t(1),
-        t(2), 0, -t(0),
-        -t(1), t(0), 0;
-    return t_hat;
+    TRACE_SCOPE("publish_frame");
+    RenderFrame &frame = frames_.writeSlot();
+    iu::copy(tracker_.map(), frame.map);
+    iu::LinearDeviceMemory_32f_C2 *events = tracker_.packetEvents();
+    frame.show_events = show_events_ && events;
+    if (frame.show_events)
+    {
+        if (!frame.events || frame.events->numel() != events->numel())
+        {
+            delete frame.events;
+            frame.events = new iu::LinearDeviceMemory_32f_C2(events->numel());
+        }
+        iu::copy(events, frame.events);
+    }
+    frame.pose = tracker_.pose();
+    frame.quality = show_camera_pose_ ? tracker_.quality() : -1.f;
+    frame.geometry = tracker_.geometry();
+    // every thread has its own default stream, the copies must be complete
+    // before the render thread reads the slot
+    CudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
+    frames_.publish();
 }
 
-bool TrackingWorker::updatePose()
+void TrackingWorker::renderLoop()
 {
-
-    // Pre-calculate stuff which doesn't change between iterations
-    Eigen::Map<Eigen::Matrix2Xf> events((float *)events_cpu_->data(), 2, events_cpu_->numel());
-    Eigen::Matrix3Xf points(3, events.cols());
-    points.topLeftCorner(events.rows(), events.cols()) = events;
-    points.bottomRows<1>().setOnes();
-    points = R_sphere_ * camera_parameters_.K_caminv * points;
-    // yunfan
-    //points = camera_parameters_.K_caminv * points;
-
-    Eigen::Matrix3Xf X_hat(3, events.cols());
-    Eigen::RowVectorXf X_hat_norm(events.cols());
-    Eigen::MatrixX3f J(events.cols(), 3);
-    Eigen::MatrixX3f dG_dgsi(9, 3);
-    Eigen::Matrix3Xf dg_dG(3, 9);
-    Eigen::Matrix3f JtJ(3, 3);
-    Eigen::Matrix2Xf dPI_dg(2, 3);
-    Eigen::Map<Eigen::Matrix4Xf> dM_dx((float *)image_gradients_cpu_->data(), 4, events_cpu_->numel());
-    Eigen::Map<Eigen::VectorXf, 0, Eigen::Stride<0, 4> > M(&image_gradients_cpu_->data(0)->z, events_cpu_->numel());
-
-    old_pose_ = pose_;
-    Eigen::Vector3f old_pose = pose_;
-    Eigen::Vector3f init_pose = pose_;
-    Eigen::Vector3f accel_pose = pose_;
-    for (int iteration = 0; iteration < iterations_; iteration++)
+    CudaSafeCall(cudaSetDevice(device_number_));
+    Tracer::setThreadName("render");
+    iu::IuCudaTimer timer;
+    double next = ScopedTimer::getCurrentTime();
+    while (rendering_)
     {
-        Eigen::Matrix3f R = rodrigues(accel_pose);
-        X_hat = R * points;
-        X_hat_norm = X_hat.array().square().colwise().sum();
-        // get image gradients from GPU -> move to CPU
-        cuda::getGradients(image_gradients_gpu_, output_, events_gpu_, make_float3(accel_pose(0), accel_pose(1), accel_pose(2)));
-        iu::copy(image_gradients_gpu_, image_gradients_cpu_);
-        dG_dgsi << crossmat(-R.row(0)), crossmat(-R.row(1)), crossmat(-R.row(2));
-        JtJ.setZero();
-        for (int id = 0; id < events.cols(); id++)
+        // frames published while the GUI still holds the image are skipped
+        if (!display_pending_ && frames_.update())
         {
-            dg_dG << X_hat(0, id) * Eigen::Matrix3f::Identity(),
-                X_hat(1, id) * Eigen::Matrix3f::Identity(),
-                X_hat(2, id) * Eigen::Matrix3f::Identity();
-            dPI_dg(0, 0) = -camera_parameters_.px * X_hat(1, id) / X_hat_norm(id) / M_PI;
-            dPI_dg(0, 1) = camera_parameters_.px * X_hat(0, id) / X_hat_norm(id) / M_PI;
-            dPI_dg(0, 2) = 0.f;
-            dPI_dg(1, 0) = -camera_parameters_.py * X_hat(0, id) * X_hat(2, id) / pow(X_hat_norm(id), 3.f / 2.f) / (camera_parameters_.px / camera_parameters_.py);
-            dPI_dg(1, 1) = -camera_parameters_.py * X_hat(1, id) * X_hat(2, id) / pow(X_hat_norm(id), 3.f / 2.f) / (camera_parameters_.px / camera_parameters_.py);
-            dPI_dg(1, 2) = camera_parameters_.py / X_hat_norm(id) / (camera_parameters_.px / camera_parameters_.py);
-            dPI_dg *= upscale_;
-            J.row(id) = dM_dx.block<2, 1>(0, id).transpose() * dPI_dg * dg_dG * dG_dgsi;
-            JtJ += J.row(id).transpose() * J.row(id);
+            RenderFrame &frame = frames_.readSlot();
+            {
+                TRACE_SCOPE("render");
+                timer.start();
+                cuda::createOutput(frame.geometry, display_image_, frame.map, frame.show_events ? frame.events : NULL, make_float3(frame.pose(0), frame.pose(1), frame.pose(2)), width_, height_, frame.quality);
+                trackingMetrics().rendering.record(timer.elapsed() * 1e3);
+            }
+            // arrow to the slot receiving the image in the GUI thread
+            Tracer::flowBegin("output", outputs_++);
+            CudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
+            display_pending_ = true;
+            emit update_output(display_image_);
         }
-        // Gauss-Newton with prox
-        float alpha = 1.f;
-        old_pose = pose_;
-        pose_ = accel_pose - (JtJ + alpha * JtJ.diagonal().asDiagonal().toDenseMatrix()).inverse() * ((J.transpose() * -M) - alpha * (accel_pose - init_pose));
-        accel_pose = pose_ + alpha_ * (pose_ - old_pose);
+        next += 1e6 / std::max(display_rate_.load(), 1.);
+        double now = ScopedTimer::getCurrentTime();
+        if (next > now)
+            std::this_thread::sleep_for(std::chrono::microseconds((long)(next - now)));
+        else
+            next = now;
     }
-    tracking_quality_ = std::min(M.sum() / M.size() * upscale_, 1.f);
-    return true;
 }
 
-void TrackingWorker::saveCurrentState(std::string filename)
+void TrackingWorker::addAutosave(double t)
 {
-    saveState(filename, output_color_);
+    if (!autosave_map_)
+        autosave_map_ = new iu::ImageGpu_32f_C1(output_color_->size());
+    tracker_.snapshot(output_color_, autosave_map_, show_events_, show_camera_pose_);
+    snapshots_.addAutosave(t, output_color_, autosave_map_);
 }
 
-void TrackingWorker::clearEvents()
+void TrackingWorker::setVideoOutput(std::string filename, double fps)
 {
     QMutexLocker lock(&mutex_events_);
-    std::queue<Event> empty;
-    std::swap(events_, empty);
+    video_file_ = filename;
+    video_fps_ = fps;
 }
 
-void TrackingWorker::getUndistortMap()
+void TrackingWorker::setAutosave(std::string prefix, double interval)
 {
-    undistorted = std::vector<int>(width_ * height_, -1);
-
-    float fx = camera_parameters_.K_cam(0, 0);
-    float fy = camera_parameters_.K_cam(1, 1);
-    float cx = camera_parameters_.K_cam(0, 2);
-    float cy = camera_parameters_.K_cam(1, 2);
-
-    float k1 = camera_parameters_.distort.k1;
-    float k2 = camera_parameters_.distort.k2;
-    float p1 = camera_parameters_.distort.p1;
-    float p2 = camera_parameters_.distort.p2;
+    QMutexLocker lock(&mutex_events_);
+    autosave_prefix_ = prefix;
+    autosave_interval_ = interval;
+}
 
+void TrackingWorker::setResume(std::string filename, bool restore_pose)
+{
+    QMutexLocker lock(&mutex_events_);
+    resume_file_ = filename;
+    resume_pose_ = restore_pose;
+}
 
-    for (int v = 0; v < height_; v++)
-    {
-        for (int u = 0; u < width_; u++)
-        {
-            float x = (u - cx) / fx, y = (v - cy) / fy;
-            float r = sqrt(x * x + y * y);
-            float x_distorted = x * (1 + k1 * r * r + k2 * r * r * r * r) + 2 * p1 * x * y + p2 * (r * r + 2 * x * x);
-            float y_distorted = y * (1 + k1 * r * r + k2 * r * r * r * r) + p1 * (r * r + 2 * y * y) + 2 * p2 * x * y;
-            float u_distorted = fx * x_distorted + cx;
-            float v_distorted = fy * y_distorted + cy;
+void TrackingWorker::setCheckpointOutput(std::string filename)
+{
+    QMutexLocker lock(&mutex_events_);
+    checkpoint_file_ = filename;
+}
 
-            int idx_distort = (int)v_distorted * width_ + (int)u_distorted;
-            int idx_undistort = (int)v * width_ + (int)u;
-            if (u_distorted >= 0 && v_distorted >= 0 && u_distorted < width_ && v_distorted < height_)
-            {
-                undistorted[idx_distort] = idx_undistort;
-            }
-        }
+void TrackingWorker::saveCurrentState(std::string filename)
+{
+    QMutexLocker lock(&mutex_events_);
+    if (tracking_active_)
+    { // saved by the tracking thread
+        state_file_ = filename;
+        events_added_.wakeOne();
     }
-}
\ No newline at end of file
+    else
+        tracker_.saveState(filename);
+}
+
+void TrackingWorker::clearEvents()
+{
+    QMutexLocker lock(&mutex_events_);
+    std::deque<Event> empty;
+    std::swap(events_, empty);
+    queue_depth_ = 0;
+}
@@ -20,7 +20,9 @@
 
 #include <QThread>
 #include <queue>
+#include <deque>
 #include <QMutex>
+#include <QWaitCondition>
 #include <Eigen/Dense>
 
 #include <time.h>
@@ -28,7 +30,18 @@
 #include "iu/iucore.h"
 #include "event.h"
 #include "parameters.h"
-
+#include "packetizer.h"
+#include "posewriter.h"
+#include "snapshotwriter.h"
+#include "triplebuffer.h"
+#include "tracker.h"
+#include "autotuner.h"
+#include "shmpublisher.h"
+#include <atomic>
+#include <thread>
+
+// Runs a Tracker on its own thread: events are queued by addEvents, cut into
+// packets and tracked; results are reported through Qt signals.
 class TrackingWorker : public QThread
 {
     Q_OBJECT
@@ -41,36 +54,68 @@ public:
     TrackingWorker(const Parameters &cam_parameters, int device_number = 0, float upscale = 1.f);
     void addEvents(std::vector<Event> &events);
     void saveEvents(std::string filename);
+    // Any thread; while tracking, the tracking thread writes the state
     void saveCurrentState(std::string filename);
     void track(std::vector<Event> &events);
-    Eigen::Vector3f getPose(void) { return pose_; }
+    Eigen::Vector3f getPose(void) { return tracker_.pose(); }
+    size_t queueDepth(void) const { return queue_depth_; }
+    double lag(void) const { return lag_; } // seconds behind sensor time
+    long droppedEvents(void) const { return dropped_events_; }
+    // File for the poses of the next run (.txt or .npy), empty for none
+    void setPoseOutput(std::string filename);
+    // Mosaic video of the next run (.y4m or a png sequence), fps in sensor time
+    void setVideoOutput(std::string filename, double fps);
+    // Periodic <prefix>.png and <prefix>_map.npy, interval in sensor time
+    void setAutosave(std::string prefix, double interval);
+    // Checkpoint loaded by the next run, with its pose or as a prebuilt map
+    void setResume(std::string filename, bool restore_pose);
+    // Checkpoint written at the end of every run, empty for none
+    void setCheckpointOutput(std::string filename);
+    // Adapts packet size and iterations to the targets of settings while
+    // tracking; decisions are appended to log_file (empty: stdout)
+    void setAutoTuning(const AutoTunerSettings &settings, std::string log_file);
+    // Rotation search after tracking loss, see Tracker::setRelocalization
+    void setRelocalization(bool enabled, float lost_quality);
+    // Poses (and every map_interval seconds of sensor time a map_width wide
+    // snapshot, 0 for none) in the shared memory object name, see dvsshm.h
+    bool setSharedMemoryOutput(std::string name, int map_width, double map_interval);
 
 signals:
     void update_output(iu::ImageGpu_8u_C4 *);
     void update_info(const QString &, int);
+    void update_tuning(int packet, int iterations); // changed by the auto-tuner
 
 public slots:
     void stop();
-    void updateEventsPerImage(int value) { events_per_image_ = value; }
-    void updateIterations(int value) { iterations_ = value; }
+    void updateEventsPerImage(int value) { tracker_.setEventsPerImage(value); }
+    void updateIterations(int value) { tracker_.setIterations(value); }
     void updateImageSkip(int value) { image_skip_ = value; }
     void updateShowCameraPose(bool value) { show_camera_pose_ = value; }
     void updateShowInputEvents(bool value) { show_events_ = value; }
     void updateResetPose(bool value) { reset_pose_ = !value; }
-    void updateScale(double value);
-    void updateAcceleration(double value) { alpha_ = value; }
+    void updateScale(double value) { tracker_.setScale(value); }
+    void updateAcceleration(double value) { tracker_.setAcceleration(value); }
+    void updateTrackingMode(int value) { tracker_.setTrackingMode(value); }
+    void updateWindowStep(int value) { tracker_.setWindowStep(value); }
+    void updatePacketPolicy(int value) { packet_policy_ = value; }
+    // the latency budget only applies to input paced by sensor time, other
+    // input is cut like PACKET_COUNT (see EventSource::realTime)
+    void updateRealTimeInput(bool value) { real_time_input_ = value; }
+    void updatePacketTime(double value) { packet_time_ = value * 1e-3; }
+    void updateDisplayRate(double value) { display_rate_ = value; }
+    // The receiver of update_output is done with the image (drawn or copied
+    // and synchronized), the next frame may be rendered into it
+    void releaseOutput(void) { display_pending_ = false; }
 
 protected:
-    bool updatePose(void);
     void clearEvents(void);
-    Matrix3fr rodrigues(Eigen::Vector3f in);
-    Matrix3fr crossmat(Eigen::Vector3f t);
+    void addAutosave(double t);
+    void publishFrame(void);
+    void renderLoop(void);
 
-    int events_per_image_;
-    int iterations_;
+    Tracker tracker_;
     int width_;
     int height_;
-    Parameters camera_parameters_;
 
     bool show_camera_pose_;
     bool show_events_;
@@ -79,38 +124,62 @@ protected:
     bool running_;
     int image_id_;
     int image_skip_;
-    float upscale_;
-
-    std::queue<Event> events_;
+    long next_output_;
+    long outputs_; // flow id of the emitted images when tracing
+    std::string pose_file_;
+    PoseWriter pose_writer_;
+    std::string video_file_;
+    double video_fps_;
+    std::string autosave_prefix_;
+    double autosave_interval_;
+    SnapshotWriter snapshots_;
+    std::string resume_file_;
+    bool resume_pose_;
+    std::string checkpoint_file_;
+    std::string state_file_; // requested by saveCurrentState while tracking
+    bool tracking_active_;   // run() owns the tracker, guarded by mutex_events_
+    bool autotune_;
+    AutoTuner autotuner_;
+    ShmPublisher shm_;
+    double shm_map_interval_;
+    double next_shm_map_; // sensor time
+    iu::ImageGpu_8u_C4 *output_color_;
+    iu::ImageGpu_32f_C1 *autosave_map_;
+
+    // Rendering for the GUI runs on its own thread at display_rate_ frames
+    // per second, from the newest map copy published by track()
+    struct RenderFrame
+    {
+        iu::ImageGpu_32f_C1 *map;
+        iu::LinearDeviceMemory_32f_C2 *events;
+        bool show_events;
+        Eigen::Vector3f pose;
+        float quality; // < 0 to hide the camera outline
+        TrackingGeometry geometry; // scale at the time of the copy
+    };
+    TripleBuffer<RenderFrame> frames_;
+    // Image of update_output. The render thread only draws into it again
+    // after the GUI has returned it with releaseOutput.
+    iu::ImageGpu_8u_C4 *display_image_;
+    std::atomic<bool> display_pending_;
+    std::atomic<double> display_rate_;
+    std::atomic<bool> rendering_;
+
+    std::deque<Event> events_;
+    Packetizer packetizer_;
+    int packet_policy_;
+    std::atomic<bool> real_time_input_;
+    double packet_time_; // time window / latency budget in seconds
+    size_t queue_depth_;
+    double lag_;
+    long dropped_events_;
     std::vector<Event> all_events_;
     QMutex mutex_events_;
-    iu::ImageGpu_32f_C1 *output_;
-    iu::ImageGpu_8u_C4 *output_color_;
-    iu::ImageGpu_32f_C1 *occurences_;
-    iu::ImageGpu_32f_C1 *normalization_;
-
-    iu::LinearHostMemory_32f_C2 *events_cpu_;
-    iu::LinearDeviceMemory_32f_C2 *events_gpu_;
-    iu::LinearHostMemory_32f_C4 *image_gradients_cpu_;
-    iu::LinearDeviceMemory_32f_C4 *image_gradients_gpu_;
-
-    Eigen::Vector3f pose_;
-    Eigen::Vector3f old_pose_;
-    Matrix3fr R_sphere_;
-    float tracking_quality_;
-
-    // optimizer
-    float lambda_;
-    float lambda_a_;
-    float lambda_b_;
-    float alpha_;
-
-    //yunfan
-    float packet_t_;
-    std::vector<int> undistorted;
-    void getUndistortMap();
-
-    
+    QWaitCondition events_added_; // the tracking thread waits for events on it
+
+    // latency from event timestamp to pose output
+    double clock_offset_; // host time - sensor time, seconds
+    double latency_;      // seconds, moving average
 };
 
 #endif // DENOISINGWORKER_H
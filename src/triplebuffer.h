@@ -0,0 +1,61 @@
+// This file is part of dvs-panotracking.
+//
+// Copyright (C) 2017 Christian Reinbacher <reinbacher at icg dot tugraz dot at>
+// Institute for Computer Graphics and Vision, Graz University of Technology
+// https://www.tugraz.at/institute/icg/teams/team-pock/
+//
+// dvs-panotracking is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// dvs-panotracking is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Hands the newest of a stream of values from one producer to one consumer
+// without locks. Producer and consumer each own one slot, the third is
+// swapped atomically: the producer never waits and the consumer always gets
+// a complete value, skipping any it was too slow for.
+template <class T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : middle_(1), write_(0), read_(2) {}
+
+    T &slot(int i) { return slots_[i]; } // for allocation before use
+
+    // producer
+    T &writeSlot(void) { return slots_[write_]; }
+    void publish(void) { write_ = middle_.exchange(write_ | FRESH, std::memory_order_acq_rel) & INDEX; }
+
+    // consumer: true if readSlot() changed since the last call
+    bool update(void)
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        read_ = middle_.exchange(read_, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    T &readSlot(void) { return slots_[read_]; }
+
+protected:
+    enum
+    {
+        INDEX = 3,
+        FRESH = 4
+    };
+    T slots_[3];
+    std::atomic<int> middle_;
+    int write_;
+    int read_;
+};
+
+#endif // TRIPLEBUFFER_H